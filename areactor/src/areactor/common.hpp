@@ -1,6 +1,10 @@
 #pragma once
 #include <cstddef>
+#include <stdint.h>
 
 typedef size_t Slot;
 typedef size_t CellHandle;
-typedef int    ParticleID;
+
+// a handle: the particle's slot in the high half, the slot's use count when
+// it was taken in the low half; see ParticleManager::handle
+typedef uint64_t ParticleID;
@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Brown's calendar queue. Events are hashed by time into a ring of days,
+ * a year being days.size() * width; dequeue walks the days of the current
+ * year, so with a day about as wide as a few event gaps, push and pop are
+ * O(1) on average. The ring doubles or halves with the event count and the
+ * width is re-estimated from the earliest events on each resize.
+ *
+ * T needs a `t` member in seconds and a strict operator< that breaks ties,
+ * events then leave in exactly that order
+ */
+template <typename T>
+class CalendarQueue {
+    std::vector< std::vector<T> > days;  // each sorted latest first
+    double width;                        // seconds per day
+    size_t count;
+
+    size_t cur;      // day being scanned
+    double cur_day;  // its absolute day number, floor(t / width)
+    double last_t;   // time of the last event out, nothing earlier is queued
+
+    std::vector<T> scratch;
+
+    static const size_t MIN_DAYS = 16;
+    static const size_t WIDTH_SAMPLE = 25;
+
+    static bool later(const T &x, const T &y) {
+        return y < x;
+    }
+
+    double day_number(double t) const {
+        return std::floor(t / width);
+    }
+
+    void insert(const T &e) {
+        std::vector<T> &d = days[(size_t)std::fmod(day_number(e.t), (double)days.size())];
+        d.insert(std::upper_bound(d.begin(), d.end(), e, later), e);
+    }
+
+    void seek(double t) {
+        cur_day = day_number(t);
+        cur = (size_t)std::fmod(cur_day, (double)days.size());
+    }
+
+    // three times the mean gap between the earliest events
+    void estimate_width() {
+        const size_t sample = WIDTH_SAMPLE;  // std::min takes references, a copy needs no definition
+        const size_t n = std::min(scratch.size(), sample);
+        if (n < 2) return;
+        std::partial_sort(scratch.begin(), scratch.begin() + n, scratch.end());
+
+        double sum = 0.0;
+        size_t gaps = 0;
+        for (size_t i = 1; i < n; ++i) {
+            const double g = scratch[i].t - scratch[i - 1].t;
+            if (g > 0.0) {
+                sum += g;
+                ++gaps;
+            }
+        }
+        if (gaps > 0) width = 3.0 * sum / (double)gaps;
+    }
+
+    void resize(size_t n_days) {
+        scratch.clear();
+        for (size_t i = 0; i < days.size(); ++i) {
+            scratch.insert(scratch.end(), days[i].begin(), days[i].end());
+        }
+        estimate_width();
+
+        days.assign(n_days, std::vector<T>());
+        for (size_t i = 0; i < scratch.size(); ++i) insert(scratch[i]);
+        seek(last_t);
+    }
+
+public:
+    CalendarQueue(double day_width)
+        : days(MIN_DAYS), width(day_width), count(0), cur(0), cur_day(0.0), last_t(0.0) {}
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    // drop everything, the next events are no earlier than t
+    void reset(double t) {
+        for (size_t i = 0; i < days.size(); ++i) days[i].clear();
+        count = 0;
+        last_t = t;
+        seek(t);
+    }
+
+    // e.t must not be earlier than the last event out; it may be earlier
+    // than what peek() has already walked past, the scan then goes back
+    void push(const T &e) {
+        insert(e);
+        if (day_number(e.t) < cur_day) seek(e.t);
+        if (++count > 2 * days.size()) resize(2 * days.size());
+    }
+
+    // earliest event, or false when empty; it stays queued
+    bool peek(T *out) {
+        if (count == 0) return false;
+
+        for (size_t k = 0; k < days.size(); ++k) {
+            const std::vector<T> &d = days[cur];
+            if (!d.empty() && day_number(d.back().t) <= cur_day) {
+                *out = d.back();
+                return true;
+            }
+            cur = (cur + 1) % days.size();
+            cur_day += 1.0;
+        }
+
+        // nothing within a year, jump to the earliest day that has one
+        size_t best = days.size();
+        for (size_t i = 0; i < days.size(); ++i) {
+            if (days[i].empty()) continue;
+            if (best == days.size() || days[i].back() < days[best].back()) best = i;
+        }
+        seek(days[best].back().t);
+        *out = days[best].back();
+        return true;
+    }
+
+    // removes what peek() returned last
+    void pop() {
+        last_t = days[cur].back().t;
+        days[cur].pop_back();
+        if (--count < days.size() / 2 && days.size() > MIN_DAYS) resize(days.size() / 2);
+    }
+};
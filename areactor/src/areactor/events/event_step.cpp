@@ -0,0 +1,294 @@
+#include <limits>
+
+#include "../reactor.hpp"
+
+/*
+ * Event-driven stepping. Particles fly straight between events, so a
+ * particle's position is only brought up to date when an event touches it,
+ * and for everyone at the end of a frame; a slot's last_moved is the time
+ * its position is for. Events are predicted from the current trajectories:
+ * contact of two particles in neighbouring cells, the next wall hit, and
+ * leaving the grid cell, which keeps buckets current.
+ *
+ * A particle's own next event, wall or cell, re-predicts its contacts with
+ * the whole neighbourhood, so a contact later than either particle's own
+ * next event is not queued at all; that is what keeps the queue small in a
+ * crowded cell, where most far predictions would only go stale
+ */
+
+static const double NEVER = std::numeric_limits<double>::infinity();
+
+// position of slot s at t, in double so predictions don't round twice
+static inline void position_at(const ParticleManager *pm, Slot s, Time t, double *x, double *y) {
+    const double dt = t - pm->last_moved[s];
+    *x = pm->pos_x[s] + pm->vel_x[s] * dt;
+    *y = pm->pos_y[s] + pm->vel_y[s] * dt;
+}
+
+static inline SimEvent make_event(Time t, int kind, const ParticleManager *pm, Slot sa) {
+    SimEvent ev;
+    ev.t = t;
+    ev.kind = kind;
+    ev.sa = ev.sb = sa;
+    ev.id_a = ev.id_b = pm->id[sa];
+    ev.gen_a = ev.gen_b = pm->gen[sa];
+    ev.aux = 0;
+    ev.wall_gen = 0;
+    return ev;
+}
+
+void Reactor::drift(Slot s, Time t) const {
+    ParticleManager *pm = particles;
+    const float dt = (float)(t - pm->last_moved[s]);
+    pm->pos_x[s] += pm->vel_x[s] * dt;
+    pm->pos_y[s] += pm->vel_y[s] * dt;
+    pm->last_moved[s] = t;
+}
+
+// first time the two touch while closing in; an overlap that is already
+// opening up is left alone, as the fragments of a burst are
+void Reactor::predict_pair(Slot sa, Slot sb, Time now) {
+    const ParticleManager *pm = particles;
+
+    double ax, ay, bx, by;
+    position_at(pm, sa, now, &ax, &ay);
+    position_at(pm, sb, now, &bx, &by);
+
+    const double dx = bx - ax, dy = by - ay;
+    const double dvx = (double)pm->vel_x[sb] - pm->vel_x[sa];
+    const double dvy = (double)pm->vel_y[sb] - pm->vel_y[sa];
+
+    const double b = dx * dvx + dy * dvy;
+    if (b >= 0.0) return;
+
+    const double rr = (double)pm->radius[sa] + pm->radius[sb];
+    const double c = dx * dx + dy * dy - rr * rr;
+    double t = 0.0;
+    if (c > 0.0) {
+        const double a = dvx * dvx + dvy * dvy;
+        const double disc = b * b - a * c;
+        if (disc < 0.0) return;
+        t = c / (-b + std::sqrt(disc));
+        if (now + t > std::min(own_event_t[sa], own_event_t[sb])) return;
+    }
+
+    SimEvent ev = make_event(now + t, EventKind::PAIR, pm, sa);
+    // the lower id first, as the sweep collides them
+    if (pm->id[sb] < pm->id[sa]) {
+        ev.sa = sb;
+        ev.id_a = pm->id[sb];
+        ev.gen_a = pm->gen[sb];
+        ev.sb = sa;
+        ev.id_b = pm->id[sa];
+        ev.gen_b = pm->gen[sa];
+    } else {
+        ev.sb = sb;
+        ev.id_b = pm->id[sb];
+        ev.gen_b = pm->gen[sb];
+    }
+    events.push(ev);
+}
+
+// the wall reached first, the right one moving with its current segment
+void Reactor::predict_wall(Slot s, Time now) {
+    const ParticleManager *pm = particles;
+
+    double x, y;
+    position_at(pm, s, now, &x, &y);
+    const double r = pm->radius[s];
+    const double vx = pm->vel_x[s], vy = pm->vel_y[s];
+
+    double t = NEVER;
+    int side = Side::NONE;
+
+    if (vx < 0.0) {
+        t = std::max(0.0, (r - x) / vx);
+        side = Side::LEFT;
+    }
+    const double closing = vx - wall_vel(Side::RIGHT);
+    if (closing > 0.0) {
+        const double tr = std::max(0.0, (wall_pos(Side::RIGHT, now) - r - x) / closing);
+        if (tr < t) {
+            t = tr;
+            side = Side::RIGHT;
+        }
+    }
+    if (vy < 0.0) {
+        const double tt = std::max(0.0, (r - y) / vy);
+        if (tt < t) {
+            t = tt;
+            side = Side::TOP;
+        }
+    }
+    if (vy > 0.0) {
+        const double tb = std::max(0.0, (box_h - r - y) / vy);
+        if (tb < t) {
+            t = tb;
+            side = Side::BOTTOM;
+        }
+    }
+    wall_event_t[s] = now + t;
+    if (side == Side::NONE) return;
+
+    SimEvent ev = make_event(now + t, EventKind::WALL, pm, s);
+    ev.aux = side;
+    ev.wall_gen = right_wall.gen;
+    events.push(ev);
+}
+
+// leaving the bucket's cell; the outer rows and columns reach past the
+// frame, as Grid::cell clamps to them
+void Reactor::predict_cross(Slot s, Time now) {
+    const ParticleManager *pm = particles;
+    const Grid *grid = pm->grid;
+
+    const CellHandle ch = pm->cell_of[s];
+    const int cx = (int)(ch % grid->nx), cy = (int)(ch / grid->nx);
+
+    double x, y;
+    position_at(pm, s, now, &x, &y);
+    const double vx = pm->vel_x[s], vy = pm->vel_y[s];
+
+    double tx = NEVER, ty = NEVER;
+    if (vx > 0.0 && cx < grid->nx - 1) tx = ((cx + 1) * grid->cell_w - x) / vx;
+    if (vx < 0.0 && cx > 0)            tx = (cx * grid->cell_w - x) / vx;
+    if (vy > 0.0 && cy < grid->ny - 1) ty = ((cy + 1) * grid->cell_h - y) / vy;
+    if (vy < 0.0 && cy > 0)            ty = (cy * grid->cell_h - y) / vy;
+
+    own_event_t[s] = std::min(wall_event_t[s], now + std::max(0.0, std::min(tx, ty)));
+    if (tx == NEVER && ty == NEVER) return;
+
+    Cell next;
+    next.x = cx;
+    next.y = cy;
+    double t;
+    if (tx <= ty) {
+        next.x += vx > 0.0 ? 1 : -1;
+        t = tx;
+    } else {
+        next.y += vy > 0.0 ? 1 : -1;
+        t = ty;
+    }
+
+    SimEvent ev = make_event(now + std::max(0.0, t), EventKind::CROSS, pm, s);
+    ev.aux = grid->cell_handle(next);
+    events.push(ev);
+}
+
+void Reactor::predict_neighbours(Slot s, Time now, bool higher_ids_only) {
+    const ParticleID id_a = particles->id[s];
+    const Grid *grid = particles->grid;
+    const CellHandle ch = particles->cell_of[s];
+    const int cx = (int)(ch % grid->nx), cy = (int)(ch / grid->nx);
+
+    for (int y = std::max(0, cy - 1); y <= std::min(grid->ny - 1, cy + 1); ++y) {
+        for (int x = std::max(0, cx - 1); x <= std::min(grid->nx - 1, cx + 1); ++x) {
+            const std::vector<Slot> &bucket = grid->buckets[x + y * grid->nx];
+            for (size_t k = 0; k < bucket.size(); ++k) {
+                const Slot sb = bucket[k];
+                if (sb == s) continue;
+                if (higher_ids_only && particles->id[sb] < id_a) continue;
+                predict_pair(s, sb, now);
+            }
+        }
+    }
+}
+
+// everything for a particle that is new or has a new trajectory
+void Reactor::predict_particle(Slot s, Time now) {
+    if (own_event_t.size() < particles->capacity()) {
+        own_event_t.resize(particles->capacity(), NEVER);
+        wall_event_t.resize(particles->capacity(), NEVER);
+    }
+    move_cell(s, particles->grid->cell_index(particles->position(s)));
+    predict_wall(s, now);
+    predict_cross(s, now);
+    predict_neighbours(s, now, false);
+}
+
+void Reactor::prime_events() {
+    events.reset(sim_now);
+    std::vector<Slot> &act = particles->active_slots;
+    for (size_t i = 0; i < act.size(); ++i) drift(act[i], sim_now);
+    rebuild_buckets_if_needed();
+    own_event_t.assign(particles->capacity(), NEVER);
+    wall_event_t.assign(particles->capacity(), NEVER);
+
+    // own events first, pairs are bounded by them
+    for (size_t i = 0; i < act.size(); ++i) {
+        predict_wall(act[i], sim_now);
+        predict_cross(act[i], sim_now);
+    }
+    for (size_t i = 0; i < act.size(); ++i) predict_neighbours(act[i], sim_now, true);
+    events_primed = true;
+}
+
+bool Reactor::event_live(const SimEvent &ev) const {
+    const ParticleManager *pm = particles;
+    if (!pm->alive[ev.sa] || pm->id[ev.sa] != ev.id_a || pm->gen[ev.sa] != ev.gen_a) return false;
+
+    switch (ev.kind) {
+        case EventKind::PAIR:
+            return pm->alive[ev.sb] && pm->id[ev.sb] == ev.id_b && pm->gen[ev.sb] == ev.gen_b;
+        case EventKind::WALL:
+            return ev.wall_gen == right_wall.gen;
+        default:
+            return true;
+    }
+}
+
+void Reactor::on_pair_event(const SimEvent &ev) {
+    drift(ev.sa, ev.t);
+    drift(ev.sb, ev.t);
+
+    box_w = wall_pos(Side::RIGHT, ev.t);
+    collide_dispatch(this, particles, ev.sa, ev.sb, ev.t, &particles->pending);
+
+    events_added.clear();
+    particles->flush_deferred(&events_added);
+    for (size_t i = 0; i < events_added.size(); ++i) predict_particle(events_added[i], ev.t);
+
+    // a survivor that absorbed the other has a new trajectory
+    const ParticleManager *pm = particles;
+    if (pm->alive[ev.sa] && pm->id[ev.sa] == ev.id_a && pm->gen[ev.sa] != ev.gen_a) predict_particle(ev.sa, ev.t);
+    if (pm->alive[ev.sb] && pm->id[ev.sb] == ev.id_b && pm->gen[ev.sb] != ev.gen_b) predict_particle(ev.sb, ev.t);
+}
+
+void Reactor::on_wall_event(const SimEvent &ev) {
+    drift(ev.sa, ev.t);
+    bounce_wall(ev.sa, (int)ev.aux, ev.t);
+    particles->gen[ev.sa]++;
+    predict_particle(ev.sa, ev.t);
+}
+
+// the trajectory stays; the contacts cut off at this event are predicted again
+void Reactor::on_cross_event(const SimEvent &ev) {
+    move_cell(ev.sa, ev.aux);
+    predict_cross(ev.sa, ev.t);
+    predict_neighbours(ev.sa, ev.t, false);
+}
+
+void Reactor::step_events(Time dt) {
+    if (!events_primed) prime_events();
+
+    const Time end = sim_now + dt;
+    SimEvent ev;
+    while (events.peek(&ev) && ev.t <= end) {
+        events.pop();
+        if (!event_live(ev)) continue;
+
+        sim_now = ev.t;
+        switch (ev.kind) {
+            case EventKind::PAIR: on_pair_event(ev); ++frame_collisions; break;
+            case EventKind::WALL: on_wall_event(ev); break;
+            default:              on_cross_event(ev); break;
+        }
+    }
+
+    // rendering and the statistics read positions directly
+    sim_now = end;
+    std::vector<Slot> &act = particles->active_slots;
+    for (size_t i = 0; i < act.size(); ++i) drift(act[i], end);
+
+    box_w = wall_pos(Side::RIGHT, sim_now);
+}
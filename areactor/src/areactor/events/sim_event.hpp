@@ -0,0 +1,37 @@
+#pragma once
+#include "../particles/particle_manager.hpp"
+
+struct EventKind {
+    enum Enum {
+        CROSS = 0,  // particle leaves its grid cell
+        WALL,       // particle reaches a wall
+        PAIR        // two particles touch
+    };
+};
+
+/*
+ * Predicted event. It is only acted on if every particle it names still
+ * holds its slot with the generation it was predicted for; anything that
+ * changes a trajectory bumps Particle::gen, which drops its old events
+ * lazily instead of searching the queue for them
+ */
+struct SimEvent {
+    Time t;
+    int kind;
+
+    Slot sa, sb;
+    ParticleID id_a, id_b;
+    int gen_a, gen_b;
+
+    size_t aux;         // WALL: Side, CROSS: the cell entered
+    unsigned wall_gen;  // WALL: segment generation of the wall
+
+    // ties go by kind then ids, so the order never depends on the queue layout
+    bool operator<(const SimEvent &o) const {
+        if (t != o.t) return t < o.t;
+        if (kind != o.kind) return kind < o.kind;
+        if (id_a != o.id_a) return id_a < o.id_a;
+        if (id_b != o.id_b) return id_b < o.id_b;
+        return aux < o.aux;
+    }
+};
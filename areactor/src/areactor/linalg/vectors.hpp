@@ -3,8 +3,10 @@
 #include <cmath>
 #include <cstdlib>
 
-inline float rand01() {
-    return (float)(std::rand()) / RAND_MAX;
+// LCG in [0, 1) over the caller's state, the same sequence on every platform
+inline float rand01(unsigned *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (float)((*state >> 8) / 16777216.0);
 }
 
 inline float sign(float a) {
@@ -21,17 +23,18 @@ public:
     explicit Vec2f(float xx, float yy)
         : x(xx), y(yy) {}
 
-    static Vec2f random_rect(float w, float h) {
+    static Vec2f random_rect(float w, float h, unsigned *state) {
         assert(!std::isnan(w));
         assert(!std::isinf(w));
         assert(!std::isnan(h));
         assert(!std::isinf(h));
         assert(w >= 0.0);
         assert(h >= 0.0);
-        return Vec2f(rand01() * w, rand01() * h);
+        const float x = rand01(state) * w;
+        return Vec2f(x, rand01(state) * h);
     }
 
-    static Vec2f random_radial(float min_mag, float max_mag) {
+    static Vec2f random_radial(float min_mag, float max_mag, unsigned *state) {
         assert(!std::isnan(min_mag));
         assert(!std::isinf(min_mag));
         assert(!std::isnan(max_mag));
@@ -39,8 +42,8 @@ public:
         assert(min_mag >= 0.0);
         assert(max_mag >= min_mag);
 
-        float mag = (max_mag - min_mag) * rand01() + min_mag;
-        float angle = 2 * M_PI * rand01();
+        float mag = (max_mag - min_mag) * rand01(state) + min_mag;
+        float angle = 2 * M_PI * rand01(state);
 
         float x = mag * std::cos(angle);
         float y = mag * std::sin(angle);
@@ -0,0 +1,241 @@
+#include <algorithm>
+
+#include "../reactor.hpp"
+
+/*
+ * Multirate substeps. The frame is cut into 2^top_level ticks and every
+ * particle gets a level, the fewest halvings of the frame at which it moves
+ * no further between two checks than a whole-gas substep would let it; a
+ * particle of level l is checked at every 2^(top_level - l)-th tick, so at
+ * tick k the levels from top_level - (trailing zeros of k) up are, and the
+ * last tick checks everyone.
+ *
+ * Particles fly straight in between, so as in the event engine a position
+ * is only brought up to date when the particle is checked or hit. Each
+ * level keeps a CellGrid, sorted again whenever the level is checked. A
+ * pair is tested when the faster of the two is checked, against the other
+ * one's position at that tick; both catch up before they collide, and what
+ * comes out of a collision takes a level checked at that tick, so the
+ * schedule stays aligned
+ */
+
+// floor of c clamped to [0, n), without a call into libm
+static inline int cell_of_coord(double c, int n) {
+    if (!(c > 0.0)) return 0;
+    return c < (double)n ? (int)c : n - 1;
+}
+
+void Reactor::set_level(Slot s, int level) {
+    if (level_of.size() < particles->capacity()) {
+        level_of.resize(particles->capacity(), 0);
+        listed_at.resize(particles->capacity(), 0);
+    }
+    level_of[s] = (unsigned char)level;
+    level_slots[level].push_back(s);
+}
+
+// a particle the right wall may run into this frame moves against it
+int Reactor::required_level(Slot s) const {
+    const ParticleManager *pm = particles;
+    double speed = std::sqrt((double)pm->vel_x[s] * pm->vel_x[s] + (double)pm->vel_y[s] * pm->vel_y[s]);
+    if (pm->pos_x[s] + pm->radius[s] + speed * tick_dt >= tick_wall_min) {
+        speed += std::abs(wall_vel(Side::RIGHT));
+    }
+
+    const double checks = speed * tick_dt / tick_disp;
+    int level = 0;
+    while (level < top_level && (double)(1 << level) < checks) ++level;
+    return level;
+}
+
+// levels for the frame; false if the whole-gas substeps are cheaper
+bool Reactor::plan_levels(Time dt, int n_uniform) {
+    const ParticleManager *pm = particles;
+    const std::vector<Slot> &act = pm->active_slots;
+
+    // even with everyone at level 0 the checks would cost as much
+    if (n_uniform <= RATE_CHECK_COST || act.empty()) return false;
+
+    top_level = 0;
+    while ((1 << top_level) < n_uniform && top_level < RATE_MAX_LEVEL) ++top_level;
+
+    tick_t0 = sim_now;
+    tick_dt = dt;
+    tick_wall_min = std::min(wall_pos(Side::RIGHT, sim_now), wall_pos(Side::RIGHT, sim_now + dt));
+
+    float r_min = std::numeric_limits<float>::infinity();
+    float v2_max = 0.0f;
+    for (size_t i = 0; i < act.size(); ++i) {
+        const Slot s = act[i];
+        r_min = std::min(r_min, pm->radius[s]);
+        v2_max = std::max(v2_max, pm->vel_x[s] * pm->vel_x[s] + pm->vel_y[s] * pm->vel_y[s]);
+    }
+    tick_disp = 0.5 * std::min((double)r_min, std::min(pm->grid->cell_w, pm->grid->cell_h));
+
+    double checks = 0.0;
+    for (int l = 0; l <= RATE_MAX_LEVEL; ++l) level_slots[l].clear();
+    for (size_t i = 0; i < act.size(); ++i) {
+        const int level = required_level(act[i]);
+        set_level(act[i], level);
+        checks += (double)(1 << level);
+    }
+    if (RATE_CHECK_COST * checks >= (double)act.size() * n_uniform) return false;
+
+    // a grid is off by a check's worth of motion at most, or by a finest
+    // tick's for a particle faster than the finest level allows
+    const double vmax = std::sqrt((double)v2_max) + std::abs(wall_vel(Side::RIGHT));
+    tick_slack = std::max(tick_disp, vmax * dt / (1 << top_level));
+
+    list_levels(0);
+    return true;
+}
+
+// drops dead, relevelled and repeated slots from the lists of the levels
+// checked at this tick, and sorts them into their grids
+void Reactor::list_levels(int min_level) {
+    const ParticleManager *pm = particles;
+    ++tick_seq;
+    for (int l = min_level; l <= top_level; ++l) {
+        std::vector<Slot> &slots = level_slots[l];
+        size_t kept = 0;
+        for (size_t i = 0; i < slots.size(); ++i) {
+            const Slot s = slots[i];
+            if (!pm->alive[s] || level_of[s] != l || listed_at[s] == tick_seq) continue;
+            listed_at[s] = tick_seq;
+            slots[kept++] = s;
+        }
+        slots.resize(kept);
+        level_grid[l].build(*pm, slots, box_w, box_h);
+    }
+}
+
+void Reactor::gather_tick(int min_level) {
+    const ParticleManager *pm = particles;
+    tick_active.clear();
+    for (int l = min_level; l <= top_level; ++l) {
+        const std::vector<Slot> &slots = level_slots[l];
+        for (size_t i = 0; i < slots.size(); ++i) {
+            const Slot s = slots[i];
+            if (pm->alive[s] && level_of[s] == l) tick_active.push_back(s);
+        }
+    }
+}
+
+// overlaps of the checked particles at t, in contact_before order; a checked
+// particle looks into its own level's grid and the slower ones', a pair of
+// the same level is taken from its lower id
+void Reactor::collect_tick_contacts(Time t) {
+    const ParticleManager *pm = particles;
+    tick_contacts.clear();
+
+    for (size_t i = 0; i < tick_active.size(); ++i) {
+        const Slot sa = tick_active[i];
+        const int la = level_of[sa];
+        const float xa = pm->pos_x[sa], ya = pm->pos_y[sa], ra = pm->radius[sa];
+        for (int l = 0; l <= la; ++l) {
+            const CellGrid &g = level_grid[l];
+            if (g.slots.empty()) continue;
+
+            const double reach = ra + g.r_max + tick_slack;
+
+            const int cx0 = cell_of_coord((xa - reach) / g.cell_w, g.nx);
+            const int cx1 = cell_of_coord((xa + reach) / g.cell_w, g.nx);
+            const int cy0 = cell_of_coord((ya - reach) / g.cell_h, g.ny);
+            const int cy1 = cell_of_coord((ya + reach) / g.cell_h, g.ny);
+            for (int cy = cy0; cy <= cy1; ++cy) {
+                for (int cx = cx0; cx <= cx1; ++cx) {
+                    const unsigned c = (unsigned)(cx + cy * g.nx);
+                    for (unsigned j = g.cell_start[c]; j < g.cell_start[c + 1]; ++j) {
+                        // where the grid has it first, then where it is
+                        const double gx = (double)g.x[j] - xa, gy = (double)g.y[j] - ya;
+                        const double gr = (double)g.r[j] + ra + tick_slack;
+                        if (gx * gx + gy * gy > gr * gr) continue;
+
+                        const Slot sb = g.slots[j];
+                        if (!pm->alive[sb] || level_of[sb] != l) continue;
+                        if (l == la && pm->id[sb] <= pm->id[sa]) continue;
+
+                        const double dt_b = t - pm->last_moved[sb];
+                        const double dx = pm->pos_x[sb] + pm->vel_x[sb] * dt_b - xa;
+                        const double dy = pm->pos_y[sb] + pm->vel_y[sb] * dt_b - ya;
+                        const double rr = (double)ra + pm->radius[sb];
+                        if (dx * dx + dy * dy > rr * rr) continue;
+
+                        ContactPair cp;
+                        cp.sa = pm->id[sa] < pm->id[sb] ? sa : sb;
+                        cp.sb = cp.sa == sa ? sb : sa;
+                        cp.id_a = pm->id[cp.sa];
+                        cp.id_b = pm->id[cp.sb];
+                        tick_contacts.push_back(cp);
+                    }
+                }
+            }
+        }
+    }
+    std::sort(tick_contacts.begin(), tick_contacts.end(), contact_before);
+}
+
+// collides the pairs, then gives everything with a new trajectory the level
+// it needs; until then the grids have them at their old ones
+size_t Reactor::resolve_tick_contacts(Time t, int min_level) {
+    ParticleManager *pm = particles;
+    size_t n = 0;
+    for (size_t i = 0; i < tick_contacts.size(); ++i) {
+        const Slot sa = tick_contacts[i].sa, sb = tick_contacts[i].sb;
+        if (!pm->alive[sa] || !pm->alive[sb]) continue;
+
+        drift(sa, t);
+        drift(sb, t);
+        if (!touching(sa, sb)) continue;
+
+        collide_dispatch(this, pm, sa, sb, t, &pm->pending);
+        tick_bounced.push_back(sa);
+        tick_bounced.push_back(sb);
+        ++n;
+    }
+    for (size_t i = 0; i < tick_bounced.size(); ++i) {
+        const Slot s = tick_bounced[i];
+        if (pm->alive[s]) set_level(s, std::max(required_level(s), min_level));
+    }
+
+    tick_added.clear();
+    pm->flush_deferred(&tick_added);
+    for (size_t i = 0; i < tick_added.size(); ++i) {
+        set_level(tick_added[i], std::max(required_level(tick_added[i]), min_level));
+    }
+    return n;
+}
+
+void Reactor::step_multirate(Time dt) {
+    ParticleManager *pm = particles;
+    const int n_ticks = 1 << top_level;
+    const double h = dt / n_ticks;
+    const float Yh = (float)box_h;
+
+    for (int k = 1; k <= n_ticks; ++k) {
+        const Time t = k == n_ticks ? tick_t0 + dt : tick_t0 + k * h;
+        int zeros = 0;
+        while (!((k >> zeros) & 1)) ++zeros;
+        const int min_level = top_level - zeros;
+
+        box_w = wall_pos(Side::RIGHT, t);
+        gather_tick(min_level);
+
+        const float Xw = (float)box_w;
+        tick_bounced.clear();
+        for (size_t i = 0; i < tick_active.size(); ++i) {
+            const Slot s = tick_active[i];
+            const int gen = pm->gen[s];
+            drift(s, t);
+            bounce_walls(s, t, Xw, Yh);
+            if (pm->gen[s] != gen) tick_bounced.push_back(s);
+        }
+
+        collect_tick_contacts(t);
+        frame_collisions += resolve_tick_contacts(t, min_level);
+        sim_now = t;
+
+        // the next frame plans its own
+        if (k < n_ticks) list_levels(min_level);
+    }
+}
@@ -0,0 +1,180 @@
+#include <algorithm>
+
+#include "../reactor.hpp"
+
+/*
+ * The fixed substep spread over the WorkPool. Integration and the wall scan
+ * run over fixed chunks of slots; the few wall hits then bounce on the
+ * calling thread, in slot order, as the wall probe records every one.
+ *
+ * Contacts are collected per block of grid cells, a pair going to the
+ * block of the earlier of its two cells. Every particle of a pair lies in
+ * that cell or next to it, so blocks at least two cells wide that are
+ * two blocks apart never share a particle. The blocks are resolved in four
+ * checkerboard phases, each block of a phase on its own, and queue their
+ * merges and bursts separately; the queues are applied in block order once
+ * all phases are done
+ */
+
+static const int SLOT_CHUNK = 4096;        // slots per integration and wall scan chunk
+static const int CONTACT_BLOCK_CELLS = 8;  // grid cells per block side, 2 at least
+
+void Reactor::integrate_chunks(void *self, int i0, int i1) {
+    Reactor *r = static_cast<Reactor*>(self);
+    ParticleManager *pm = r->particles;
+    r->kernels->integrate(&pm->pos_x[i0], &pm->pos_y[i0], &pm->vel_x[i0], &pm->vel_y[i0],
+                          (size_t)(i1 - i0), (float)r->job_dt);
+    std::fill(pm->last_moved.begin() + i0, pm->last_moved.begin() + i1, r->job_t + r->job_dt);
+}
+
+void Reactor::integrate_positions(Time t0, Time dt) {
+    job_t = t0;
+    job_dt = dt;
+    pool->run((int)particles->capacity(), SLOT_CHUNK, integrate_chunks, this);
+}
+
+void Reactor::wall_scan_chunks(void *self, int i0, int i1) {
+    Reactor *r = static_cast<Reactor*>(self);
+    const ParticleManager *pm = r->particles;
+
+    std::vector<Slot> &hits = r->chunk_hits[i0 / SLOT_CHUNK];
+    hits.resize((size_t)(i1 - i0));
+    const size_t n = r->kernels->wall_scan(&pm->pos_x[i0], &pm->pos_y[i0], &pm->radius[i0], &pm->alive[i0],
+                                           (size_t)(i1 - i0), (float)r->wall_pos(Side::RIGHT, r->job_t),
+                                           (float)r->box_h, &hits[0]);
+    hits.resize(n);
+    for (size_t k = 0; k < n; ++k) hits[k] += (Slot)i0;
+}
+
+// the kernel finds the few particles past a wall, they bounce one by one;
+// the tests are the kernel's, in float
+void Reactor::handle_walls(Time now) {
+    const int n = (int)particles->capacity();
+    if (n == 0) return;
+
+    job_t = now;
+    chunk_hits.resize((size_t)((n + SLOT_CHUNK - 1) / SLOT_CHUNK));
+    pool->run(n, SLOT_CHUNK, wall_scan_chunks, this);
+
+    const float Xw = (float)wall_pos(Side::RIGHT, now);
+    const float Yh = (float)box_h;
+    for (size_t c = 0; c < chunk_hits.size(); ++c) {
+        for (size_t i = 0; i < chunk_hits[c].size(); ++i) bounce_walls(chunk_hits[c][i], now, Xw, Yh);
+    }
+}
+
+void Reactor::test_contact(std::vector<ContactPair> *out, unsigned i, unsigned j) const {
+    const CellGrid &g = contact_grid;
+    const double dx = (double)g.x[j] - g.x[i];
+    const double dy = (double)g.y[j] - g.y[i];
+    const double rr = g.r[i] + g.r[j];
+    if (dx * dx + dy * dy > rr * rr) return;
+
+    ContactPair cp;
+    cp.sa = g.slots[i];
+    cp.sb = g.slots[j];
+    if (particles->id[cp.sb] < particles->id[cp.sa]) std::swap(cp.sa, cp.sb);
+    cp.id_a = particles->id[cp.sa];
+    cp.id_b = particles->id[cp.sb];
+    out->push_back(cp);
+}
+
+// overlapping pairs from the block's cells, in contact_before order; a pair
+// is tested from the earlier of its cells, so every cell looks at itself
+// and the four neighbours after it
+void Reactor::collect_block(int b) {
+    static const int NEXT_X[4] = { 1, -1, 0, 1 };
+    static const int NEXT_Y[4] = { 0,  1, 1, 1 };
+
+    const CellGrid &g = contact_grid;
+    std::vector<ContactPair> &out = block_contacts[b];
+    out.clear();
+
+    const int bx = b % blocks_x, by = b / blocks_x;
+    const int cx_end = std::min(g.nx, (bx + 1) * CONTACT_BLOCK_CELLS);
+    const int cy_end = std::min(g.ny, (by + 1) * CONTACT_BLOCK_CELLS);
+    for (int cy = by * CONTACT_BLOCK_CELLS; cy < cy_end; ++cy) {
+        for (int cx = bx * CONTACT_BLOCK_CELLS; cx < cx_end; ++cx) {
+            const unsigned c = (unsigned)(cx + cy * g.nx);
+            const unsigned end = g.cell_start[c + 1];
+            for (unsigned i = g.cell_start[c]; i < end; ++i) {
+                for (unsigned j = i + 1; j < end; ++j) test_contact(&out, i, j);
+
+                for (int k = 0; k < 4; ++k) {
+                    const int ox = cx + NEXT_X[k], oy = cy + NEXT_Y[k];
+                    if (ox < 0 || ox >= g.nx || oy >= g.ny) continue;
+                    const unsigned o = (unsigned)(ox + oy * g.nx);
+                    for (unsigned j = g.cell_start[o]; j < g.cell_start[o + 1]; ++j) test_contact(&out, i, j);
+                }
+            }
+        }
+    }
+    std::sort(out.begin(), out.end(), contact_before);
+}
+
+void Reactor::collect_blocks(void *self, int b0, int b1) {
+    Reactor *r = static_cast<Reactor*>(self);
+    for (int b = b0; b < b1; ++b) r->collect_block(b);
+}
+
+void Reactor::collect_contacts() {
+    contact_grid.build(*particles, box_w, box_h);
+    blocks_x = (contact_grid.nx + CONTACT_BLOCK_CELLS - 1) / CONTACT_BLOCK_CELLS;
+    blocks_y = (contact_grid.ny + CONTACT_BLOCK_CELLS - 1) / CONTACT_BLOCK_CELLS;
+
+    const int n_blocks = blocks_x * blocks_y;
+    if ((int)block_contacts.size() < n_blocks) {
+        block_contacts.resize(n_blocks);
+        block_changes.resize(n_blocks);
+        block_collisions.resize(n_blocks);
+    }
+    pool->run(n_blocks, 1, collect_blocks, this);
+}
+
+// collide every collected pair that still overlaps; merges and fragments
+// land in the block's queue, so the slots stay valid throughout
+void Reactor::resolve_block(int b) {
+    const std::vector<ContactPair> &pairs = block_contacts[b];
+    size_t n = 0;
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        const Slot sa = pairs[i].sa, sb = pairs[i].sb;
+        if (!particles->alive[sa] || !particles->alive[sb]) continue;
+
+        // an earlier pair may have grown or moved one of them
+        if (!touching(sa, sb)) continue;
+
+        collide_dispatch(this, particles, sa, sb, job_t, &block_changes[b]);
+        ++n;
+    }
+    block_collisions[b] = n;
+}
+
+// the k-th block of the phase's checkerboard color
+void Reactor::resolve_blocks(void *self, int k0, int k1) {
+    Reactor *r = static_cast<Reactor*>(self);
+    const int px = r->job_phase & 1, py = r->job_phase >> 1;
+    const int per_row = (r->blocks_x - px + 1) / 2;
+    for (int k = k0; k < k1; ++k) {
+        const int bx = px + 2 * (k % per_row);
+        const int by = py + 2 * (k / per_row);
+        r->resolve_block(bx + by * r->blocks_x);
+    }
+}
+
+size_t Reactor::resolve_contacts(Time now) {
+    job_t = now;
+    for (job_phase = 0; job_phase < 4; ++job_phase) {
+        const int px = job_phase & 1, py = job_phase >> 1;
+        const int n = ((blocks_x - px + 1) / 2) * ((blocks_y - py + 1) / 2);
+        pool->run(n, 1, resolve_blocks, this);
+    }
+
+    const int n_blocks = blocks_x * blocks_y;
+    size_t n = 0;
+    for (int b = 0; b < n_blocks; ++b) {
+        n += block_collisions[b];
+        particles->apply_removals(&block_changes[b]);
+    }
+    for (int b = 0; b < n_blocks; ++b) particles->apply_additions(&block_changes[b]);
+    return n;
+}
@@ -0,0 +1,109 @@
+#include <cstdlib>
+#include <stdexcept>
+
+#include "work_pool.hpp"
+
+WorkPool::WorkPool(int n_workers)
+        : threads(NULL), n_threads(0),
+          fn(NULL), user(NULL), n_items(0), chunk(1),
+          busy(0), generation(0), stop(false) {
+    if (n_workers < 0) n_workers = SDL_GetNumLogicalCPUCores() - 1;
+
+    const char *cap = SDL_getenv("AREACTOR_THREADS");
+    if (cap && std::atoi(cap) > 0 && std::atoi(cap) - 1 < n_workers) n_workers = std::atoi(cap) - 1;
+    if (n_workers < 0) n_workers = 0;
+
+    SDL_SetAtomicInt(&next_chunk, 0);
+
+    mtx = SDL_CreateMutex();
+    cv_work = SDL_CreateCondition();
+    cv_done = SDL_CreateCondition();
+    if (!mtx || !cv_work || !cv_done) throw std::runtime_error(SDL_GetError());
+
+    threads = new SDL_Thread*[n_workers > 0 ? n_workers : 1];
+    for (int i = 0; i < n_workers; ++i) {
+        threads[n_threads] = SDL_CreateThread(WorkPool::worker_entry, "areactor_step", this);
+        if (!threads[n_threads]) {
+            SDL_Log("Couldn't create step thread: %s", SDL_GetError());
+            break;
+        }
+        ++n_threads;
+    }
+}
+
+WorkPool::~WorkPool() {
+    SDL_LockMutex(mtx);
+    stop = true;
+    SDL_BroadcastCondition(cv_work);
+    SDL_UnlockMutex(mtx);
+
+    for (int i = 0; i < n_threads; ++i) SDL_WaitThread(threads[i], NULL);
+    delete[] threads;
+
+    SDL_DestroyCondition(cv_done);
+    SDL_DestroyCondition(cv_work);
+    SDL_DestroyMutex(mtx);
+}
+
+void WorkPool::run(int items, int chunk_items, RangeFn chunk_fn, void *chunk_user) {
+    if (items <= 0) return;
+
+    // a single chunk isn't worth waking anyone
+    if (n_threads == 0 || items <= chunk_items) {
+        chunk_fn(chunk_user, 0, items);
+        return;
+    }
+
+    SDL_LockMutex(mtx);
+    fn      = chunk_fn;
+    user    = chunk_user;
+    n_items = items;
+    chunk   = chunk_items > 0 ? chunk_items : 1;
+    SDL_SetAtomicInt(&next_chunk, 0);
+    busy    = n_threads;
+    ++generation;
+    SDL_BroadcastCondition(cv_work);
+    SDL_UnlockMutex(mtx);
+
+    work();
+
+    SDL_LockMutex(mtx);
+    while (busy > 0) SDL_WaitCondition(cv_done, mtx);
+    SDL_UnlockMutex(mtx);
+}
+
+void WorkPool::work() {
+    for (;;) {
+        const int i0 = SDL_AddAtomicInt(&next_chunk, 1) * chunk;
+        if (i0 >= n_items) break;
+
+        const int i1 = i0 + chunk < n_items ? i0 + chunk : n_items;
+        fn(user, i0, i1);
+    }
+}
+
+int WorkPool::worker_entry(void *self_void) {
+    WorkPool *self = static_cast<WorkPool*>(self_void);
+    Uint32 seen = 0;
+
+    for (;;) {
+        SDL_LockMutex(self->mtx);
+        while (!self->stop && self->generation == seen) {
+            SDL_WaitCondition(self->cv_work, self->mtx);
+        }
+        if (self->stop) {
+            SDL_UnlockMutex(self->mtx);
+            break;
+        }
+        seen = self->generation;
+        SDL_UnlockMutex(self->mtx);
+
+        self->work();
+
+        SDL_LockMutex(self->mtx);
+        if (--self->busy == 0) SDL_SignalCondition(self->cv_done);
+        SDL_UnlockMutex(self->mtx);
+    }
+
+    return 0;
+}
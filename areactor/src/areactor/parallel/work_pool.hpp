@@ -0,0 +1,47 @@
+#pragma once
+#include <SDL3/SDL.h>
+
+// works on items [i0, i1) of whatever `user` describes
+typedef void (*RangeFn)(void *user, int i0, int i1);
+
+/*
+ * Persistent worker threads that split a job into chunks of items.
+ * Chunks are claimed dynamically and the calling thread works too, so
+ * which thread runs a chunk is up to chance; jobs that must not depend
+ * on the thread count only let the chunking decide their results
+ */
+class WorkPool {
+    SDL_Thread **threads;
+    int n_threads;
+
+    SDL_Mutex *mtx;
+    SDL_Condition *cv_work;
+    SDL_Condition *cv_done;
+
+    // current job, written under mtx before a new generation starts
+    RangeFn fn;
+    void *user;
+    int n_items;
+    int chunk;
+    SDL_AtomicInt next_chunk;
+
+    int busy;           // workers still inside the current job
+    Uint32 generation;  // bumped per job
+    bool stop;
+
+    static int worker_entry(void *self_void);
+    void work();
+
+    WorkPool(const WorkPool &);
+    WorkPool &operator=(const WorkPool &);
+public:
+    // n_workers < 0 picks one per logical core, minus the calling thread;
+    // AREACTOR_THREADS caps the total
+    explicit WorkPool(int n_workers = -1);
+    ~WorkPool();
+
+    int size() const { return n_threads + 1; }
+
+    // returns once fn ran over every item
+    void run(int items, int chunk_items, RangeFn chunk_fn, void *chunk_user);
+};
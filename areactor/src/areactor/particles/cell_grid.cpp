@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <cmath>
+
+#include "cell_grid.hpp"
+
+// cells per live particle at most; tiny particles in a big frame would
+// otherwise leave the rebuild clearing mostly empty cells
+static const double CELLS_PER_PARTICLE = 2.0;
+
+void CellGrid::build(const ParticleManager &pm, const std::vector<Slot> &act, double w, double h) {
+
+    r_max = 0.0f;
+    size_t live = 0;
+    for (size_t i = 0; i < act.size(); ++i) {
+        const Slot s = act[i];
+        if (!pm.alive[s]) continue;
+        r_max = std::max(r_max, pm.radius[s]);
+        ++live;
+    }
+
+    const double by_count = std::sqrt(w * h / (CELLS_PER_PARTICLE * (double)std::max(live, (size_t)1)));
+    const double side = std::max(2.0 * (double)r_max, by_count);
+    nx = std::max(1, (int)(w / side));
+    ny = std::max(1, (int)(h / side));
+    cell_w = w / nx;
+    cell_h = h / ny;
+
+    const size_t n_cells = (size_t)nx * ny;
+    cell_start.assign(n_cells + 1, 0);
+    item_cell.resize(act.size());
+    for (size_t i = 0; i < act.size(); ++i) {
+        const Slot s = act[i];
+        if (!pm.alive[s]) continue;
+        item_cell[i] = cell_index(pm.pos_x[s], pm.pos_y[s]);
+        ++cell_start[item_cell[i] + 1];
+    }
+    for (size_t c = 0; c < n_cells; ++c) cell_start[c + 1] += cell_start[c];
+
+    slots.resize(live);
+    x.resize(live);
+    y.resize(live);
+    r.resize(live);
+    for (size_t i = 0; i < act.size(); ++i) {
+        const Slot s = act[i];
+        if (!pm.alive[s]) continue;
+        const unsigned k = cell_start[item_cell[i]]++;
+        slots[k] = s;
+        x[k] = pm.pos_x[s];
+        y[k] = pm.pos_y[s];
+        r[k] = pm.radius[s];
+    }
+
+    // filling advanced every start to the next cell's, shift them back
+    for (size_t c = n_cells; c > 0; --c) cell_start[c] = cell_start[c - 1];
+    cell_start[0] = 0;
+}
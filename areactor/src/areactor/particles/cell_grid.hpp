@@ -0,0 +1,40 @@
+#pragma once
+#include <cmath>
+#include <vector>
+
+#include "particle_manager.hpp"
+
+/*
+ * Uniform grid of the live particles, rebuilt from scratch by a counting
+ * sort. Cells are at least as wide as the widest particle, so every contact
+ * of a particle lies in its 3x3 neighbourhood. Slots are listed cell by
+ * cell and their positions and radii copied in the same order, so scanning
+ * a neighbourhood reads a few contiguous runs instead of chasing slots
+ */
+class CellGrid {
+    std::vector<unsigned> item_cell;  // scratch, cell of each active slot
+public:
+    int nx, ny;
+    double cell_w, cell_h;
+    float r_max;                       // of the particles sorted in
+    std::vector<unsigned> cell_start;  // nx * ny + 1 offsets into the lists below
+    std::vector<Slot> slots;           // live slots, cell by cell
+    std::vector<float> x, y, r;        // their positions and radii
+
+    CellGrid() : nx(0), ny(0), cell_w(0.0), cell_h(0.0), r_max(0.0f) {}
+
+    // lays the grid over [0, w] x [0, h] and sorts the live particles into it;
+    // positions outside fall into the border cells
+    void build(const ParticleManager &pm, double w, double h) {
+        build(pm, pm.active_slots, w, h);
+    }
+
+    // the same for the live ones of act
+    void build(const ParticleManager &pm, const std::vector<Slot> &act, double w, double h);
+
+    unsigned cell_index(float px, float py) const {
+        const int cx = clamp((int)std::floor(px / cell_w), 0, nx - 1);
+        const int cy = clamp((int)std::floor(py / cell_h), 0, ny - 1);
+        return (unsigned)(cx + cy * nx);
+    }
+};
@@ -3,27 +3,23 @@
 
 class Reactor;
 
-typedef void (*CollideFn)(Reactor *r, Particle *a, Particle *b, Time now);
+// merges and bursts queue their particle changes in q, the sweep applies them
+typedef void (*CollideFn)(Reactor *r, Slot a, Slot b, Time now, ParticleChanges *q);
 
-void collide_impl(Reactor *r, ParticleCircle *A, ParticleCircle *B, Time now);
-void collide_impl(Reactor *r, ParticleCircle *A, ParticleSquare *B, Time now);
-void collide_impl(Reactor *r, ParticleSquare *A, ParticleCircle *B, Time now);
-void collide_impl(Reactor *r, ParticleSquare *A, ParticleSquare *B, Time now);
-
-template <typename A, typename B>
-inline void thunk(Reactor *r, Particle *a, Particle *b, Time now) {
-	collide_impl(r, static_cast<A*>(a), static_cast<B*>(b), now);
-}
+void collide_circle_circle(Reactor *r, Slot a, Slot b, Time now, ParticleChanges *q);
+void collide_circle_square(Reactor *r, Slot a, Slot b, Time now, ParticleChanges *q);
+void collide_square_circle(Reactor *r, Slot a, Slot b, Time now, ParticleChanges *q);
+void collide_square_square(Reactor *r, Slot a, Slot b, Time now, ParticleChanges *q);
 
 static CollideFn g_collide_tbl[ParticleType::__COUNT][ParticleType::__COUNT] = {
-    /* A:Circle */ { &thunk<ParticleCircle, ParticleCircle>, &thunk<ParticleCircle, ParticleSquare> },
-    /* A:Square */ { &thunk<ParticleSquare, ParticleCircle>, &thunk<ParticleSquare, ParticleSquare> }
+    /* A:Circle */ { &collide_circle_circle, &collide_circle_square },
+    /* A:Square */ { &collide_square_circle, &collide_square_square }
 };
 
-inline void collide_dispatch(Reactor *r, Particle *a, Particle *b, Time now) {
-	const unsigned ia = a->type_id_;
-	const unsigned ib = b->type_id_;
+inline void collide_dispatch(Reactor *r, const ParticleManager *pm, Slot a, Slot b, Time now, ParticleChanges *q) {
+	const unsigned ia = pm->type[a];
+	const unsigned ib = pm->type[b];
 	assert(ia < ParticleType::__COUNT && ib < ParticleType::__COUNT);
 	CollideFn fn = g_collide_tbl[ia][ib];
-	fn(r, a, b, now);
+	fn(r, a, b, now, q);
 }
@@ -0,0 +1,53 @@
+#include <SDL3/SDL.h>
+#include <cstring>
+#include <limits>
+
+#include "kinematics.hpp"
+
+static void integrate_scalar(float *x, float *y, const float *vx, const float *vy, size_t n, float dt) {
+    for (size_t i = 0; i < n; ++i) {
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+    }
+}
+
+static size_t wall_scan_scalar(const float *x, const float *y, const float *r, const unsigned char *alive,
+                               size_t n, float x_max, float y_max, Slot *out) {
+    size_t hits = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!alive[i]) continue;
+        if (x[i] < r[i] || x[i] > x_max - r[i] || y[i] < r[i] || y[i] > y_max - r[i]) out[hits++] = i;
+    }
+    return hits;
+}
+
+static void speed_bounds_scalar(const float *vx, const float *vy, const float *r, const unsigned char *alive,
+                                size_t n, float *v2_max, float *r_min) {
+    float v2 = 0.0f;
+    float rm = std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < n; ++i) {
+        if (!alive[i]) continue;
+        const float s = vx[i] * vx[i] + vy[i] * vy[i];
+        if (s > v2) v2 = s;
+        if (r[i] < rm) rm = r[i];
+    }
+    *v2_max = v2;
+    *r_min = rm;
+}
+
+static const KinematicKernels KERNELS_SCALAR = { "scalar", integrate_scalar, wall_scan_scalar, speed_bounds_scalar };
+
+static const KinematicKernels *pick_kernels() {
+    const char *cap = SDL_getenv("AREACTOR_SIMD");
+    if (cap && std::strcmp(cap, "scalar") == 0) return &KERNELS_SCALAR;
+
+    const KinematicKernels *avx2 = kinematic_kernels_avx2();
+    if (avx2 && SDL_HasAVX2()) return avx2;
+
+    return &KERNELS_SCALAR;
+}
+
+const KinematicKernels *kinematic_kernels() {
+    static const KinematicKernels *picked = pick_kernels();
+    return picked;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+
+#include "../common.hpp"
+
+/*
+ * Kernels over the particle columns of a ParticleManager, slots [0, n).
+ * Free slots have zero velocity and alive == 0: integration steps them in
+ * place, the scans skip them. Every kernel gives the same floats as the
+ * scalar one, there is no reassociation and no fused multiply-add
+ */
+
+// x += vx * dt, y += vy * dt
+typedef void (*IntegrateFn)(float *x, float *y, const float *vx, const float *vy, size_t n, float dt);
+
+// live slots past a wall into out, ascending; returns how many.
+// walls are x = 0, x = x_max, y = 0 and y = y_max, a particle is past one
+// when its disc crosses it
+typedef size_t (*WallScanFn)(const float *x, const float *y, const float *r, const unsigned char *alive,
+                             size_t n, float x_max, float y_max, Slot *out);
+
+// largest squared speed and smallest radius of the live slots,
+// 0 and +inf when there are none
+typedef void (*SpeedBoundsFn)(const float *vx, const float *vy, const float *r, const unsigned char *alive,
+                              size_t n, float *v2_max, float *r_min);
+
+struct KinematicKernels {
+    const char *name;
+    IntegrateFn integrate;
+    WallScanFn wall_scan;
+    SpeedBoundsFn speed_bounds;
+};
+
+// the best the CPU runs; AREACTOR_SIMD=scalar caps the choice
+const KinematicKernels *kinematic_kernels();
+
+// NULL when the build has no AVX2 code
+const KinematicKernels *kinematic_kernels_avx2();
@@ -0,0 +1,100 @@
+// only these functions are built for AVX2, and only called after SDL_HasAVX2()
+#include "kinematics.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#include <limits>
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// alive bytes i .. i + 7 as a lane mask
+TARGET_AVX2
+static inline __m256 alive_mask(const unsigned char *alive, size_t i) {
+    const __m128i bytes = _mm_loadl_epi64((const __m128i *)(alive + i));
+    const __m256i lanes = _mm256_cvtepu8_epi32(bytes);
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(lanes, _mm256_setzero_si256()));
+}
+
+TARGET_AVX2
+static void integrate_avx2(float *x, float *y, const float *vx, const float *vy, size_t n, float dt) {
+    const __m256 step = _mm256_set1_ps(dt);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(_mm256_loadu_ps(vx + i), step)));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(_mm256_loadu_ps(vy + i), step)));
+    }
+    for (; i < n; ++i) {
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+    }
+}
+
+TARGET_AVX2
+static size_t wall_scan_avx2(const float *x, const float *y, const float *r, const unsigned char *alive,
+                             size_t n, float x_max, float y_max, Slot *out) {
+    const __m256 xm = _mm256_set1_ps(x_max), ym = _mm256_set1_ps(y_max);
+    size_t hits = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pr = _mm256_loadu_ps(r + i);
+        const __m256 past = _mm256_or_ps(
+            _mm256_or_ps(_mm256_cmp_ps(px, pr, _CMP_LT_OQ), _mm256_cmp_ps(px, _mm256_sub_ps(xm, pr), _CMP_GT_OQ)),
+            _mm256_or_ps(_mm256_cmp_ps(py, pr, _CMP_LT_OQ), _mm256_cmp_ps(py, _mm256_sub_ps(ym, pr), _CMP_GT_OQ)));
+
+        int mask = _mm256_movemask_ps(_mm256_and_ps(past, alive_mask(alive, i)));
+        while (mask) {
+            out[hits++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    for (; i < n; ++i) {
+        if (!alive[i]) continue;
+        if (x[i] < r[i] || x[i] > x_max - r[i] || y[i] < r[i] || y[i] > y_max - r[i]) out[hits++] = i;
+    }
+    return hits;
+}
+
+TARGET_AVX2
+static void speed_bounds_avx2(const float *vx, const float *vy, const float *r, const unsigned char *alive,
+                              size_t n, float *v2_max, float *r_min) {
+    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 v2 = _mm256_setzero_ps(), rm = inf;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 live = alive_mask(alive, i);
+        const __m256 sx = _mm256_loadu_ps(vx + i), sy = _mm256_loadu_ps(vy + i);
+        const __m256 s = _mm256_add_ps(_mm256_mul_ps(sx, sx), _mm256_mul_ps(sy, sy));
+        v2 = _mm256_max_ps(v2, _mm256_and_ps(s, live));
+        rm = _mm256_min_ps(rm, _mm256_blendv_ps(inf, _mm256_loadu_ps(r + i), live));
+    }
+
+    float lv[8], lr[8];
+    _mm256_storeu_ps(lv, v2);
+    _mm256_storeu_ps(lr, rm);
+    float best_v2 = 0.0f, best_r = std::numeric_limits<float>::infinity();
+    for (int k = 0; k < 8; ++k) {
+        if (lv[k] > best_v2) best_v2 = lv[k];
+        if (lr[k] < best_r) best_r = lr[k];
+    }
+    for (; i < n; ++i) {
+        if (!alive[i]) continue;
+        const float s = vx[i] * vx[i] + vy[i] * vy[i];
+        if (s > best_v2) best_v2 = s;
+        if (r[i] < best_r) best_r = r[i];
+    }
+    *v2_max = best_v2;
+    *r_min = best_r;
+}
+
+static const KinematicKernels KERNELS_AVX2 = { "avx2", integrate_avx2, wall_scan_avx2, speed_bounds_avx2 };
+
+const KinematicKernels *kinematic_kernels_avx2() {
+    return &KERNELS_AVX2;
+}
+
+#else
+
+const KinematicKernels *kinematic_kernels_avx2() {
+    return NULL;
+}
+
+#endif
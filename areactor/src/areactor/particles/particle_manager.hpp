@@ -1,6 +1,5 @@
 #pragma once
 #include <cstdio>
-#include <tr1/unordered_map>
 #include <vector>
 
 #include <swuix/window/window.hpp>
@@ -9,6 +8,7 @@
 #include "../common.hpp"
 
 class Reactor;
+struct ReactorSnapshot;
 
 static const int BASE_GEN = 1;
 
@@ -20,57 +20,71 @@ struct ParticleType {
 	};
 };
 
-class Particle {
-	const unsigned type_id_;
-public:
-	ParticleID id;
+// per-type draw routine for a particle centered at (x, y) on screen, see particle_render.cpp
+typedef void (*DrawFn)(Window *window, float x, float y, float r);
+
+// the snapshot's particles that are inside the widget
+void draw_particles(Window *window, const Reactor *reactor, const ReactorSnapshot &view);
 
+// a particle to be registered, it takes the next id when it is
+struct ParticleSpawn {
+	unsigned type;
 	Vec2f position;
 	Vec2f velocity;
-	double  radius;
-
-	double  mass;
-	int     gen;
-	bool    alive;
-	Time    last_moved;
+	double radius;
+	double mass;
+	Time t;
+};
 
-	explicit Particle(ParticleID id_, unsigned type_id)
-		: type_id_(type_id), id(id_), mass(1.0), gen(BASE_GEN), alive(true) {}
-	virtual ~Particle() {}
+// sums over the live particles, what the statistics are made of
+struct ParticleTotals {
+	int n[ParticleType::__COUNT];
+	double mass;
+	double px, py;  // momentum
+	double m_v2;    // sum of m |v|^2
 
-	virtual void draw(Window *window, Reactor *reactor) = 0;
+	ParticleTotals() {
+		clear();
+	}
 
-	friend void collide_dispatch(Reactor *r, Particle *a, Particle *b, Time now);
-};
+	void clear() {
+		for (int t = 0; t < ParticleType::__COUNT; ++t) n[t] = 0;
+		mass = px = py = m_v2 = 0.0;
+	}
 
-class ParticleCircle : public Particle {
-	enum { kType = ParticleType::CIRCLE };
-public:
-	ParticleCircle(ParticleID id_, Vec2f p, Vec2f v, double r, double m, Time t)
-			: Particle(id_, kType) {
-		position = p;
-		velocity = v;
-		radius = r;
-		mass = m;
-		last_moved = t;
+	// sign 1 counts a particle in, -1 takes it out
+	void count(int sign, unsigned type_, double m, double vx, double vy) {
+		n[type_] += sign;
+		mass += sign * m;
+		px += sign * m * vx;
+		py += sign * m * vy;
+		m_v2 += sign * m * (vx * vx + vy * vy);
 	}
 
-	void draw(Window *window, Reactor *reactor);
-};
+	// a live particle's velocity or mass changed
+	void change(double m0, double vx0, double vy0, double m1, double vx1, double vy1) {
+		mass += m1 - m0;
+		px += m1 * vx1 - m0 * vx0;
+		py += m1 * vy1 - m0 * vy0;
+		m_v2 += m1 * (vx1 * vx1 + vy1 * vy1) - m0 * (vx0 * vx0 + vy0 * vy0);
+	}
 
-class ParticleSquare : public Particle {
-	enum { kType = ParticleType::SQUARE };
-public:
-	ParticleSquare(ParticleID id_, Vec2f p, Vec2f v, double r, double m, Time t)
-			: Particle(id_, kType) {
-		position = p;
-		velocity = v;
-		radius = r;
-		mass = m;
-		last_moved = t;
+	void merge(const ParticleTotals &o) {
+		for (int t = 0; t < ParticleType::__COUNT; ++t) n[t] += o.n[t];
+		mass += o.mass;
+		px += o.px;
+		py += o.py;
+		m_v2 += o.m_v2;
 	}
+};
 
-	void draw(Window *window, Reactor *reactor);
+// structural changes of a collision sweep, applied once it is done;
+// slots, and with them ids, are given out on application, in queue order. Survivors changed in
+// place during the sweep leave their difference to the totals in delta
+struct ParticleChanges {
+	std::vector<ParticleID> removed;
+	std::vector<ParticleSpawn> added;
+	ParticleTotals delta;
 };
 
 inline int clamp(int value, int min, int max) {
@@ -82,6 +96,8 @@ struct Cell {
 	int y;
 };
 
+// coarse buckets kept up to date slot by slot, for the event engine's cell
+// crossings; the substeps sort into a CellGrid instead
 struct Grid {
 	int nx, ny;
 	double cell_w, cell_h;
@@ -106,10 +122,25 @@ struct Grid {
 	}
 };
 
+/*
+ * Particles live in slots; their state is kept as one column per field so
+ * the kinematic kernels stream it. Columns span every slot ever used, free
+ * slots hold zero velocity and are not alive, so a kernel may run over the
+ * whole range and let a mask or a zero step take care of the holes
+ */
 class ParticleManager {
 public:
-	// (dense) vector of slots
-	std::vector<Particle *> items;
+	// per-slot state
+	std::vector<float> pos_x, pos_y;
+	std::vector<float> vel_x, vel_y;
+	std::vector<float> radius;
+	std::vector<double> mass;
+	std::vector<unsigned char> type;   // ParticleType
+	std::vector<unsigned char> alive;
+	std::vector<ParticleID> id;        // handle of the particle in the slot, of no particle if free
+	std::vector<unsigned> uses;        // times the slot was taken
+	std::vector<int> gen;              // bumped whenever the trajectory changes
+	std::vector<Time> last_moved;      // time the position is for
 
 	// slot metadata for different types of access
 	std::vector<size_t> idx_in_bucket;  // slot -> index inside cell bucket (index into Grid::buckets[cell])
@@ -118,9 +149,12 @@ public:
 	std::vector<Slot> active_slots;     // (dense) vector of live slots
 	std::vector<Slot> freelist;         // free slot stack
 
-	// lookups by ParticleID
-	std::tr1::unordered_map<ParticleID, Slot> slot_of_id;  // index into Particle::items (i.e. slot)
-	ParticleID seq;
+	// structural changes queued while a collision sweep holds slots
+	ParticleChanges pending;
+
+	// kept up to date by add, remove and the setters below, so the
+	// statistics need no pass over the particles; recount() sums afresh
+	ParticleTotals totals;
 
 	Grid *grid;
 
@@ -128,7 +162,75 @@ public:
 		grid = new Grid(nx_, ny_, cw_, ch_);
 	}
 
-	// Add particle items[slot] to a bucket at cell
+	// slots ever used, the extent of every column
+	size_t capacity() const {
+		return pos_x.size();
+	}
+
+	// a slot's use count never comes back to 0, so (slot, 0) is a free slot
+	static ParticleID handle(Slot slot, unsigned use) {
+		return (ParticleID)slot << 32 | use;
+	}
+
+	static Slot slot_of(ParticleID pid) {
+		return (Slot)(pid >> 32);
+	}
+
+	// false once the particle is removed, even if its slot was taken again
+	bool holds(ParticleID pid) const {
+		const Slot slot = slot_of(pid);
+		return slot < capacity() && id[slot] == pid;
+	}
+
+	Vec2f position(Slot slot) const {
+		return Vec2f(pos_x[slot], pos_y[slot]);
+	}
+
+	Vec2f velocity(Slot slot) const {
+		return Vec2f(vel_x[slot], vel_y[slot]);
+	}
+
+	void set_position(Slot slot, const Vec2f &p) {
+		pos_x[slot] = p.x;
+		pos_y[slot] = p.y;
+	}
+
+	void set_velocity(Slot slot, const Vec2f &v) {
+		vel_x[slot] = v.x;
+		vel_y[slot] = v.y;
+	}
+
+	// new velocity of a live particle outside a sweep, e.g. a wall bounce
+	void bounce(Slot slot, float vx, float vy) {
+		totals.change(mass[slot], vel_x[slot], vel_y[slot], mass[slot], vx, vy);
+		vel_x[slot] = vx;
+		vel_y[slot] = vy;
+	}
+
+	// turns a live particle into p during a sweep, in place: it keeps its
+	// slot and id and gets a new trajectory, counted when q is applied
+	void morph(ParticleChanges *q, Slot slot, const ParticleSpawn &p) {
+		q->delta.count(-1, type[slot], mass[slot], vel_x[slot], vel_y[slot]);
+		set_position(slot, p.position);
+		set_velocity(slot, p.velocity);
+		radius[slot] = (float)p.radius;
+		mass[slot] = p.mass;
+		type[slot] = (unsigned char)p.type;
+		last_moved[slot] = p.t;
+		gen[slot]++;
+		q->delta.count(1, type[slot], mass[slot], vel_x[slot], vel_y[slot]);
+	}
+
+	// exact sums again, the running ones gather rounding error
+	void recount() {
+		totals.clear();
+		for (size_t k = 0; k < active_slots.size(); ++k) {
+			const Slot s = active_slots[k];
+			if (alive[s]) totals.count(1, type[s], mass[s], vel_x[s], vel_y[s]);
+		}
+	}
+
+	// Add particle in slot to a bucket at cell
 	void bucket_push(CellHandle cell, Slot slot) {
 		std::vector<Slot> &bucket = grid->buckets[cell];
 		idx_in_bucket[slot] = bucket.size();
@@ -136,7 +238,7 @@ public:
 		cell_of[slot] = cell;
 	}
 
-	// Remove particle items[slot] from a bucket at cell
+	// Remove particle in slot from a bucket at cell
 	void bucket_erase(CellHandle cell, Slot slot) {
 		std::vector<Slot> &bucket = grid->buckets[cell];
 		size_t i = idx_in_bucket[slot];
@@ -158,7 +260,6 @@ public:
 
 	// Erase a particle from registry
 	void active_erase(Slot slot) {
-		delete items[slot];
 		size_t i = pos_in_active[slot];
 		size_t j = active_slots.size() - 1;
 		if (i != j) {
@@ -169,37 +270,128 @@ public:
 		active_slots.pop_back();
 	}
 
-	Slot add(Particle *p) {
-		Slot slot;
-		if (!freelist.empty()) {  // there is unused space
-			slot = freelist.back();  // copy
-			freelist.pop_back();
-			items[slot] = p;
-		} else {  // items vector (with slots) is full
-			slot = items.size();
-			items.push_back(p);
-			idx_in_bucket.push_back(0);  // will be updated before the end of the function
-			cell_of.push_back(0);
-			pos_in_active.push_back(0);
+	// n more free slots at the end of every column, taken after the ones
+	// already free and in slot order
+	void grow(size_t n) {
+		const size_t c0 = capacity(), c1 = c0 + n;
+		pos_x.resize(c1, 0.0f);
+		pos_y.resize(c1, 0.0f);
+		vel_x.resize(c1, 0.0f);
+		vel_y.resize(c1, 0.0f);
+		radius.resize(c1, 0.0f);
+		mass.resize(c1, 0.0);
+		type.resize(c1, 0);
+		alive.resize(c1, 0);
+		id.resize(c1);
+		uses.resize(c1, 0);
+		gen.resize(c1, BASE_GEN);
+		last_moved.resize(c1, 0.0);
+		idx_in_bucket.resize(c1, 0);  // set when the slot is taken
+		cell_of.resize(c1, 0);
+		pos_in_active.resize(c1, 0);
+
+		freelist.insert(freelist.begin(), n, 0);
+		for (size_t k = 0; k < n; ++k) {
+			id[c0 + k] = handle(c0 + k, 0);
+			freelist[n - 1 - k] = c0 + k;
 		}
-		slot_of_id[p->id] = slot;
+	}
+
+	// room for n particles without growing the columns one by one
+	void reserve_free(size_t n) {
+		if (freelist.size() < n) grow(n - freelist.size());
+	}
+
+	Slot add(const ParticleSpawn &p) {
+		reserve_free(1);
+		const Slot slot = freelist.back();
+		freelist.pop_back();
+
+		set_position(slot, p.position);
+		set_velocity(slot, p.velocity);
+		radius[slot] = (float)p.radius;
+		mass[slot] = p.mass;
+		type[slot] = (unsigned char)p.type;
+		alive[slot] = 1;
+		if (++uses[slot] == 0) uses[slot] = 1;
+		id[slot] = handle(slot, uses[slot]);
+		gen[slot] = BASE_GEN;
+		last_moved[slot] = p.t;
+
+		totals.count(1, type[slot], mass[slot], vel_x[slot], vel_y[slot]);
 		active_push(slot);
-		CellHandle cell = grid->cell_index(p->position);
+		CellHandle cell = grid->cell_index(p.position);
 		bucket_push(cell, slot);
 		return slot;
 	}
 
+	Slot add(unsigned type_, Vec2f p, Vec2f v, double r, double m, Time t) {
+		return add(spawn(type_, p, v, r, m, t));
+	}
+
+	static ParticleSpawn spawn(unsigned type_, Vec2f p, Vec2f v, double r, double m, Time t) {
+		ParticleSpawn ps;
+		ps.type = type_;
+		ps.position = p;
+		ps.velocity = v;
+		ps.radius = r;
+		ps.mass = m;
+		ps.t = t;
+		return ps;
+	}
+
+	// a stale handle removes nothing
 	void remove(ParticleID pid) {
-		Slot slot = slot_of_id[pid];
+		if (!holds(pid)) return;
+		Slot slot = slot_of(pid);
 		CellHandle cell = cell_of[slot];
 		bucket_erase(cell, slot);
 
-		if (items[slot]) items[slot]->alive = false;
+		totals.count(-1, type[slot], mass[slot], vel_x[slot], vel_y[slot]);
+
+		// a hole, the kernels step it in place
+		alive[slot] = 0;
+		vel_x[slot] = vel_y[slot] = 0.0f;
 
 		active_erase(slot);
-		slot_of_id.erase(pid);
+		id[slot] = handle(slot, 0);
 
-		items[slot] = NULL;
 		freelist.push_back(slot);
 	}
+
+	// Retire a particle when q is applied; it stops colliding now
+	void defer_remove(ParticleChanges *q, Slot slot) {
+		if (!alive[slot]) return;
+		alive[slot] = 0;
+		q->removed.push_back(id[slot]);
+	}
+
+	// Register a particle when q is applied
+	void defer_add(ParticleChanges *q, unsigned type_, Vec2f p, Vec2f v, double r, double m, Time t) {
+		q->added.push_back(spawn(type_, p, v, r, m, t));
+	}
+
+	// Apply a queue, removals before additions of every queue applied
+	// together so freed slots are reused in queue order
+	void apply_removals(ParticleChanges *q) {
+		for (size_t i = 0; i < q->removed.size(); ++i) remove(q->removed[i]);
+		q->removed.clear();
+		totals.merge(q->delta);
+		q->delta.clear();
+	}
+
+	// slots of the added particles go to `added` if given
+	void apply_additions(ParticleChanges *q, std::vector<Slot> *added = NULL) {
+		reserve_free(q->added.size());
+		for (size_t i = 0; i < q->added.size(); ++i) {
+			Slot slot = add(q->added[i]);
+			if (added) added->push_back(slot);
+		}
+		q->added.clear();
+	}
+
+	void flush_deferred(std::vector<Slot> *added = NULL) {
+		apply_removals(&pending);
+		apply_additions(&pending, added);
+	}
 };
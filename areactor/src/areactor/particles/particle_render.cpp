@@ -4,21 +4,27 @@
 #include "particle_manager.hpp"
 #include "../reactor.hpp"
 
-void ParticleCircle::draw(Window *window, Reactor *reactor) {
-	window->draw_filled_circle_rgb(
-		position.x + reactor->frame.x,
-		position.y + reactor->frame.y,
-		radius,
-		CLR_BLUE
-	);
+static void draw_circle(Window *window, float x, float y, float r) {
+	window->draw_filled_circle_rgb(x, y, r, CLR_BLUE);
 }
 
-void ParticleSquare::draw(Window *window, Reactor *reactor) {
-	window->draw_filled_rect_rgb(
-		frect(position.x + reactor->frame.x - radius,
-			position.y + reactor->frame.y - radius,
-			radius * 2,
-			radius * 2),
-		CLR_RASPBERRY
-	);
+static void draw_square(Window *window, float x, float y, float r) {
+	window->draw_filled_rect_rgb(frect(x - r, y - r, r * 2, r * 2), CLR_RASPBERRY);
+}
+
+static DrawFn g_draw_tbl[ParticleType::__COUNT] = { &draw_circle, &draw_square };
+
+void draw_particles(Window *window, const Reactor *reactor, const ReactorSnapshot &view) {
+	// particles wholly outside the widget would only be clipped away
+	const Rect2F &f = reactor->frame;
+	const float x1 = f.x + f.w, y1 = f.y + f.h;
+
+	for (size_t i = 0; i < view.size(); ++i) {
+		const float x = view.x[i] + f.x, y = view.y[i] + f.y, r = view.r[i];
+		if (x + r < f.x || x - r > x1 || y + r < f.y || y - r > y1) continue;
+
+		const unsigned t = view.type[i];
+		assert(t < ParticleType::__COUNT);
+		g_draw_tbl[t](window, x, y, r);
+	}
 }
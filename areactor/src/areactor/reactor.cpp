@@ -28,31 +28,23 @@ inline void draw_bounding_line(Window *window, Sint16 x1, Sint16 y1, Sint16 x2,
     window->draw_line_rgb(x1, y1, x2, y2, thick, r, g, b);
 }
 
-inline void draw_particles(Window *window, Reactor *reactor) {
-    std::vector<Slot> &active_slots = reactor->particles->active_slots;
-    for (size_t i = 0; i < active_slots.size(); ++i) {
-        Slot slot = active_slots[i];
-        Particle *p = reactor->particles->items[slot];
-        p->draw(window, reactor);
-    }
-}
-
 void Reactor::render(Window *window, float off_x, float off_y) {
     // bg
     window->clear_rect(frame, off_x, off_y, CLR_TIMBERWOLF);
 
-    Stat stats = tally();
+    const ReactorSnapshot &view = this->view();
+    const Stat &stats = view.stat;
 
     // outline
     int16_t x = frame.x, y = frame.y;
     int16_t w = frame.w, h = frame.h;
-    draw_bounding_line(window, x, y, x + w, y, 2, this->wall_gain[Side::TOP]);
-    draw_bounding_line(window, x, y, x, y + h, 2, this->wall_gain[Side::LEFT]);
-    draw_bounding_line(window, x + w, y, x + w, y + h, 2, this->wall_gain[Side::RIGHT]);
-    draw_bounding_line(window, x, y + h, x + w, y + h, 2, this->wall_gain[Side::BOTTOM]);
+    draw_bounding_line(window, x, y, x + w, y, 2, view.wall_gain[Side::TOP]);
+    draw_bounding_line(window, x, y, x, y + h, 2, view.wall_gain[Side::LEFT]);
+    draw_bounding_line(window, x + w, y, x + w, y + h, 2, view.wall_gain[Side::RIGHT]);
+    draw_bounding_line(window, x, y + h, x + w, y + h, 2, view.wall_gain[Side::BOTTOM]);
 
     // particles
-    draw_particles(window, this);
+    draw_particles(window, this, view);
 
     std::ostringstream oss;
 
@@ -74,14 +66,24 @@ void Reactor::render(Window *window, float off_x, float off_y) {
 DispatchResult Reactor::on_idle(DispatcherCtx ctx, const IdleEvent *e) {
     (void)ctx;
     ReactorState *rst = (ReactorState*)state;
-    if (rst->add_particle) add_particles(sim_now, 2);
-    if (rst->delete_particle) remove_particle();
+    if (rst->add_particle) request(SimCommand::ADD_PARTICLES, 2);
+    if (rst->delete_particle) request(SimCommand::REMOVE_PARTICLES, 1);
 
     if (rst->wall_speed_changed) {
-        set_right_wall_velocity(rst->wall_speed);
+        request(SimCommand::WALL_VELOCITY, rst->wall_speed);
         rst->wall_speed_changed = false;
     }
-    step_frame(e->dt_s);
+
+    // without a simulation thread the frame's time is stepped here
+    if (!sim) {
+        step_frame(e->dt_s);
+        publish();
+    }
+
+    if (snapshots.acquire()) {
+        frame.w = view().box_w;
+        refresh_layout();
+    }
     return PROPAGATE;
 }
 
@@ -99,6 +101,15 @@ DispatchResult Reactor::on_key_down(DispatcherCtx ctx, const KeyDownEvent *e) {
         ((ReactorState*)state)->wall_speed -= 40;
         ((ReactorState*)state)->wall_speed_changed = true;
     }
+    if (e->scancode == SDL_SCANCODE_E) {
+        request(SimCommand::TOGGLE_EVENTS, 0);
+    }
+    if (e->scancode == SDL_SCANCODE_EQUALS) {
+        request(SimCommand::SCALE_SPEED, 2.0);
+    }
+    if (e->scancode == SDL_SCANCODE_MINUS) {
+        request(SimCommand::SCALE_SPEED, 0.5);
+    }
     return PROPAGATE;
 }
 
@@ -1,15 +1,23 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <limits>
-#include <typeinfo>
 #include <vector>
 
 #include <swuix/widgets/titled.hpp>
 
 #include "linalg/vectors.hpp"
 #include "particles/particle_manager.hpp"
+#include "particles/cell_grid.hpp"
 #include "particles/collision_dispatch.hpp"
+#include "particles/kinematics.hpp"
+#include "parallel/work_pool.hpp"
+#include "events/calendar_queue.hpp"
+#include "events/sim_event.hpp"
+#include "sim/snapshot.hpp"
+#include "sim/sim_thread.hpp"
+#include "sim/triple_buffer.hpp"
 #include "ring_buffer.hpp"
 
 static const double SMALL_RADIUS = 2.0;
@@ -19,6 +27,54 @@ static const int    GRID_H       = 9;
 
 static const double kB = 1.0;
 
+static const double SIM_SPEED_MIN = 1.0 / 64.0;
+static const double SIM_SPEED_MAX = 64.0;
+
+static const double EVENT_DAY_S = 1e-3;  // initial calendar day width
+
+// The right wall never closes the box below the widest particle's diameter
+// plus this much, a particle touching both walls at once would bounce
+// between them at the same instant forever
+static const double MIN_BOX_SLACK = 2.0 * SMALL_RADIUS;
+static const double WALL_REST_PX  = 1e-6;  // a wall this close to its limit rests there
+
+// In a crowded cell every prediction scans dozens of neighbours, and in a
+// gas that reacts fast every merge or burst re-predicts them; fixed substeps
+// are cheaper there. Mean particles per grid cell and collisions per particle
+// per frame above which the substeps take over, and below which events return
+static const double EVENT_CROWDED_PER_CELL = 14.0;
+static const double EVENT_SPARSE_PER_CELL  = 10.0;
+static const double EVENT_BUSY_RATE = 0.5;
+static const double EVENT_CALM_RATE = 0.25;
+
+// Substeps at power-of-two fractions of the frame, down to 1/2^RATE_MAX_LEVEL,
+// each particle checked as often as its own speed needs. Checking one
+// particle on its own costs about RATE_CHECK_COST particles of a whole-gas
+// substep, the multirate frame is taken when that still comes out cheaper
+static const int    RATE_MAX_LEVEL  = 8;
+static const double RATE_CHECK_COST = 6.0;
+
+// published steps between exact recounts of the running totals
+static const int STAT_RECOUNT_STEPS = 600;
+
+// where step_frame spends its time, filled in when Reactor::step_stats is set
+struct StepStats {
+    Uint64 frames;
+    Uint64 event_frames, multirate_frames, substep_frames;
+    Uint64 substeps;
+    Uint64 collisions;
+    Uint64 events_ns;     // event-driven frames, whole
+    Uint64 multirate_ns;  // multirate frames, planning included
+    Uint64 integrate_ns;  // the substeps' phases
+    Uint64 walls_ns;
+    Uint64 contacts_ns;   // broad phase into block lists
+    Uint64 resolve_ns;    // collisions and queued changes
+
+    StepStats()
+        : frames(0), event_frames(0), multirate_frames(0), substep_frames(0), substeps(0), collisions(0),
+          events_ns(0), multirate_ns(0), integrate_ns(0), walls_ns(0), contacts_ns(0), resolve_ns(0) {}
+};
+
 struct WallProbe {
     RingBuffer<double> m_vn2_in_last;
 
@@ -36,6 +92,15 @@ inline double inprev(double x) {
     return nextafter(x, -std::numeric_limits<double>::infinity());
 }
 
+// positions are floats, a particle put just inside a wall has to stay inside in float
+inline float fnext(float x) {
+    return nextafterf(x,  std::numeric_limits<float>::infinity());
+}
+
+inline float fprev(float x) {
+    return nextafterf(x, -std::numeric_limits<float>::infinity());
+}
+
 inline double smallest(double x, double y, double z, double w){
     return std::min(x, std::min(y, std::min(z, w)));
 }
@@ -51,21 +116,6 @@ struct Side {
     };
 };
 
-struct Stat {
-    size_t n;
-    double total_mass;
-    double kinetic;      // thermal kinetic energy
-    double temperature;  // instantaneous T
-    Vec2f  bulk_u;       // mass-weighted mean velocity
-    size_t n_circle;
-    size_t n_square;
-
-    unsigned right_hits;
-    double   right_impulse_sum;
-    double   right_pressure;
-    double   right_temperature;
-};
-
 struct WallSeg {
     Time t0;
     double x0;  // x(t0)
@@ -74,31 +124,121 @@ struct WallSeg {
     WallSeg() : t0(0), x0(0), v(0), gen(1) {}
 };
 
+// overlapping pair found by the broad phase, id_a < id_b
+struct ContactPair {
+    ParticleID id_a, id_b;
+    Slot sa, sb;
+};
+
+// ids order by slot, and slots are given out in queue order, so this
+// order doesn't depend on bucket layout or on the threads
+inline bool contact_before(const ContactPair &x, const ContactPair &y) {
+    if (x.id_a != y.id_a) return x.id_a < y.id_a;
+    return x.id_b < y.id_b;
+}
+
 class Reactor : public TitledWidget {
     ParticleID seq;
 
+    // event-driven stepping, events/event_step.cpp
+    CalendarQueue<SimEvent> events;
+    bool events_primed;
+    bool events_busy;
+    std::vector<Slot> events_added;
+    std::vector<Time> own_event_t;   // slot -> next wall or cell event
+    std::vector<Time> wall_event_t;  // slot -> next wall event
+
+    void drift(Slot s, Time t) const;
+    void predict_pair(Slot sa, Slot sb, Time now);
+    void predict_wall(Slot s, Time now);
+    void predict_cross(Slot s, Time now);
+    void predict_neighbours(Slot s, Time now, bool higher_ids_only);
+    void predict_particle(Slot s, Time now);
+    void prime_events();
+    bool event_live(const SimEvent &ev) const;
+    void on_pair_event(const SimEvent &ev);
+    void on_wall_event(const SimEvent &ev);
+    void on_cross_event(const SimEvent &ev);
+    void step_events(Time dt);
+
     WallSeg right_wall;
+    double right_wall_goal;  // velocity asked for, limit_right_wall may slow it down
     unsigned seg_gen_left;
     unsigned seg_gen_bottom;
     unsigned seg_gen_top;
 
     WallProbe right_probe;
 
-    int compute_substeps(Time dt) const {
-        const std::vector<Slot> &act = particles->active_slots;
+    // fixed substeps, parallel/parallel_step.cpp. The work is cut into
+    // chunks of slots and blocks of grid cells that only depend on the
+    // particles, so the results don't depend on the number of threads
+    WorkPool *pool;
+    const KinematicKernels *kernels;
+    std::vector< std::vector<Slot> > chunk_hits;  // wall hits per chunk of slots
+
+    // broad phase of the substeps; the buckets of ParticleManager::grid are the
+    // event engine's, substeps leave them behind and prime_events catches up
+    CellGrid contact_grid;
+    int blocks_x, blocks_y;
+    std::vector< std::vector<ContactPair> > block_contacts;  // by the block of the earlier cell
+    std::vector<ParticleChanges> block_changes;
+    std::vector<size_t> block_collisions;
+
+    // arguments of the running job
+    Time job_t, job_dt;
+    int job_phase;
+
+    static void integrate_chunks(void *self, int i0, int i1);
+    static void wall_scan_chunks(void *self, int i0, int i1);
+    static void collect_blocks(void *self, int b0, int b1);
+    static void resolve_blocks(void *self, int k0, int k1);
+    void test_contact(std::vector<ContactPair> *out, unsigned i, unsigned j) const;
+    void collect_block(int b);
+    void resolve_block(int b);
+
+    void integrate_positions(Time t0, Time dt);
+    void handle_walls(Time now);
+    void collect_contacts();
+    size_t resolve_contacts(Time now);
+
+    // multirate substeps, multirate/multirate_step.cpp. The frame is cut into
+    // 2^top_level ticks and a particle of level l is checked every
+    // 2^(top_level - l) of them; positions are brought up to date as in the
+    // event engine, and each level has a grid of its own
+    int top_level;
+    Time tick_t0, tick_dt;                // the frame being stepped
+    double tick_disp;                     // displacement allowed between two checks
+    double tick_slack;                    // how far a particle may be from where its grid has it
+    double tick_wall_min;                 // leftmost the right wall gets in the frame
+    unsigned tick_seq;                    // level lists ever compacted
+    std::vector<unsigned char> level_of;  // slot -> level
+    std::vector<unsigned> listed_at;      // slot -> tick_seq of the last compaction that kept it
+    std::vector<Slot> level_slots[RATE_MAX_LEVEL + 1];
+    CellGrid level_grid[RATE_MAX_LEVEL + 1];  // of level_slots, as of the level's last check
+    std::vector<Slot> tick_active;
+    std::vector<Slot> tick_bounced;       // off a wall or another particle
+    std::vector<ContactPair> tick_contacts;
+    std::vector<Slot> tick_added;
+
+    int required_level(Slot s) const;
+    void set_level(Slot s, int level);
+    bool plan_levels(Time dt, int n_uniform);
+    void list_levels(int min_level);
+    void gather_tick(int min_level);
+    void collect_tick_contacts(Time t);
+    size_t resolve_tick_contacts(Time t, int min_level);
+    void step_multirate(Time dt);
 
-        if (act.empty()) return 1;
+    int compute_substeps(Time dt) const {
+        const ParticleManager *pm = particles;
+        if (pm->active_slots.empty()) return 1;
 
-        double vmax = std::abs(wall_vel(Side::RIGHT));
-        double rmin = std::numeric_limits<double>::infinity();
+        float v2_max, r_min;
+        kernels->speed_bounds(&pm->vel_x[0], &pm->vel_y[0], &pm->radius[0], &pm->alive[0],
+                              pm->capacity(), &v2_max, &r_min);
 
-        for (size_t i = 0; i < act.size(); ++i) {
-            const Particle* p = particles->items[act[i]];
-            if (!p || !p->alive) continue;
-            double v = std::sqrt(p->velocity ^ p->velocity);
-            if (v > vmax) vmax = v;
-            if (p->radius < rmin) rmin = p->radius;
-        }
+        const double vmax = std::max((double)std::sqrt(v2_max), std::abs(wall_vel(Side::RIGHT)));
+        double rmin = r_min;
 
         if (!std::isfinite(rmin)) rmin = SMALL_RADIUS;
 
@@ -116,159 +256,237 @@ class Reactor : public TitledWidget {
         return N;
     }
 
-    void integrate_positions(Time t0, Time dt) {
-        std::vector<Slot> &act = particles->active_slots;
-        for (size_t i = 0; i < act.size(); ++i) {
-            Particle* p = particles->items[act[i]];
-            if (!p || !p->alive) continue;
-            p->position += p->velocity * dt;
-            p->last_moved = t0 + dt;
+    // puts the particle against the wall and reflects it, the wall's gain scaling the normal speed
+    void bounce_wall(Slot s, int side, Time now) {
+        ParticleManager *pm = particles;
+        const float r = pm->radius[s];
+        switch (side) {
+            case Side::LEFT:
+                pm->pos_x[s] = fnext(r);
+                pm->bounce(s, -wall_gain[Side::LEFT] * pm->vel_x[s], pm->vel_y[s]);
+                break;
+            case Side::RIGHT: {
+                // moving, the reflection is in the wall's frame
+                const float Xw = (float)wall_pos(Side::RIGHT, now);
+                pm->pos_x[s] = fprev(Xw - r);
+                const double w = wall_vel(Side::RIGHT);
+                const double e = wall_gain[Side::RIGHT];
+                const Vec2f n(-1.0, 0.0);
+                const double vn_in_rel = w - (pm->velocity(s) ^ n);
+                if (vn_in_rel > 0.0) {
+                    this->right_probe.m_vn2_in_last.push(pm->mass[s] * vn_in_rel * vn_in_rel);
+                }
+                const double u = pm->vel_x[s] - w;
+                pm->bounce(s, w - e * u, pm->vel_y[s]);
+                break;
+            }
+            case Side::TOP:
+                pm->pos_y[s] = fnext(r);
+                pm->bounce(s, pm->vel_x[s], -wall_gain[Side::TOP] * pm->vel_y[s]);
+                break;
+            case Side::BOTTOM:
+                pm->pos_y[s] = fprev((float)box_h - r);
+                pm->bounce(s, pm->vel_x[s], -wall_gain[Side::BOTTOM] * pm->vel_y[s]);
+                break;
         }
     }
 
-    void handle_walls(Time now) {
-        std::vector<Slot> &act = particles->active_slots;
-        for (size_t i = 0; i < act.size(); ++i) {
-            Particle* p = particles->items[act[i]];
-            if (!p || !p->alive) continue;
-
-            bool bounced = false;
-            // LEFT
-            if (p->position.x < 0.0 + p->radius) {
-                p->position.x = inext(0.0 + p->radius);
-                p->velocity.x = -wall_gain[Side::LEFT] * p->velocity.x;
-                bounced = true;
-            }
-            // RIGHT (moving)
-            {
-                const double Xw = wall_pos(Side::RIGHT, now);
-                if (p->position.x > Xw - p->radius) {
-                    p->position.x = inprev(Xw - p->radius);
-                    const double w = wall_vel(Side::RIGHT);
-                    const double e = wall_gain[Side::RIGHT];
-                    const Vec2f n(-1.0, 0.0);
-                    const double vn_in_rel = w - (p->velocity ^ n);
-                    if (vn_in_rel > 0.0) {
-                        this->right_probe.m_vn2_in_last.push(p->mass * vn_in_rel * vn_in_rel);
-                    }
-                    const double u = p->velocity.x - w;
-                    p->velocity.x = w - e * u;
-                    bounced = true;
-                }
-            }
-            // TOP
-            if (p->position.y < 0.0 + p->radius) {
-                p->position.y = inext(0.0 + p->radius);
-                p->velocity.y = -wall_gain[Side::TOP] * p->velocity.y;
-                bounced = true;
-            }
-            // BOTTOM
-            if (p->position.y > frame.h - p->radius) {
-                p->position.y = inprev(frame.h - p->radius);
-                p->velocity.y = -wall_gain[Side::BOTTOM] * p->velocity.y;
-                bounced = true;
-            }
-            if (bounced) p->gen++;
+    // bounces s off every wall it is past, with the wall scan's float tests
+    void bounce_walls(Slot s, Time now, float Xw, float Yh) {
+        const ParticleManager *pm = particles;
+        const float r = pm->radius[s];
+
+        bool bounced = false;
+        if (pm->pos_x[s] < r) {
+            bounce_wall(s, Side::LEFT, now);
+            bounced = true;
+        }
+        if (pm->pos_x[s] > Xw - r) {
+            bounce_wall(s, Side::RIGHT, now);
+            bounced = true;
+        }
+        if (pm->pos_y[s] < r) {
+            bounce_wall(s, Side::TOP, now);
+            bounced = true;
+        }
+        if (pm->pos_y[s] > Yh - r) {
+            bounce_wall(s, Side::BOTTOM, now);
+            bounced = true;
         }
+        if (bounced) particles->gen[s]++;
     }
 
     void rebuild_buckets_if_needed() {
         std::vector<Slot>& act = particles->active_slots;
         for (size_t i = 0; i < act.size(); ++i) {
             Slot s = act[i];
-            Particle* p = particles->items[s];
-            if (!p || !p->alive) continue;
-            CellHandle now_c = particles->grid->cell_index(p->position);
+            if (!particles->alive[s]) continue;
+            CellHandle now_c = particles->grid->cell_index(particles->position(s));
             if (now_c != particles->cell_of[s]) {
                 move_cell(s, now_c);
             }
         }
     }
 
-    bool detect_and_collide_pairs(Time now) {
-        // find first overlapping pair and process it
-        std::vector<Slot> &act = particles->active_slots;
-        for (size_t ia = 0; ia < act.size(); ++ia) {
-            Slot sa = act[ia];
-            Particle* A = particles->items[sa];
-            if (!A || !A->alive) continue;
-            Cell c = particles->grid->cell(A->position);
-            for (int dy = -1; dy <= 1; ++dy) {
-                int cy = c.y + dy; if (cy < 0 || cy >= particles->grid->ny) continue;
-                for (int dx = -1; dx <= 1; ++dx) {
-                    int cx = c.x + dx; if (cx < 0 || cx >= particles->grid->nx) continue;
-                    Cell cc;
-                    cc.x = cx;
-                    cc.y = cy;
-                    CellHandle ch = particles->grid->cell_handle(cc);
-                    // NOTE: don't cache size() as bucket can change after collision
-                    for (size_t k = 0; k < particles->grid->buckets[ch].size(); ++k) {
-                        Slot sb = particles->grid->buckets[ch][k];
-                        if (sb == sa) continue;
-                        Particle *B = (sb < particles->items.size()) ? particles->items[sb] : NULL;
-                        if (!B || !B->alive) continue;
-                        if (A->id >= B->id) continue;
-                        const Vec2f d = B->position - A->position;
-                        const double rr = (A->radius + B->radius);
-                        if ((d ^ d) <= rr * rr) {
-                            collide_dispatch(this, A, B, now);
-                            // NOTE: must end here, as collision might've changed the bucket
-                            return true;
-                        }
-                    }
-                }
-            }
-        }
-        return false;
+    bool touching(Slot sa, Slot sb) const {
+        const Vec2f d = particles->position(sb) - particles->position(sa);
+        const double rr = (particles->radius[sa] + particles->radius[sb]);
+        return (d ^ d) <= rr * rr;
     }
 
+    // runs step_frame when started, else on_idle does
+    SimThread *sim;
+    TripleBuffer<ReactorSnapshot> snapshots;
+
 public:
     ParticleManager *particles;
 
     Time sim_now;
+    double sim_speed;  // simulated seconds per real second, on the simulation thread
+
+    // the box the particles move in; box_w follows the right wall, and the
+    // widget's frame follows box_w once the UI sees it in a snapshot
+    double box_w, box_h;
+
+    // advance by predicted events instead of fixed substeps, unless the gas is busy
+    bool event_driven;
+    // take multirate frames when planned cheaper than the uniform substeps
+    bool multirate;
+    size_t frame_collisions;  // during the last step_frame
+    int stat_age;             // steps published since the totals were recounted
+    unsigned spawn_rng;       // rand01 state of add_particles, the seed at first
+    StepStats *step_stats;
 
     double wall_gain[5];
 
     void add_particles(Time t, size_t n) {
         for (size_t i = 0; i < n; ++i) {
-            Vec2f pos = Vec2f::random_rect(frame.w - SMALL_RADIUS * 2, frame.h - SMALL_RADIUS * 2) + Vec2f(SMALL_RADIUS, SMALL_RADIUS);
-            Vec2f vel = Vec2f::random_radial(200, 300);
-            Particle *new_p = new ParticleCircle(particles->seq++, pos, vel, SMALL_RADIUS, 1, t);
-            particles->add(new_p);
+            Vec2f pos = Vec2f::random_rect(box_w - SMALL_RADIUS * 2, box_h - SMALL_RADIUS * 2, &spawn_rng)
+                      + Vec2f(SMALL_RADIUS, SMALL_RADIUS);
+            Vec2f vel = Vec2f::random_radial(200, 300, &spawn_rng);
+            Slot slot = particles->add(ParticleType::CIRCLE, pos, vel, SMALL_RADIUS, 1, t);
+            if (events_primed) predict_particle(slot, t);
         }
     }
 
-    void remove_particle() {
-        size_t n = particles->active_slots.size();
-        if (n == 0) return;
-        particles->remove(particles->items[particles->active_slots[n - 1]]->id);
-    }
-
     void remove_particles(size_t request) {
         size_t n = particles->active_slots.size();
         if (n < request) request = n;
         for (size_t i = 0; i < request; ++i, --n) {
-            particles->remove(particles->items[particles->active_slots[n - 1]]->id);
+            particles->remove(particles->id[particles->active_slots[n - 1]]);
         }
     }
 
-    Reactor(Rect2F rect, Widget *parent_, size_t n, State *s)
-        : Widget(rect, parent_, s), TitledWidget(rect, parent_, s), seq(0), right_probe() {
+    // threads stepping the substeps, the caller's included
+    int threads() const {
+        return pool->size();
+    }
+
+    Reactor(Rect2F rect, Widget *parent_, size_t n, State *s, unsigned seed = 1)
+        : Widget(rect, parent_, s), TitledWidget(rect, parent_, s), seq(0),
+          events(EVENT_DAY_S), events_primed(false), events_busy(false), right_probe(),
+          pool(new WorkPool()), kernels(kinematic_kernels()), blocks_x(0), blocks_y(0),
+          job_t(0.0), job_dt(0.0), job_phase(0), top_level(0), tick_seq(0), sim(NULL) {
             particles = new ParticleManager(16, 9, rect.w / (double)GRID_W, rect.h / (double)GRID_H);
             sim_now = 0.0;
+            sim_speed = 1.0;
+            box_w = rect.w;
+            box_h = rect.h;
+            event_driven = true;
+            multirate = true;
+            frame_collisions = 0;
+            stat_age = 0;
+            spawn_rng = seed;
+            step_stats = NULL;
 
             right_wall.t0 = sim_now;
-            right_wall.x0 = frame.w;
+            right_wall.x0 = box_w;
             right_wall.v = 0.0;
             right_wall.gen = 1;
+            right_wall_goal = 0.0;
 
             for (int i = 0; i < 5; ++i) wall_gain[i] = 1.0;
 
             seg_gen_left = seg_gen_bottom = seg_gen_top = 1;
 
             add_particles(sim_now, n);
+            publish();
+            snapshots.acquire();
         }
 
+    ~Reactor() {
+        delete sim;
+        delete pool;
+    }
+
+    // steps on a thread of its own from now on, paced by the real time
+    void start_sim_thread() {
+        if (!sim) sim = new SimThread(this);
+    }
+
+    // from the UI thread; the simulation thread applies it before its next step
+    void request(int kind, double value, int side = 0) {
+        SimCommand c;
+        c.kind = kind;
+        c.side = side;
+        c.value = value;
+        if (sim) {
+            sim->post(c);
+        } else {
+            apply(c);
+        }
+    }
+
+    void apply(const SimCommand &c) {
+        switch (c.kind) {
+            case SimCommand::ADD_PARTICLES:    add_particles(sim_now, (size_t)c.value); break;
+            case SimCommand::REMOVE_PARTICLES: remove_particles((size_t)c.value); break;
+            case SimCommand::WALL_VELOCITY:    set_right_wall_velocity(c.value); break;
+            case SimCommand::WALL_GAIN:        add_to_wall_gain((uint8_t)c.side, c.value); break;
+            case SimCommand::TOGGLE_EVENTS:    event_driven = !event_driven; break;
+            case SimCommand::SCALE_SPEED:
+                sim_speed = std::max(SIM_SPEED_MIN, std::min(SIM_SPEED_MAX, sim_speed * c.value));
+                break;
+        }
+    }
+
+    // copies what the UI shows into a snapshot for view()
+    void publish() {
+        ReactorSnapshot &v = snapshots.back();
+        const ParticleManager *pm = particles;
+        const std::vector<Slot> &act = pm->active_slots;
+
+        v.x.resize(act.size());
+        v.y.resize(act.size());
+        v.r.resize(act.size());
+        v.type.resize(act.size());
+        for (size_t k = 0; k < act.size(); ++k) {
+            const Slot s = act[k];
+            v.x[k] = pm->pos_x[s];
+            v.y[k] = pm->pos_y[s];
+            v.r[k] = pm->radius[s];
+            v.type[k] = pm->type[s];
+        }
+
+        if (++stat_age >= STAT_RECOUNT_STEPS) {
+            particles->recount();
+            stat_age = 0;
+        }
+        v.stat = tally();
+        v.box_w = box_w;
+        v.box_h = box_h;
+        for (int i = 0; i < 5; ++i) v.wall_gain[i] = wall_gain[i];
+        v.sim_now = sim_now;
+        v.speed = sim_speed;
+        v.event_driven = event_driven;
+        snapshots.publish();
+    }
+
+    // the newest snapshot as of the UI's last on_idle
+    const ReactorSnapshot &view() const {
+        return snapshots.front();
+    }
+
     void set_wall_gain(uint8_t side, double g) {
         assert(side < Side::__COUNT);
         if (g < 0.0) g = 0.0;
@@ -287,82 +505,115 @@ public:
     }
 
     // TODO: code duplication
-    void resolve_wall_overlap_now(Particle *p) const {
-        const double xmin = 0.0, xmax = frame.w;
-        const double ymin = 0.0, ymax = frame.h;
+    void resolve_wall_overlap_now(Vec2f *pos, Vec2f *vel, double radius) const {
+        const double xmin = 0.0, xmax = box_w;
+        const double ymin = 0.0, ymax = box_h;
 
         bool hitL = false, hitR = false, hitT = false, hitB = false;
 
-        if (p->position.x < xmin + p->radius) { p->position.x = inext (xmin + p->radius); hitL = true; }
-        if (p->position.x > xmax - p->radius) { p->position.x = inprev(xmax - p->radius); hitR = true; }
-        if (p->position.y < ymin + p->radius) { p->position.y = inext (ymin + p->radius); hitT = true; }
-        if (p->position.y > ymax - p->radius) { p->position.y = inprev(ymax - p->radius); hitB = true; }
+        if (pos->x < xmin + radius) { pos->x = inext (xmin + radius); hitL = true; }
+        if (pos->x > xmax - radius) { pos->x = inprev(xmax - radius); hitR = true; }
+        if (pos->y < ymin + radius) { pos->y = inext (ymin + radius); hitT = true; }
+        if (pos->y > ymax - radius) { pos->y = inprev(ymax - radius); hitB = true; }
 
-        if (hitL && p->velocity.x < 0.0) p->velocity.x = -wall_gain[Side::LEFT]   * p->velocity.x;
-        if (hitR && p->velocity.x > 0.0) p->velocity.x = -wall_gain[Side::RIGHT]  * p->velocity.x;
-        if (hitT && p->velocity.y < 0.0) p->velocity.y = -wall_gain[Side::TOP]    * p->velocity.y;
-        if (hitB && p->velocity.y > 0.0) p->velocity.y = -wall_gain[Side::BOTTOM] * p->velocity.y;
+        if (hitL && vel->x < 0.0) vel->x = -wall_gain[Side::LEFT]   * vel->x;
+        if (hitR && vel->x > 0.0) vel->x = -wall_gain[Side::RIGHT]  * vel->x;
+        if (hitT && vel->y < 0.0) vel->y = -wall_gain[Side::TOP]    * vel->y;
+        if (hitB && vel->y > 0.0) vel->y = -wall_gain[Side::BOTTOM] * vel->y;
     }
 
     void step_frame(Time dt) {
-        const Time start = sim_now;
-        const Time end = start + dt;
-        (void)end;
-        int N = compute_substeps(dt);
+        limit_right_wall(dt);
+
+        const double n = (double)particles->active_slots.size();
+        const double per_cell = n / (double)particles->grid->buckets.size();
+        const double rate = (double)frame_collisions;
+        if (per_cell > EVENT_CROWDED_PER_CELL || rate > EVENT_BUSY_RATE * n) {
+            events_busy = true;
+        } else if (per_cell < EVENT_SPARSE_PER_CELL && rate < EVENT_CALM_RATE * n) {
+            events_busy = false;
+        }
+
+        frame_collisions = 0;
+        Uint64 t0 = step_stats ? SDL_GetTicksNS() : 0;
+        if (step_stats) step_stats->frames++;
+        if (event_driven && !events_busy) {
+            step_events(dt);
+            if (step_stats) {
+                step_stats->event_frames++;
+                step_stats->events_ns += lap(&t0);
+                step_stats->collisions += frame_collisions;
+            }
+            return;
+        }
+        events_primed = false;
+
+        const int N = compute_substeps(dt);
+        if (multirate && plan_levels(dt, N)) {
+            step_multirate(dt);
+            if (step_stats) {
+                step_stats->multirate_frames++;
+                step_stats->multirate_ns += lap(&t0);
+                step_stats->collisions += frame_collisions;
+            }
+            return;
+        }
+
         const double h = dt / (double)N;
 
         for (int i = 0; i < N; ++i) {
             const Time t_sub_start = sim_now;
             const Time t_sub_end   = sim_now + h;
-            frame.w = wall_pos(Side::RIGHT, t_sub_start);
-            refresh_layout();
+            box_w = wall_pos(Side::RIGHT, t_sub_start);
 
             integrate_positions(t_sub_start, h);
+            if (step_stats) step_stats->integrate_ns += lap(&t0);
             handle_walls(t_sub_end);
-            rebuild_buckets_if_needed();
-            for (int pass = 0; pass < 3; ++pass) {
-                bool any = detect_and_collide_pairs(t_sub_end);
-                if (!any) break;
+            if (step_stats) step_stats->walls_ns += lap(&t0);
+
+            // overlaps a merge or burst leaves behind are picked up next substep
+            collect_contacts();
+            if (step_stats) step_stats->contacts_ns += lap(&t0);
+            frame_collisions += resolve_contacts(t_sub_end);
+            if (step_stats) step_stats->resolve_ns += lap(&t0);
 
-                rebuild_buckets_if_needed();
-            }
             sim_now = t_sub_end;
         }
 
-        frame.w = wall_pos(Side::RIGHT, sim_now);
-        refresh_layout();
+        box_w = wall_pos(Side::RIGHT, sim_now);
+        if (step_stats) {
+            step_stats->substep_frames++;
+            step_stats->substeps += N;
+            step_stats->collisions += frame_collisions;
+        }
+    }
+
+    // ns since *t0, which moves up to now
+    static Uint64 lap(Uint64 *t0) {
+        const Uint64 t = SDL_GetTicksNS();
+        const Uint64 d = t - *t0;
+        *t0 = t;
+        return d;
     }
 
+    // from the manager's running totals, no pass over the particles
     Stat tally() const {
-        Stat s; s.n = 0; s.total_mass = 0.0; s.kinetic = 0.0; s.temperature = 0.0;
-        s.n_circle = 0; s.n_square = 0; s.bulk_u = Vec2f(0.0, 0.0);
-
-        // first pass: mass, momentum
-        const std::vector<Slot> &active = particles->active_slots;
-        for (size_t k = 0; k < active.size(); ++k) {
-            const Particle *p = particles->items[active[k]];
-            if (!p->alive) continue;
-            if (typeid(*p) == typeid(ParticleCircle)) {
-                s.n_circle++;
-            }
-            if (typeid(*p) == typeid(ParticleSquare)) {
-                s.n_square++;
-            }
-            s.n += 1;
-            s.total_mass += p->mass;
-            s.bulk_u += p->velocity * p->mass;
-        }
-        if (s.total_mass > 0.0) s.bulk_u /= s.total_mass;
-
-        // second pass: thermal kinetic energy
-        double sum_m_v2 = 0.0;
-        for (size_t k = 0; k < active.size(); ++k) {
-            Particle const* p = particles->items[active[k]];
-            if (!p->alive) continue;
-            Vec2f dv = p->velocity - s.bulk_u;
-            sum_m_v2 += p->mass * (dv ^ dv);
+        const ParticleTotals &t = particles->totals;
+        Stat s;
+        s.n_circle = (size_t)t.n[ParticleType::CIRCLE];
+        s.n_square = (size_t)t.n[ParticleType::SQUARE];
+        s.n = s.n_circle + s.n_square;
+        s.total_mass = t.mass;
+        s.temperature = 0.0;
+        s.bulk_u = Vec2f(0.0, 0.0);
+        s.kinetic = 0.0;
+        if (s.n > 0 && t.mass > 0.0) {
+            s.bulk_u = Vec2f(t.px / t.mass, t.py / t.mass);
+
+            // thermal: what is left of sum m|v|^2 without the bulk flow's share
+            const double m_u2 = (t.px * t.px + t.py * t.py) / t.mass;
+            s.kinetic = 0.5 * std::max(0.0, t.m_v2 - m_u2);
         }
-        s.kinetic = 0.5 * sum_m_v2;
 
         if (right_probe.m_vn2_in_last.size > 0) {
             const double mean_m_vn2 = right_probe.m_vn2_in_last.mean(
@@ -401,15 +652,41 @@ public:
     }
 
     void set_right_wall_velocity(double v_right) {
+        right_wall_goal = v_right;
         begin_right_wall_segment(v_right, sim_now);
     }
 
+    double widest_radius() const {
+        const ParticleManager *pm = particles;
+        float r_max = 0.0f;
+        for (size_t i = 0; i < pm->active_slots.size(); ++i) {
+            r_max = std::max(r_max, pm->radius[pm->active_slots[i]]);
+        }
+        return r_max;
+    }
+
+    // the right wall's segment for the next dt: as asked, unless that ends
+    // the frame past the limit, then it lands on the limit at the frame's
+    // end and rests there; a particle grown past the box pushes it out
+    void limit_right_wall(Time dt) {
+        const double x_min = 2.0 * widest_radius() + MIN_BOX_SLACK;
+        const double x_now = wall_pos(Side::RIGHT, sim_now);
+
+        double v = right_wall_goal;
+        if (x_now + v * dt < x_min) {
+            v = std::abs(x_now - x_min) < WALL_REST_PX ? 0.0 : (x_min - x_now) / dt;
+        }
+        if (v != right_wall.v) begin_right_wall_segment(v, sim_now);
+    }
+
     void begin_right_wall_segment(double new_v, Time now) {
         double x_now = wall_pos(Side::RIGHT, now);
         right_wall.x0 = x_now;
         right_wall.t0 = now;
         right_wall.v = new_v;
         ++right_wall.gen;
+        // every particle's next wall hit may change
+        events_primed = false;
     }
 
     const char *title() const {
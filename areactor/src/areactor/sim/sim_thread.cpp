@@ -0,0 +1,69 @@
+#include <stdexcept>
+
+#include "sim_thread.hpp"
+#include "../reactor.hpp"
+
+static const Time SIM_STEP_S = 1.0 / 60.0;  // simulated time per step
+static const int  SIM_MAX_OWED_STEPS = 4;   // backlog kept when steps fall behind
+
+SimThread::SimThread(Reactor *r) : reactor(r), thread(NULL) {
+    SDL_SetAtomicInt(&stop, 0);
+
+    mtx = SDL_CreateMutex();
+    if (!mtx) throw std::runtime_error(SDL_GetError());
+
+    thread = SDL_CreateThread(SimThread::entry, "areactor_sim", this);
+    if (!thread) {
+        SDL_DestroyMutex(mtx);
+        throw std::runtime_error(SDL_GetError());
+    }
+}
+
+SimThread::~SimThread() {
+    SDL_SetAtomicInt(&stop, 1);
+    SDL_WaitThread(thread, NULL);
+    SDL_DestroyMutex(mtx);
+}
+
+void SimThread::post(const SimCommand &c) {
+    SDL_LockMutex(mtx);
+    inbox.push_back(c);
+    SDL_UnlockMutex(mtx);
+}
+
+void SimThread::take_commands() {
+    SDL_LockMutex(mtx);
+    taken.swap(inbox);
+    SDL_UnlockMutex(mtx);
+
+    for (size_t i = 0; i < taken.size(); ++i) reactor->apply(taken[i]);
+    taken.clear();
+}
+
+int SimThread::entry(void *self_void) {
+    static_cast<SimThread*>(self_void)->loop();
+    return 0;
+}
+
+void SimThread::loop() {
+    Uint64 last = SDL_GetTicksNS();
+    Time owed = 0.0;  // simulated time the real time asks for
+
+    while (!SDL_GetAtomicInt(&stop)) {
+        take_commands();
+
+        const Uint64 now = SDL_GetTicksNS();
+        owed += (now - last) * 1e-9 * reactor->sim_speed;
+        last = now;
+        if (owed > SIM_MAX_OWED_STEPS * SIM_STEP_S) owed = SIM_MAX_OWED_STEPS * SIM_STEP_S;
+
+        if (owed < SIM_STEP_S) {
+            SDL_DelayNS((Uint64)((SIM_STEP_S - owed) / reactor->sim_speed * 1e9));
+            continue;
+        }
+
+        reactor->step_frame(SIM_STEP_S);
+        reactor->publish();
+        owed -= SIM_STEP_S;
+    }
+}
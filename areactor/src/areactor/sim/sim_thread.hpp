@@ -0,0 +1,50 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <vector>
+
+class Reactor;
+
+// a change the UI asks of the simulation, applied between steps
+struct SimCommand {
+    enum Kind {
+        ADD_PARTICLES = 0,
+        REMOVE_PARTICLES,
+        WALL_VELOCITY,
+        WALL_GAIN,      // adds value to the gain of side
+        TOGGLE_EVENTS,
+        SCALE_SPEED     // multiplies the simulation speed by value
+    };
+
+    int kind;
+    int side;
+    double value;
+};
+
+/*
+ * Steps a Reactor on a thread of its own in fixed steps of simulated time,
+ * as many as the real time passed times the reactor's speed asks for, and
+ * publishes a snapshot after each. A step costlier than the time it
+ * simulates slows the simulation down instead of the UI; the backlog it
+ * leaves is dropped rather than caught up on
+ */
+class SimThread {
+    Reactor *reactor;
+    SDL_Thread *thread;
+
+    SDL_Mutex *mtx;
+    std::vector<SimCommand> inbox;  // posted by the UI, under mtx
+    std::vector<SimCommand> taken;  // the simulation thread's
+    SDL_AtomicInt stop;
+
+    static int entry(void *self_void);
+    void loop();
+    void take_commands();
+
+    SimThread(const SimThread &);
+    SimThread &operator=(const SimThread &);
+public:
+    explicit SimThread(Reactor *r);
+    ~SimThread();
+
+    void post(const SimCommand &c);
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+
+#include <swuix/window/window.hpp>
+
+#include "../linalg/vectors.hpp"
+#include "../common.hpp"
+
+struct Stat {
+    size_t n;
+    double total_mass;
+    double kinetic;      // thermal kinetic energy
+    double temperature;  // instantaneous T
+    Vec2f  bulk_u;       // mass-weighted mean velocity
+    size_t n_circle;
+    size_t n_square;
+
+    unsigned right_hits;
+    double   right_impulse_sum;
+    double   right_pressure;
+    double   right_temperature;
+};
+
+// what the UI shows of a Reactor, copied out after a step
+struct ReactorSnapshot {
+    std::vector<float> x, y, r;  // live particles, in no particular order
+    std::vector<unsigned char> type;
+    Stat stat;
+
+    double box_w, box_h;  // box_w follows the right wall
+    double wall_gain[5];
+    Time sim_now;
+    double speed;         // simulated seconds per real second
+    bool event_driven;
+
+    size_t size() const {
+        return x.size();
+    }
+};
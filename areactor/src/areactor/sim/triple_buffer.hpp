@@ -0,0 +1,46 @@
+#pragma once
+#include <SDL3/SDL.h>
+
+/*
+ * Three copies of T passed from one writer thread to one reader thread
+ * without locks. The writer fills back() and publishes it; the reader
+ * takes the newest published copy with acquire() and reads front() until
+ * its next acquire. Neither ever touches the copy the other one holds,
+ * the third is the one in passing
+ */
+template <typename T>
+class TripleBuffer {
+    static const int FRESH = 4;  // on `ready` from publish() until acquire()
+
+    T bufs[3];
+    int back_i;           // the writer's
+    int front_i;          // the reader's
+    SDL_AtomicInt ready;  // index of the third copy, | FRESH
+
+    TripleBuffer(const TripleBuffer &);
+    TripleBuffer &operator=(const TripleBuffer &);
+public:
+    TripleBuffer() : back_i(0), front_i(1) {
+        SDL_SetAtomicInt(&ready, 2);
+    }
+
+    // writer side
+    T &back() {
+        return bufs[back_i];
+    }
+
+    void publish() {
+        back_i = SDL_SetAtomicInt(&ready, back_i | FRESH) & 3;
+    }
+
+    // reader side; true if front() changed
+    bool acquire() {
+        if (!(SDL_GetAtomicInt(&ready) & FRESH)) return false;
+        front_i = SDL_SetAtomicInt(&ready, front_i) & 3;
+        return true;
+    }
+
+    const T &front() const {
+        return bufs[front_i];
+    }
+};
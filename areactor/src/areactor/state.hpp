@@ -28,10 +28,10 @@ struct ReactorState : public State {
     }
 
     void add_to_wall_temp(uint8_t side, double delta) {
-        reactor->add_to_wall_gain(side, delta);
+        reactor->request(SimCommand::WALL_GAIN, delta, side);
     }
 
     double wall_temp(uint8_t side) const {
-        return reactor->wall_gain[side];
+        return reactor->view().wall_gain[side];
     }
 };
@@ -26,6 +26,7 @@ public:
 		this->append_children(Widget::makeChildren(arr));
 
 		((ReactorState*)state)->reactor = reactor;
+		reactor->start_sim_thread();
 		this->parent = this;
 	}
 
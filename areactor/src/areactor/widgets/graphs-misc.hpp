@@ -11,7 +11,7 @@ public:
 	DispatchResult on_idle(DispatcherCtx ctx, const IdleEvent *e) {
 		(void)ctx;
 		(void)e;
-		Stat stats = ((ReactorState *)state)->reactor->tally();
+		const Stat &stats = ((ReactorState *)state)->reactor->view().stat;
 		this->append_sample(stats.kinetic);
 		this->rescale_y();
 		this->snap_y_scale_to_grid();
@@ -27,7 +27,7 @@ public:
 	DispatchResult on_idle(DispatcherCtx ctx, const IdleEvent *e) {
 		(void)ctx;
 		(void)e;
-		Stat stats = ((ReactorState *)state)->reactor->tally();
+		const Stat &stats = ((ReactorState *)state)->reactor->view().stat;
 		this->append_sample(stats.right_temperature);
 		this->rescale_y();
 		this->snap_y_scale_to_grid();
@@ -16,12 +16,12 @@ static void cb_sub(void *st, Widget *d) {
 
 static void cb_add_particles(void *st, Widget *d) {
 	(void)d;
-	((ReactorState*)st)->reactor->add_particles(((ReactorState*)st)->now, 5);
+	((ReactorState*)st)->reactor->request(SimCommand::ADD_PARTICLES, 5);
 }
 
 static void cb_delete_particles(void *st, Widget *d) {
 	(void)d;
-	((ReactorState*)st)->reactor->remove_particles(5);
+	((ReactorState*)st)->reactor->request(SimCommand::REMOVE_PARTICLES, 5);
 }
 
 static void cb_hotter(void *st, Widget *d) {
@@ -0,0 +1,200 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "areactor/reactor.hpp"
+#include "areactor/state.hpp"
+
+/*
+ * Runs the reactor's physics without a window: a seeded gas in the
+ * example's box, stepped at the simulation thread's fixed step for a given
+ * simulated time, and reports the step rate, the collision rate and where
+ * step_frame spent its time. The run is repeated from scratch, once more
+ * with a different AREACTOR_THREADS, and the final states compared bit for
+ * bit, so a physics change can be checked for both speed and
+ * reproducibility; a different checksum for the same arguments across
+ * builds means the trajectories changed
+ */
+
+static const Time   BENCH_STEP_S = 1.0 / 60.0;
+static const float  BENCH_BOX_W  = 640.0f;
+static const float  BENCH_BOX_H  = 380.0f;
+
+struct BenchArgs {
+    int particles;
+    int seconds;    // simulated
+    int wall_speed;
+    unsigned seed;
+    int runs;
+    bool events;
+    bool multirate;
+};
+
+static void usage(const char *prog) {
+    std::fprintf(stderr,
+        "usage: %s [-n particles] [-t seconds] [-w wall speed] [-s seed] [-r runs] [-S]\n"
+        "  -w  right wall speed in px/s; a closing wall stops where the box is\n"
+        "      about as wide as the widest particle\n"
+        "  -S  uniform substeps only, no event-driven or multirate frames\n",
+        prog
+    );
+}
+
+static bool parse_int(const char *s, int min, int *out) {
+    char *end = NULL;
+    long v = std::strtol(s, &end, 10);
+    if (!*s || *end || v < min || v > 1 << 24) return false;
+    *out = (int)v;
+    return true;
+}
+
+static bool parse_args(int argc, char **argv, BenchArgs *args) {
+    for (int i = 1; i < argc; ++i) {
+        const char *opt = argv[i];
+        if (std::strcmp(opt, "-S") == 0) {
+            args->events = false;
+            args->multirate = false;
+            continue;
+        }
+        if (i + 1 >= argc || std::strlen(opt) != 2 || opt[0] != '-') return false;
+
+        const char *val = argv[++i];
+        int seed = 0;
+        bool ok;
+        switch (opt[1]) {
+        case 'n': ok = parse_int(val, 0, &args->particles); break;
+        case 't': ok = parse_int(val, 1, &args->seconds); break;
+        case 'w': ok = parse_int(val, -(1 << 16), &args->wall_speed); break;
+        case 's': ok = parse_int(val, 0, &seed); args->seed = (unsigned)seed; break;
+        case 'r': ok = parse_int(val, 1, &args->runs); break;
+        default:  ok = false;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// FNV-1a, the constants spelled out without C++11 long long literals
+static const Uint64 FNV_BASIS = ((Uint64)0xcbf29ce4u << 32) | 0x84222325u;
+static const Uint64 FNV_PRIME = ((Uint64)1 << 40) | 0x1b3u;
+
+static void hash_bytes(Uint64 *h, const void *p, size_t n) {
+    const unsigned char *b = static_cast<const unsigned char*>(p);
+    for (size_t i = 0; i < n; ++i) {
+        *h ^= b[i];
+        *h *= FNV_PRIME;
+    }
+}
+
+// every live particle's state in active order, and the clock
+static Uint64 checksum(const Reactor &r) {
+    const ParticleManager *pm = r.particles;
+    Uint64 h = FNV_BASIS;
+    hash_bytes(&h, &r.sim_now, sizeof(r.sim_now));
+    for (size_t k = 0; k < pm->active_slots.size(); ++k) {
+        const Slot s = pm->active_slots[k];
+        hash_bytes(&h, &pm->pos_x[s], sizeof(float));
+        hash_bytes(&h, &pm->pos_y[s], sizeof(float));
+        hash_bytes(&h, &pm->vel_x[s], sizeof(float));
+        hash_bytes(&h, &pm->vel_y[s], sizeof(float));
+        hash_bytes(&h, &pm->radius[s], sizeof(float));
+        hash_bytes(&h, &pm->mass[s], sizeof(double));
+        hash_bytes(&h, &pm->type[s], 1);
+    }
+    return h;
+}
+
+struct RunResult {
+    StepStats stats;
+    Uint64 ns;
+    Uint64 sum;
+    Stat stat;
+    double box_w;
+    int threads;
+};
+
+// the work pool reads AREACTOR_THREADS when the reactor builds it
+static void set_threads_env(const char *value) {
+    SDL_Environment *env = SDL_GetEnvironment();
+    if (value) SDL_SetEnvironmentVariable(env, "AREACTOR_THREADS", value, true);
+    else       SDL_UnsetEnvironmentVariable(env, "AREACTOR_THREADS");
+}
+
+static void run(const BenchArgs &args, RunResult *out) {
+    ReactorState state(NULL);
+    Reactor reactor(frect(0, 0, BENCH_BOX_W, BENCH_BOX_H), NULL, (size_t)args.particles, &state, args.seed);
+    out->threads = reactor.threads();
+    reactor.event_driven = args.events;
+    reactor.multirate = args.multirate;
+    reactor.set_right_wall_velocity(args.wall_speed);
+    reactor.step_stats = &out->stats;
+
+    const int steps = (int)(args.seconds / BENCH_STEP_S + 0.5);
+    const Uint64 t0 = SDL_GetTicksNS();
+    for (int i = 0; i < steps; ++i) reactor.step_frame(BENCH_STEP_S);
+    out->ns = SDL_GetTicksNS() - t0;
+
+    reactor.particles->recount();
+    out->stat = reactor.tally();
+    out->sum = checksum(reactor);
+    out->box_w = reactor.box_w;
+}
+
+static double share(Uint64 ns, Uint64 total) {
+    return total ? 100.0 * ns / total : 0.0;
+}
+
+int main(int argc, char **argv) {
+    BenchArgs args = { 1500, 10, 0, 1, 2, true, true };
+    if (!parse_args(argc, argv, &args)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<RunResult> results((size_t)args.runs + 1);
+    for (int i = 0; i < args.runs; ++i) run(args, &results[i]);
+
+    // the substeps are cut independently of the thread count, so a run on
+    // one thread, or two when already capped to one, must end the same
+    const char *env_threads = SDL_getenv("AREACTOR_THREADS");
+    const std::string saved = env_threads ? env_threads : "";
+    set_threads_env(results[0].threads == 1 ? "2" : "1");
+    run(args, &results[args.runs]);
+    set_threads_env(env_threads ? saved.c_str() : NULL);
+
+    const RunResult &r = results[0];
+    const StepStats &st = r.stats;
+    const double wall_s = r.ns / 1e9;
+    const double sim_s = st.frames * BENCH_STEP_S;
+
+    std::printf("areactor bench: %d particles, %d s simulated, wall speed %d, seed %u, %s, %s kernels\n",
+        args.particles, args.seconds, args.wall_speed, args.seed,
+        args.events ? "events when calm" : "uniform substeps only", kinematic_kernels()->name);
+    std::printf("first run     %9.2f ms, %.2f ms/step\n", r.ns / 1e6, st.frames ? r.ns / 1e6 / st.frames : 0.0);
+    std::printf("steps/s       %9.1f (%.1fx real time)\n", wall_s > 0.0 ? st.frames / wall_s : 0.0,
+        wall_s > 0.0 ? sim_s / wall_s : 0.0);
+    std::printf("collisions/s  %9.1f per wall second, %.1f per simulated second\n",
+        wall_s > 0.0 ? st.collisions / wall_s : 0.0, sim_s > 0.0 ? st.collisions / sim_s : 0.0);
+    std::printf("frames: %d event-driven, %d multirate, %d substepped (%d substeps)\n",
+        (int)st.event_frames, (int)st.multirate_frames, (int)st.substep_frames, (int)st.substeps);
+    std::printf("time in step_frame:\n");
+    std::printf("  events      %9.2f ms %5.1f%%\n", st.events_ns / 1e6, share(st.events_ns, r.ns));
+    std::printf("  multirate   %9.2f ms %5.1f%%\n", st.multirate_ns / 1e6, share(st.multirate_ns, r.ns));
+    std::printf("  integrate   %9.2f ms %5.1f%%\n", st.integrate_ns / 1e6, share(st.integrate_ns, r.ns));
+    std::printf("  walls       %9.2f ms %5.1f%%\n", st.walls_ns / 1e6, share(st.walls_ns, r.ns));
+    std::printf("  contacts    %9.2f ms %5.1f%%\n", st.contacts_ns / 1e6, share(st.contacts_ns, r.ns));
+    std::printf("  resolve     %9.2f ms %5.1f%%\n", st.resolve_ns / 1e6, share(st.resolve_ns, r.ns));
+    std::printf("final: %d circles, %d squares, thermal energy %.1f, box %.1f x %.1f\n",
+        (int)r.stat.n_circle, (int)r.stat.n_square, r.stat.kinetic, r.box_w, (double)BENCH_BOX_H);
+
+    bool same = true;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Uint64 sum = results[i].sum;
+        std::printf("run %d  %9.2f ms  %2d threads  checksum %08x%08x\n", (int)i + 1, results[i].ns / 1e6,
+            results[i].threads, (unsigned)(sum >> 32), (unsigned)(sum & 0xffffffffu));
+        same = same && sum == r.sum;
+    }
+    std::printf("reproducible: %s\n", same ? "yes" : "NO");
+    return same ? 0 : 2;
+}
@@ -0,0 +1,174 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "draww/linalg.hpp"
+#include "draww/axes.hpp"
+#include "draww/pixel_buffer.hpp"
+#include "draww/scene.hpp"
+
+/*
+ * Renders a parameterized sphere scene offscreen, on one thread, and
+ * reports where the analytic renderer spends its time per pixel. The
+ * scene only depends on the arguments, so runs are comparable across
+ * builds; the checksum tells whether the pixels changed. The per-phase
+ * split still carries some of the timer's cost, ms/frame is the real one
+ */
+
+struct BenchArgs {
+	int spheres;
+	int lights;
+	int width, height;
+	int frames;
+	unsigned seed;
+	bool reproject;
+};
+
+static void usage(const char *prog) {
+	std::fprintf(stderr,
+		"usage: %s [-n spheres] [-l lights] [-w width] [-h height] [-f frames] [-s seed] [-R]\n"
+		"  -R  turn off shadow reprojection\n",
+		prog
+	);
+}
+
+static bool parse_int(const char *s, int min, int *out) {
+	char *end = NULL;
+	long v = std::strtol(s, &end, 10);
+	if (!*s || *end || v < min || v > 1 << 20) return false;
+	*out = (int)v;
+	return true;
+}
+
+static bool parse_args(int argc, char **argv, BenchArgs *args) {
+	for (int i = 1; i < argc; ++i) {
+		const char *opt = argv[i];
+		if (std::strcmp(opt, "-R") == 0) {
+			args->reproject = false;
+			continue;
+		}
+		if (i + 1 >= argc || std::strlen(opt) != 2 || opt[0] != '-') return false;
+
+		const char *val = argv[++i];
+		int seed = 0;
+		bool ok;
+		switch (opt[1]) {
+		case 'n': ok = parse_int(val, 0, &args->spheres); break;
+		case 'l': ok = parse_int(val, 0, &args->lights); break;
+		case 'w': ok = parse_int(val, 1, &args->width); break;
+		case 'h': ok = parse_int(val, 1, &args->height); break;
+		case 'f': ok = parse_int(val, 1, &args->frames); break;
+		case 's': ok = parse_int(val, 0, &seed); args->seed = (unsigned)seed; break;
+		default:  ok = false;
+		}
+		if (!ok) return false;
+	}
+	return true;
+}
+
+// same sequence on every platform, unlike rand()
+static double lcg_unit(unsigned *state) {
+	*state = *state * 1664525u + 1013904223u;
+	return (*state >> 8) / 16777216.0;
+}
+
+// the example's three spheres and light, then random ones in front of the floor
+static void fill_scene(Scene *scene, const BenchArgs &args) {
+	scene->spheres.push_back(Sphere(Vector3(-5, -5, -14), 7));
+	scene->spheres.push_back(Sphere(Vector3( 5,  5,   0), 2));
+	scene->spheres.push_back(Sphere(Vector3(-5, -5,   0), 4));
+
+	unsigned state = args.seed;
+	for (int i = 0; i < args.spheres; ++i) {
+		const double x = lcg_unit(&state) * 40.0 - 20.0;
+		const double y = lcg_unit(&state) * 30.0 - 19.0;
+		const double z = lcg_unit(&state) * 40.0 - 40.0;
+		const double r = 0.1 + lcg_unit(&state) * 0.5;
+		scene->spheres.push_back(Sphere(Vector3(x, y, z), r));
+	}
+
+	Vector3 light(-19, 9, 20);
+	for (int i = 0; i < args.lights; ++i) {
+		scene->light_sources.push_back(light);
+		light.rotate_xz(2.0 * M_PI / args.lights);
+	}
+}
+
+static Uint64 checksum(const PixelBuffer &pb) {
+	// FNV-1a, the constants spelled out without C++11 long long literals
+	static const Uint64 FNV_BASIS = ((Uint64)0xcbf29ce4u << 32) | 0x84222325u;
+	static const Uint64 FNV_PRIME = ((Uint64)1 << 40) | 0x1b3u;
+
+	const Uint32 *px = pb.offscreen_pixels();
+	Uint64 h = FNV_BASIS;
+	for (size_t i = 0; i < (size_t)pb.width * pb.height; ++i) {
+		h ^= px[i];
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+static double per_pixel(Uint64 ns, Uint64 pixels) {
+	return pixels ? (double)ns / pixels : 0.0;
+}
+
+int main(int argc, char **argv) {
+	BenchArgs args = { 500, 2, 640, 720, 24, 7, true };
+	if (!parse_args(argc, argv, &args)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// same field of view as the example at any resolution
+	const double scale = 30.0 * args.height / 720.0;
+	Axis x_axis = { args.height / 2.0, scale };
+	Axis y_axis = { args.width  / 2.0, scale };
+	Axis z_axis = { 0, scale };
+	SDL_FRect rect = { 0, 0, (float)args.width, (float)args.height };
+	CoordinateSystem cs(x_axis, y_axis, z_axis, rect);
+
+	PixelBuffer pb(args.width, args.height);
+	Scene scene(&cs, NULL, &pb);
+	scene.reproject = args.reproject;
+	fill_scene(&scene, args);
+
+	Camera camera = { Vector3(0, 5, 15), Vector3(0, -5, -10) };
+
+	// the first frame has nothing to reuse, it is reported on its own
+	Uint64 t0 = SDL_GetTicksNS();
+	scene.render_with_ambient_diffusion_and_specular_light(&camera);
+	const Uint64 first_ns = SDL_GetTicksNS() - t0;
+
+	ShadeStats st;
+	scene.stats = &st;
+
+	t0 = SDL_GetTicksNS();
+	for (int f = 1; f < args.frames; ++f) {
+		camera.dir.rotate_xz(M_PI / 96);
+		camera.pos.rotate_xz(M_PI / 96);
+		scene.render_with_ambient_diffusion_and_specular_light(&camera);
+	}
+	const Uint64 steady_ns = SDL_GetTicksNS() - t0;
+
+	std::printf("draww bench: %d spheres, %d lights, %dx%d, %d frames, %s kernels, reprojection %s\n",
+		args.spheres + 3, args.lights, args.width, args.height, args.frames,
+		sphere_kernels()->name, args.reproject ? "on" : "off");
+	std::printf("first frame   %9.2f ms\n", first_ns / 1e6);
+
+	if (st.frames) {
+		const Uint64 shaded = st.shadows_traced + st.shadows_reused;
+		std::printf("steady state  %9.2f ms/frame over %d frames\n", steady_ns / 1e6 / st.frames, (int)st.frames);
+		std::printf("ns/pixel:\n");
+		std::printf("  setup       %9.2f\n", per_pixel(st.setup_ns, st.pixels));
+		std::printf("  intersect   %9.2f\n", per_pixel(st.intersect_ns, st.sampled));
+		std::printf("  shadow      %9.2f\n", per_pixel(st.shadow_ns, st.sampled));
+		std::printf("  lighting    %9.2f\n", per_pixel(st.lighting_ns, st.sampled));
+		std::printf("shadows traced for %.1f%% of shaded pixels, reused for %.1f%%\n",
+			shaded ? 100.0 * st.shadows_traced / shaded : 0.0,
+			shaded ? 100.0 * st.shadows_reused / shaded : 0.0);
+	}
+
+	const Uint64 sum = checksum(pb);
+	std::printf("checksum %08x%08x\n", (unsigned)(sum >> 32), (unsigned)(sum & 0xffffffffu));
+	return 0;
+}
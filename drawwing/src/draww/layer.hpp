@@ -0,0 +1,61 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <stdexcept>
+
+/*
+ * Render-target texture the size of the window, for content that rarely
+ * changes: draw it once between begin() and end(), then composite it with
+ * draw() every frame until invalidate()
+ */
+class Layer {
+	SDL_Renderer *renderer;
+	bool valid;
+
+	Layer(const Layer &);
+	Layer &operator=(const Layer &);
+public:
+	SDL_Texture *texture;
+
+	Layer(SDL_Renderer *ren, int w, int h)
+			: renderer(ren), valid(false) {
+		texture = SDL_CreateTexture(
+			renderer,
+			SDL_PIXELFORMAT_RGBA32,
+			SDL_TEXTUREACCESS_TARGET,
+			w,
+			h
+		);
+		if (!texture) throw std::runtime_error(SDL_GetError());
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+	}
+
+	~Layer() {
+		if (texture) SDL_DestroyTexture(texture);
+	}
+
+	bool is_valid() const { return valid; }
+
+	// contents are lost, e.g. after SDL_EVENT_RENDER_TARGETS_RESET
+	void invalidate() { valid = false; }
+
+	// redirects drawing into the layer and clears it to transparent
+	bool begin() {
+		if (!SDL_SetRenderTarget(renderer, texture)) {
+			SDL_Log("SetRenderTarget failed: %s", SDL_GetError());
+			return false;
+		}
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+		SDL_RenderClear(renderer);
+		return true;
+	}
+
+	void end() {
+		SDL_SetRenderTarget(renderer, NULL);
+		valid = true;
+	}
+
+	// same rect in the layer and on screen, NULL for all of it
+	void draw(const SDL_FRect *rect) {
+		SDL_RenderTexture(renderer, texture, rect, rect);
+	}
+};
@@ -1,14 +1,32 @@
 #pragma once
 #include <SDL3/SDL.h>
 #include <stdexcept>
+#include <vector>
 
+/*
+ * RGBA32 pixels the scenes shade into, either a streaming texture of a
+ * renderer or plain memory (offscreen), where draw() does nothing and the
+ * frame is read back through offscreen_pixels()
+ */
 class PixelBuffer {
 	SDL_Renderer *renderer;
 	const SDL_PixelFormatDetails *details;
 	Uint32 grayLUT[256];
+	std::vector<Uint32> memory;  // offscreen backend only
+
+	PixelBuffer(const PixelBuffer &);
+	PixelBuffer &operator=(const PixelBuffer &);
+
+	void init_lut() {
+		details = SDL_GetPixelFormatDetails(SDL_PIXELFORMAT_RGBA32);
+		if (!details) throw std::runtime_error(SDL_GetError());
+		for (int i = 0; i < 256; ++i) {
+			grayLUT[i] = SDL_MapRGBA(details, NULL, i, i, i, 255);
+		}
+	}
 public:
 	int width, height;
-	SDL_Texture *texture;
+	SDL_Texture *texture;  // NULL when offscreen
 
 	PixelBuffer(SDL_Renderer *ren, int w, int h)
 			: renderer(ren), width(w), height(h) {
@@ -20,24 +38,39 @@ public:
 			height
 		);
 		if (!texture) throw std::runtime_error(SDL_GetError());
+		init_lut();
+	}
 
-		details = SDL_GetPixelFormatDetails(SDL_PIXELFORMAT_RGBA32);
-		for (int i = 0; i < 256; ++i) {
-			grayLUT[i] = SDL_MapRGBA(details, NULL, i, i, i, 255);
-		}
+	// offscreen, needs neither a window nor SDL_Init
+	PixelBuffer(int w, int h)
+			: renderer(NULL), memory((size_t)w * h), width(w), height(h), texture(NULL) {
+		init_lut();
 	}
 
 	~PixelBuffer() {
 		if (texture) SDL_DestroyTexture(texture);
 	}
 
+	bool is_offscreen() const { return texture == NULL; }
+
+	// row-major, width pixels per row; NULL unless offscreen
+	const Uint32 *offscreen_pixels() const {
+		return memory.empty() ? NULL : &memory[0];
+	}
+
 	// if rect is NULL, locks entire texture
 	bool lock(const SDL_Rect *rect, void **pixels, int *pitch) {
-		return SDL_LockTexture(texture, rect, pixels, pitch);
+		if (texture) return SDL_LockTexture(texture, rect, pixels, pitch);
+		if (memory.empty()) return false;
+
+		const size_t x = rect ? rect->x : 0, y = rect ? rect->y : 0;
+		*pixels = &memory[y * width + x];
+		*pitch  = width * (int)sizeof(Uint32);
+		return true;
 	}
 
 	void unlock() {
-		SDL_UnlockTexture(texture);
+		if (texture) SDL_UnlockTexture(texture);
 	}
 
 	void set_pixel_gray(void *base, int pitch, int x, int y, Uint8 gray) {
@@ -55,6 +88,6 @@ public:
 	}
 
 	void draw() {
-		SDL_RenderTexture(renderer, texture, NULL, NULL);
+		if (texture) SDL_RenderTexture(renderer, texture, NULL, NULL);
 	}
 };
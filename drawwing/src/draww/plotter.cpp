@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "plotter.hpp"
+
+static const double PLOT_MAX_SEG_PX = 8.0;    // widest segment
+static const double PLOT_MIN_SEG_PX = 0.125;  // narrowest segment
+static const double PLOT_TOL_PX     = 0.25;   // allowed midpoint deviation from the chord
+
+// new segments are held to this fraction of the limits above, so a zoom
+// in of up to 1 / PLOT_BUILD_SLACK keeps them
+static const double PLOT_BUILD_SLACK = 0.5;
+static const double PLOT_JUMP_PX    = 1.0;    // a narrowest segment rising more is checked for a jump
+static const int    PLOT_JUMP_DEPTH = 24;     // halvings before a jump counts as a discontinuity
+static const int    PLOT_MAX_DEPTH  = 16;
+
+// samples kept this many view widths to either side, for panning back
+static const double PLOT_KEEP_VIEWS = 4.0;
+
+// samples refined this much finer than the view are dropped on zoom out
+static const double PLOT_ZOOM_OUT_RESET = 4.0;
+
+static inline bool is_finite(double v) {
+	return v == v && std::abs(v) <= std::numeric_limits<double>::max();
+}
+
+void Plotter::forget(PlotFn fn) {
+	for (size_t i = 0; i < caches.size(); ++i) {
+		if (caches[i].fn == fn) {
+			caches[i].samples.clear();
+			return;
+		}
+	}
+}
+
+Plotter::Cache &Plotter::cache_for(PlotFn fn) {
+	for (size_t i = 0; i < caches.size(); ++i) {
+		if (caches[i].fn == fn) return caches[i];
+	}
+
+	Cache c;
+	c.fn = fn;
+	c.sx_built = 0.0;
+	caches.push_back(c);
+	return caches.back();
+}
+
+// samples a widest new segment apart wherever [x_lo, x_hi] isn't sampled yet,
+// and none further out than PLOT_KEEP_VIEWS
+void Plotter::cover(Cache &c, double x_lo, double x_hi, double sx) {
+	std::vector<Sample> &s = c.samples;
+	const double step = PLOT_BUILD_SLACK * PLOT_MAX_SEG_PX / sx;
+
+	if (!s.empty() && c.sx_built > PLOT_ZOOM_OUT_RESET * sx) s.clear();
+
+	const double keep = PLOT_KEEP_VIEWS * (x_hi - x_lo);
+	if (!s.empty() && (s.back().x < x_lo - keep || s.front().x > x_hi + keep)) s.clear();
+
+	Sample fresh = { 0.0, 0.0, -1.0f, false };
+	if (s.empty()) {
+		c.sx_built = sx;
+		const double x0 = std::floor(x_lo / step) * step;
+		for (int k = 0; x0 + k * step < x_hi + step; ++k) {
+			fresh.x = x0 + k * step;
+			fresh.y = c.fn(fresh.x);
+			s.push_back(fresh);
+		}
+		return;
+	}
+
+	// drop what is far out, then extend to the left and right
+	std::vector<Sample>::iterator first = s.begin(), last = s.end();
+	while (first + 1 < last && (first + 1)->x < x_lo - keep) ++first;
+	while (last - 1 > first + 1 && (last - 2)->x > x_hi + keep) --last;
+	s.erase(last, s.end());
+	s.erase(s.begin(), first);
+
+	if (s.front().x > x_lo) {
+		scratch.clear();
+		for (double x = s.front().x - step; ; x -= step) {
+			fresh.x = x;
+			fresh.y = c.fn(x);
+			scratch.push_back(fresh);
+			if (x <= x_lo) break;
+		}
+		std::reverse(scratch.begin(), scratch.end());
+		s.insert(s.begin(), scratch.begin(), scratch.end());
+	}
+
+	while (s.back().x < x_hi) {
+		s.back().dev = -1.0f;
+		s.back().gap = false;
+		fresh.x = s.back().x + step;
+		fresh.y = c.fn(fresh.x);
+		s.push_back(fresh);
+	}
+}
+
+// true if the line from a to b would join across a discontinuity; halves
+// toward the steeper side, a continuous rise shrinks with the width
+bool Plotter::is_break(PlotFn fn, Sample a, Sample b, double sy) const {
+	if (!is_finite(a.y) || !is_finite(b.y)) return true;
+
+	for (int k = 0; k < PLOT_JUMP_DEPTH; ++k) {
+		if (std::abs(b.y - a.y) * sy <= PLOT_JUMP_PX) return false;
+
+		Sample m = a;
+		m.x = 0.5 * (a.x + b.x);
+		m.y = fn(m.x);
+		if (!is_finite(m.y)) return true;
+
+		if (std::abs(m.y - a.y) > std::abs(b.y - m.y)) {
+			b = m;
+		} else {
+			a = m;
+		}
+	}
+	return std::abs(b.y - a.y) * sy > PLOT_JUMP_PX;
+}
+
+// appends a, then whatever the segment up to b needs at this scale; not b
+void Plotter::refine_segment(PlotFn fn, Sample a, const Sample &b, double sx, double sy, int depth) {
+	const double w_px = (b.x - a.x) * sx;
+
+	// settled segments stay while they are within the limits
+	if (a.dev >= 0.0f) {
+		const bool fits = w_px <= PLOT_MIN_SEG_PX
+			|| (!a.gap && a.dev * sy <= PLOT_TOL_PX && w_px <= PLOT_MAX_SEG_PX);
+		if (fits) {
+			scratch.push_back(a);
+			return;
+		}
+	}
+
+	if (w_px <= PLOT_BUILD_SLACK * PLOT_MIN_SEG_PX || depth >= PLOT_MAX_DEPTH) {
+		// too narrow to bend visibly, its rise bounds the deviation
+		a.gap = is_break(fn, a, b, sy);
+		a.dev = a.gap ? 0.0f : (float)(0.5 * std::abs(b.y - a.y));
+		scratch.push_back(a);
+		return;
+	}
+
+	// nothing to draw between two undefined values, e.g. sqrt below zero
+	if (!is_finite(a.y) && !is_finite(b.y)) {
+		a.gap = true;
+		a.dev = 0.0f;
+		scratch.push_back(a);
+		return;
+	}
+
+	Sample m = { 0.5 * (a.x + b.x), 0.0, -1.0f, false };
+	m.y = fn(m.x);
+
+	const double dev = is_finite(a.y) && is_finite(b.y) && is_finite(m.y)
+		? std::abs(m.y - 0.5 * (a.y + b.y))
+		: std::numeric_limits<double>::infinity();
+
+	// a straight enough segment is done once its midpoint is in
+	const bool straight = dev * sy <= PLOT_BUILD_SLACK * PLOT_TOL_PX
+		&& 0.5 * w_px <= PLOT_BUILD_SLACK * PLOT_MAX_SEG_PX;
+	a.dev = m.dev = straight ? (float)dev : -1.0f;
+	a.gap = false;
+
+	refine_segment(fn, a, m, sx, sy, depth + 1);
+	refine_segment(fn, m, b, sx, sy, depth + 1);
+}
+
+void Plotter::refine(Cache &c, double x_lo, double x_hi, double sx, double sy) {
+	const std::vector<Sample> &s = c.samples;
+	if (s.size() < 2) return;
+
+	scratch.clear();
+	for (size_t i = 0; i + 1 < s.size(); ++i) {
+		if (s[i + 1].x < x_lo || s[i].x > x_hi) {
+			scratch.push_back(s[i]);
+		} else {
+			refine_segment(c.fn, s[i], s[i + 1], sx, sy, 0);
+		}
+	}
+	scratch.push_back(s.back());
+
+	c.samples.swap(scratch);
+	c.sx_built = std::max(c.sx_built, sx);
+}
+
+// Liang-Barsky: clips the segment to r, tells whether its ends moved
+static bool clip_segment(double *x0, double *y0, double *x1, double *y1, const SDL_FRect &r, bool *cut0, bool *cut1) {
+	const double dx = *x1 - *x0, dy = *y1 - *y0;
+	const double p[4] = { -dx, dx, -dy, dy };
+	const double q[4] = { *x0 - r.x, r.x + r.w - *x0, *y0 - r.y, r.y + r.h - *y0 };
+
+	double t0 = 0.0, t1 = 1.0;
+	for (int k = 0; k < 4; ++k) {
+		if (p[k] == 0.0) {
+			if (q[k] < 0.0) return false;
+			continue;
+		}
+		const double t = q[k] / p[k];
+		if (p[k] < 0.0) {
+			if (t > t1) return false;
+			if (t > t0) t0 = t;
+		} else {
+			if (t < t0) return false;
+			if (t < t1) t1 = t;
+		}
+	}
+
+	*cut0 = t0 > 0.0;
+	*cut1 = t1 < 1.0;
+	const double sx0 = *x0, sy0 = *y0;
+	*x0 = sx0 + t0 * dx;
+	*y0 = sy0 + t0 * dy;
+	*x1 = sx0 + t1 * dx;
+	*y1 = sy0 + t1 * dy;
+	return true;
+}
+
+// visible polylines of c into points and runs, clipped to the scene's rect
+void Plotter::emit(const Cache &c, double x_lo, double x_hi) {
+	const std::vector<Sample> &s = c.samples;
+	points.clear();
+	runs.clear();
+
+	bool open = false;
+	for (size_t i = 0; i + 1 < s.size(); ++i) {
+		const Sample &a = s[i], &b = s[i + 1];
+		if (b.x < x_lo || a.x > x_hi) continue;
+
+		if (a.gap || !is_finite(a.y) || !is_finite(b.y)) {
+			open = false;
+			continue;
+		}
+
+		double x0 = cs->x_space_to_screen(a.x), y0 = cs->y_space_to_screen(a.y);
+		double x1 = cs->x_space_to_screen(b.x), y1 = cs->y_space_to_screen(b.y);
+		bool cut0, cut1;
+		if (!clip_segment(&x0, &y0, &x1, &y1, cs->dim, &cut0, &cut1)) {
+			open = false;
+			continue;
+		}
+
+		if (!open || cut0) {
+			runs.push_back(points.size());
+			SDL_FPoint p0 = { (float)x0, (float)y0 };
+			points.push_back(p0);
+		}
+		SDL_FPoint p1 = { (float)x1, (float)y1 };
+		points.push_back(p1);
+		open = !cut1;
+	}
+	runs.push_back(points.size());
+}
+
+void Plotter::draw(SDL_Renderer *renderer, const PlotCurve *curves, size_t n) {
+	const double sx = cs->x_axis.scale, sy = cs->y_axis.scale;
+	if (!(sx > 0.0) || !(sy > 0.0) || cs->dim.w <= 0.0f) return;
+
+	const double x_lo = cs->x_screen_to_space(cs->dim.x);
+	const double x_hi = cs->x_screen_to_space(cs->dim.x + cs->dim.w);
+
+	for (size_t i = 0; i < n; ++i) {
+		Cache &c = cache_for(curves[i].fn);
+		cover(c, x_lo, x_hi, sx);
+		refine(c, x_lo, x_hi, sx, sy);
+		emit(c, x_lo, x_hi);
+
+		// SDL_RenderLines joins all its points, so every polyline is its
+		// own call; the renderer batches them into one draw per color
+		SDL_SetRenderDrawColor(renderer, curves[i].r, curves[i].g, curves[i].b, SDL_ALPHA_OPAQUE);
+		for (size_t k = 0; k + 1 < runs.size(); ++k) {
+			SDL_RenderLines(renderer, &points[runs[k]], (int)(runs[k + 1] - runs[k]));
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <vector>
+
+#include "axes.hpp"
+
+typedef double (*PlotFn)(double);
+
+struct PlotCurve {
+	PlotFn fn;
+	Uint8 r, g, b;
+};
+
+/*
+ * Adaptive function plotter over a CoordinateSystem. Samples are kept in
+ * space coordinates per function between frames, so a pan only evaluates
+ * the strip that came into view and a zoom only the segments that are no
+ * longer straight at the new scale. Segments are halved where the curve
+ * bends; where a jump survives halving down to a sliver of a pixel, or
+ * the function is not finite, the line is broken instead of joined
+ */
+class Plotter {
+	struct Sample {
+		double x, y;
+		float dev;  // midpoint deviation of the segment to the next sample, space units; < 0 untested
+		bool gap;   // no line to the next sample
+	};
+
+	struct Cache {
+		PlotFn fn;
+		std::vector<Sample> samples;  // sorted by x
+		double sx_built;              // finest x scale refined for, px per unit
+	};
+
+	const CoordinateSystem *cs;
+	std::vector<Cache> caches;
+	std::vector<Sample> scratch;     // refinement output, swapped with a cache's samples
+	std::vector<SDL_FPoint> points;  // screen polylines of one curve
+	std::vector<size_t> runs;        // where each polyline starts in points
+
+	Cache &cache_for(PlotFn fn);
+	void cover(Cache &c, double x_lo, double x_hi, double sx);
+	void refine(Cache &c, double x_lo, double x_hi, double sx, double sy);
+	void refine_segment(PlotFn fn, Sample a, const Sample &b, double sx, double sy, int depth);
+	bool is_break(PlotFn fn, Sample a, Sample b, double sy) const;
+	void emit(const Cache &c, double x_lo, double x_hi);
+public:
+	explicit Plotter(const CoordinateSystem *coords) : cs(coords) {}
+
+	// fn's values changed, e.g. live data; its samples are dropped
+	void forget(PlotFn fn);
+
+	// same order as given, one color switch per curve
+	void draw(SDL_Renderer *renderer, const PlotCurve *curves, size_t n);
+};
@@ -0,0 +1,99 @@
+#include <stdexcept>
+
+#include "render_pool.hpp"
+
+RenderPool::RenderPool(int n_workers)
+		: threads(NULL), n_threads(0),
+		  fn(NULL), user(NULL), n_rows(0), band(1),
+		  busy(0), generation(0), stop(false) {
+	if (n_workers < 0) n_workers = SDL_GetNumLogicalCPUCores() - 1;
+	if (n_workers < 0) n_workers = 0;
+
+	SDL_SetAtomicInt(&next_band, 0);
+
+	mtx = SDL_CreateMutex();
+	cv_work = SDL_CreateCondition();
+	cv_done = SDL_CreateCondition();
+	if (!mtx || !cv_work || !cv_done) throw std::runtime_error(SDL_GetError());
+
+	threads = new SDL_Thread*[n_workers > 0 ? n_workers : 1];
+	for (int i = 0; i < n_workers; ++i) {
+		threads[n_threads] = SDL_CreateThread(RenderPool::worker_entry, "draww_render", this);
+		if (!threads[n_threads]) {
+			SDL_Log("Couldn't create render thread: %s", SDL_GetError());
+			break;
+		}
+		++n_threads;
+	}
+}
+
+RenderPool::~RenderPool() {
+	SDL_LockMutex(mtx);
+	stop = true;
+	SDL_BroadcastCondition(cv_work);
+	SDL_UnlockMutex(mtx);
+
+	for (int i = 0; i < n_threads; ++i) SDL_WaitThread(threads[i], NULL);
+	delete[] threads;
+
+	SDL_DestroyCondition(cv_done);
+	SDL_DestroyCondition(cv_work);
+	SDL_DestroyMutex(mtx);
+}
+
+void RenderPool::run(int rows, int band_rows, RowBandFn band_fn, void *band_user) {
+	if (rows <= 0) return;
+
+	SDL_LockMutex(mtx);
+	fn     = band_fn;
+	user   = band_user;
+	n_rows = rows;
+	band   = band_rows > 0 ? band_rows : 1;
+	SDL_SetAtomicInt(&next_band, 0);
+	busy   = n_threads;
+	++generation;
+	SDL_BroadcastCondition(cv_work);
+	SDL_UnlockMutex(mtx);
+
+	work();
+
+	SDL_LockMutex(mtx);
+	while (busy > 0) SDL_WaitCondition(cv_done, mtx);
+	SDL_UnlockMutex(mtx);
+}
+
+void RenderPool::work() {
+	for (;;) {
+		const int y0 = SDL_AddAtomicInt(&next_band, 1) * band;
+		if (y0 >= n_rows) break;
+
+		const int y1 = y0 + band < n_rows ? y0 + band : n_rows;
+		fn(user, y0, y1);
+	}
+}
+
+int RenderPool::worker_entry(void *self_void) {
+	RenderPool *self = static_cast<RenderPool*>(self_void);
+	Uint32 seen = 0;
+
+	for (;;) {
+		SDL_LockMutex(self->mtx);
+		while (!self->stop && self->generation == seen) {
+			SDL_WaitCondition(self->cv_work, self->mtx);
+		}
+		if (self->stop) {
+			SDL_UnlockMutex(self->mtx);
+			break;
+		}
+		seen = self->generation;
+		SDL_UnlockMutex(self->mtx);
+
+		self->work();
+
+		SDL_LockMutex(self->mtx);
+		if (--self->busy == 0) SDL_SignalCondition(self->cv_done);
+		SDL_UnlockMutex(self->mtx);
+	}
+
+	return 0;
+}
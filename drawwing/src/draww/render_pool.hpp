@@ -0,0 +1,44 @@
+#pragma once
+#include <SDL3/SDL.h>
+
+// renders rows [y0, y1) of whatever `user` describes
+typedef void (*RowBandFn)(void *user, int y0, int y1);
+
+/*
+ * Persistent worker threads that split a frame into row bands.
+ * Bands are claimed dynamically, so a band full of spheres doesn't stall
+ * the others; the calling thread works too and returns when all are done
+ */
+class RenderPool {
+	SDL_Thread **threads;
+	int n_threads;
+
+	SDL_Mutex *mtx;
+	SDL_Condition *cv_work;
+	SDL_Condition *cv_done;
+
+	// current job, written under mtx before a new generation starts
+	RowBandFn fn;
+	void *user;
+	int n_rows;
+	int band;
+	SDL_AtomicInt next_band;
+
+	int busy;           // workers still inside the current job
+	Uint32 generation;  // bumped per job
+	bool stop;
+
+	static int worker_entry(void *self_void);
+	void work();
+
+	RenderPool(const RenderPool &);
+	RenderPool &operator=(const RenderPool &);
+public:
+	// n_workers < 0 picks one per logical core, minus the calling thread
+	explicit RenderPool(int n_workers = -1);
+	~RenderPool();
+
+	int size() const { return n_threads + 1; }
+
+	void run(int rows, int band_rows, RowBandFn band_fn, void *band_user);
+};
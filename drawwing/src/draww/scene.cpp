@@ -4,18 +4,6 @@
 
 #include "scene.hpp"
 
-// Floor
-static const double FLOOR_Y = -20.0;  // XZ plane
-
-static inline double checker_albedo(double x, double z) {
-	static const double CHECK_SIZE = 2.5;  // in world units
-	static const double CHECK_ALBEDO_LIGHT = 0.85;
-	static const double CHECK_ALBEDO_DARK  = 0.30;
-
-	int ix = std::floor(x / CHECK_SIZE);
-	int iz = std::floor(z / CHECK_SIZE);
-	return ((ix + iz) & 1) ? CHECK_ALBEDO_DARK : CHECK_ALBEDO_LIGHT;
-}
 static inline double darken_by_distance(double dist) {
 	static const double DIST_DARKEN_K = 0.010; // in world units
 
@@ -36,14 +24,57 @@ static inline double clamp01(double x) {
 	return x < 0 ? 0 : (x > 1 ? 1 : x);
 }
 
-static inline double atan_penumbra(double dist, double radius, double width) {
-	static const double SHADOW_ROUGH = 8.0;  // arctg roughness
+static const double SHADOW_ROUGH = 8.0;  // arctg roughness
+static const double SHADOW_REL_W = 0.30;  // penumbra width phrased as a radius fraction
+
+// spheres from which on shadows go through the per-light grids
+static const size_t SHADOW_GRID_MIN_SPHERES = 64;
+
+/*
+ * atan on [0, inf): odd minimax polynomial on [0, 1] (Abramowitz & Stegun
+ * 4.4.49) and atan(x) = pi/2 - atan(1/x) past that. |error| <= 1e-5 rad
+ */
+static inline double fast_atan(double x) {
+	const bool inv = x > 1.0;
+	const double z = inv ? 1.0 / x : x;
+	const double z2 = z * z;
+	const double a = z * (0.9998660 + z2 * (-0.3302995 + z2 * (0.1801410 + z2 * (-0.0851330 + z2 * 0.0208351))));
+	return inv ? 1.5707963267948966 - a : a;
+}
 
+// 1 / atan(SHADOW_ROUGH * width) for a sphere, see atan_penumbra
+static inline double penumbra_norm(double radius) {
+	return 1.0 / (std::atan(SHADOW_ROUGH * SHADOW_REL_W * radius) + 1e-12);
+}
+
+// f(l0)=0, f(l0+w)=1; `norm` from penumbra_norm. The atan error shifts
+// the result by at most 1e-5 * norm, below one gray level for r >= 0.05
+static inline double atan_penumbra(double dist, double radius, double norm) {
 	if (dist <= radius) return 0.0;
-	// f(l0)=0, f(l0+w)=1
-	const double num = std::atan(SHADOW_ROUGH * (dist - radius));
-	const double den = std::atan(SHADOW_ROUGH * width) + 1e-12;
-	return clamp01(num / den);
+	return clamp01(fast_atan(SHADOW_ROUGH * (dist - radius)) * norm);
+}
+
+/*
+ * One sphere's share of the shadow on the segment point -> point + dir*len,
+ * multiplied into *shadow. False once the point is (nearly) fully dark
+ */
+static inline bool apply_penumbra(const Sphere &s, double norm, const Vector3 &point, const Vector3 &dir, double len, double *shadow) {
+	static const double EARLY_EXIT = 1e-3;
+
+	// project sphere center onto (point + t*d) ray
+	double t = (s.pos - point) ^ dir;
+	if (t <= 0.0 || t >= len) return true;
+
+	Vector3 closest = point + dir * t;
+	Vector3 diff = s.pos - closest;
+	double delta = diff.length();
+
+	// hard shadow
+	if (delta < s.radius) return false;
+
+	// penumbra
+	*shadow *= atan_penumbra(delta, s.radius, norm);
+	return *shadow >= EARLY_EXIT;
 }
 
 static inline CamBasis make_cam_basis(const Camera *camera) {
@@ -141,73 +172,67 @@ void Scene::blit_bg(Uint8 r, Uint8 g, Uint8 b) {
 }
 
 void Scene::draw_func(double (fn)(double)) {
+	const PlotCurve curve = { fn, CLR_BLACK };
+	draw_funcs(&curve, 1);
+}
+
+void Scene::draw_funcs(const PlotCurve *curves, size_t n) {
 	assert(cs->dim.w >= 0);
 	assert(cs->x_axis.scale > 0);
 	assert(cs->y_axis.scale > 0);
 
-	size_t n_pixels = (size_t)(cs->dim.w), i;
-	SDL_FPoint *pixels = new SDL_FPoint[n_pixels];
-
-	if (pixels == NULL) {
-		throw std::runtime_error("OOM");
-	}
-
-	float cs_x, value;
-	for (i = 0; i < n_pixels; ++i) {
-		cs_x = cs->x_screen_to_space(cs->dim.x + (float)i);
-		value = fn(cs_x);
-		pixels[i].x = cs->dim.x + i;
-		pixels[i].y = cs->y_space_to_screen(value);
-		if (pixels[i].y < cs->dim.y || pixels[i].y > cs->dim.y + cs->dim.h) {
-			pixels[i].y = 0;
-		}
-	}
-	SDL_SetRenderDrawColor(renderer, CLR_BLACK, SDL_ALPHA_OPAQUE);
-	SDL_RenderPoints(renderer, pixels, n_pixels);
-	delete[] pixels;
+	plotter.draw(renderer, curves, n);
 }
 
-double Scene::shadow_factor_to_light(const Vector3& light, const Vector3& point, const Sphere* exclude) const {
-	static const double EARLY_EXIT = 1e-3;
-	static const double REL_W = 0.30;  // penumbra width phrased as a radius fraction
+void Scene::forget_func(double (fn)(double)) {
+	plotter.forget(fn);
+}
 
+double Scene::shadow_factor_to_light(const Vector3& light, const Vector3& point, const Sphere* exclude, const ShadowGrid *grid) const {
 	Vector3 segment = light - point;
 	double len = segment.length();
 	Vector3 dir = !segment;
 
 	double shadow = 1.0;
 
-	for (size_t i = 0; i < spheres.size(); ++i) {
-		const Sphere* s = &spheres[i];
-		if (s == exclude) continue;
-
-		// project sphere center onto (point + t*d) ray
-		double t = (s->pos - point) ^ dir;
-		if (t <= 0.0 || t >= len) continue;
-
-		Vector3 closest = point + dir * t;
-		Vector3 diff = s->pos - closest;
-		double delta = diff.length();
+	if (grid) {
+		size_t n = 0;
+		const unsigned *cand = grid->lookup(-dir, &n);
+		for (size_t k = 0; k < n; ++k) {
+			const Sphere &s = spheres[cand[k]];
+			if (&s == exclude) continue;
+			if (!apply_penumbra(s, penumbra_norms[cand[k]], point, dir, len, &shadow)) return 0.0;
+		}
+		return clamp01(shadow);
+	}
 
-		// hard shadow
-		if (delta < s->radius) return 0.0;
+	const SphereQuery q = sphere_query(point, dir, len);
+	unsigned cand[SPHERE_CANDIDATES];
+	size_t cursor = 0;
 
-		// penumbra
-		const double w = REL_W * s->radius;
-		double fac = atan_penumbra(delta, s->radius, w);
-		shadow *= fac;
+	while (cursor < packed.size()) {
+		const size_t n = kernels->segment(packed, q, &cursor, cand);
 
-		if (shadow < EARLY_EXIT) return 0.0;
+		for (size_t k = 0; k < n && cand[k] < packed.count; ++k) {
+			const Sphere &s = spheres[cand[k]];
+			if (&s == exclude) continue;
+			if (!apply_penumbra(s, penumbra_norms[cand[k]], point, dir, len, &shadow)) return 0.0;
+		}
 	}
 
 	return clamp01(shadow);
 }
 
-double Scene::calculate_light(const Vector3 &light, const RenderContext &ctx) const {
-	static const int SPEC_POW = 30;
+void Scene::trace_shadows(const RenderContext &ctx, float *shadows) const {
+	for (size_t light_i = 0; light_i < light_sources.size(); ++light_i) {
+		const ShadowGrid *grid = light_i < shadow_grids.size() ? &shadow_grids[light_i] : NULL;
+		shadows[light_i] = (float)shadow_factor_to_light(light_sources[light_i], ctx.point, ctx.sph, grid);
+	}
+}
 
-	double shadow = this->shadow_factor_to_light(light, ctx.point, ctx.sph);
-	if (shadow <= 0.0) return 0;
+// diffuse + specular from one unoccluded light
+double Scene::light_response(const Vector3 &light, const RenderContext &ctx) const {
+	static const int SPEC_POW = 30;
 
 	Vector3 point_light = light       - ctx.point;
 	Vector3 point_cam   = *ctx.camera - ctx.point;
@@ -228,18 +253,20 @@ double Scene::calculate_light(const Vector3 &light, const RenderContext &ctx) co
 		}
 	}
 
-	return shadow * (std::max(0.0, RGB_DIFFUSION * cosalpha) + specular);
+	return std::max(0.0, RGB_DIFFUSION * cosalpha) + specular;
 }
 
-double Scene::accum_lights(const RenderContext &ctx) const {
+// ambient plus every light's response, scaled by its shadow factor
+double Scene::accum_lights(const RenderContext &ctx, const float *shadows) const {
 	double lumin = RGB_AMBIENT;
 	for (size_t light_i = 0; light_i < light_sources.size(); ++light_i) {
-		const Vector3 *light = &light_sources[light_i];
-		double added_lumin = calculate_light(*light, ctx);
-		lumin += added_lumin;
+		if (shadows[light_i] <= 0.0f) continue;
+
+		lumin += shadows[light_i] * light_response(light_sources[light_i], ctx);
 	}
 	return std::min(lumin, 255.0);
 }
+
 bool Scene::project_point_perspective(const Vector3 &p, const Camera *camera, SDL_FPoint *out) const {
 	CamBasis cb = make_cam_basis(camera);
 
@@ -277,12 +304,13 @@ void Scene::blit_axes_3d(const Camera* camera, double len_units = 6.0) {
 	if (vz) thickLineRGBA(renderer, o2d.x, o2d.y, z2d.x, z2d.y, 3, 0, 0, 255, SDL_ALPHA_OPAQUE);
 }
 
-const Sphere *Scene::sphere_intersect(double *hit, const CamBasis &cb, const Vector3 &ray_dir) const {
+// nearest sphere along the ray among `list`, which holds every sphere it may hit
+const Sphere *Scene::sphere_intersect(double *hit, const CamBasis &cb, const Vector3 &ray_dir, const unsigned *list, size_t n) const {
 	const Sphere *sph = NULL;
 	*hit = std::numeric_limits<double>::infinity();
 
-	for (size_t i = 0; i < spheres.size(); ++i) {
-		const Sphere& s = spheres[i];
+	for (size_t k = 0; k < n; ++k) {
+		const Sphere& s = spheres[list[k]];
 		Vector3 oc = cb.pos - s.pos;
 		double b = oc ^ ray_dir;
 		double c = (oc ^ oc) - s.radius * s.radius;
@@ -307,18 +335,31 @@ bool Scene::is_occluded(const Vector3 &A, const Vector3 &B) const {
 	if (tMax <= EPS_RAY) return false;
 	Vector3 dir = !d;
 
-	for (size_t i = 0; i < spheres.size(); ++i) {
-		const Sphere &s = spheres[i];
-		Vector3 oc = A - s.pos;
-		double b = oc ^ dir;
-		double c = (oc ^ oc) - s.radius * s.radius;
-		double disc = b * b - c;
-		if (disc < 0.0) continue;
+	if (drew_sdf) {
+		double t_hit;
+		return sdf_trace(A, dir, 0.0, tMax, 1e-4, &t_hit);
+	}
 
-		double sqrt_disc = std::sqrt(disc);
-		double t = -b - sqrt_disc;
-		if (t <= EPS_RAY) t = -b + sqrt_disc;
-		if (t > EPS_RAY && t < tMax - EPS_RAY) return true;
+	const SphereQuery q = sphere_query(A, dir, 0.0);
+	unsigned cand[SPHERE_CANDIDATES];
+	size_t cursor = 0;
+
+	while (cursor < packed.size()) {
+		const size_t n = kernels->ray(packed, q, &cursor, cand);
+
+		for (size_t k = 0; k < n && cand[k] < packed.count; ++k) {
+			const Sphere &s = spheres[cand[k]];
+			Vector3 oc = A - s.pos;
+			double b = oc ^ dir;
+			double c = (oc ^ oc) - s.radius * s.radius;
+			double disc = b * b - c;
+			if (disc < 0.0) continue;
+
+			double sqrt_disc = std::sqrt(disc);
+			double t = -b - sqrt_disc;
+			if (t <= EPS_RAY) t = -b + sqrt_disc;
+			if (t > EPS_RAY && t < tMax - EPS_RAY) return true;
+		}
 	}
 
 	if (std::abs(dir.y) > EPS_RAY) {
@@ -330,6 +371,8 @@ bool Scene::is_occluded(const Vector3 &A, const Vector3 &B) const {
 }
 
 void Scene::blit_light_sources(const Camera *camera, int radius_px, bool occlusion_test) {
+	if (occlusion_test) packed.pack(spheres);
+
 	for (size_t i = 0; i < light_sources.size(); ++i) {
 		const Vector3 *L = &light_sources[i];
 		if (occlusion_test && is_occluded(camera->pos, *L)) continue;
@@ -351,44 +394,82 @@ void Scene::blit_light_sources(const Camera *camera, int radius_px, bool occlusi
 	}
 }
 
-void Scene::render_with_ambient_diffusion_and_specular_light(const Camera * const camera) {
-	SDL_Rect lock = { (int)(cs->dim.x), (int)(cs->dim.y), (int)(cs->dim.w), (int)(cs->dim.h) };
+void Scene::shade_band(void *ctx_void, int y0, int y1) {
+	const BandCtx *ctx = static_cast<const BandCtx*>(ctx_void);
+	ctx->scene->shade_rows(*ctx->job, ctx->prev, ctx->cur, y0, y1);
+}
 
-	void *pixels = NULL;
-	int pitch = 0;
-	if (!pb->lock(&lock, &pixels, &pitch)) {
-		SDL_Log("LockTexture failed: %s", SDL_GetError());
-		return;
-	}
+static const size_t NO_PIXEL = (size_t)-1;
 
-	CamBasis cb = make_cam_basis(camera);
-	if (cb.focal <= 0.0) {
-		pb->unlock();
-		pb->draw();
-		return;
+// shadow step between neighbours that marks an edge, see reproject_pixel
+static const float REPROJ_SHADOW_EDGE = 0.02f;
+
+// one pixel in STATS_SAMPLE has its phases timed, spread evenly over
+// the frame; timing them all would cost more than some of the phases
+static const int STATS_SAMPLE = 16;
+
+// performance counter reading, only taken while timing
+static inline Uint64 stamp(bool timed) {
+	return timed ? SDL_GetPerformanceCounter() : 0;
+}
+
+static inline Uint64 ticks_to_ns(Uint64 ticks) {
+	return (Uint64)((double)ticks * SDL_NS_PER_SECOND / SDL_GetPerformanceFrequency());
+}
+
+// ticks one stamp() adds to an interval on average, measured once
+static Uint64 stamp_cost() {
+	static const int N = 1024;
+	static Uint64 cost = 0;
+	static bool measured = false;
+	if (!measured) {
+		const Uint64 t0 = stamp(true);
+		for (int i = 0; i < N - 1; ++i) stamp(true);
+		cost = (stamp(true) - t0) / N;
+		measured = true;
 	}
+	return cost;
+}
+
+static inline Uint64 interval(Uint64 from, Uint64 to, Uint64 cost) {
+	return to - from > cost ? to - from - cost : 0;
+}
+
+// rows are disjoint, so bands can write the locked texture and `cur`
+// concurrently; `stats` is only set while everything runs on one thread
+void Scene::shade_rows(const FrameJob &job, const ShadeHistory *prev, ShadeHistory *cur, int y0, int y1) const {
+	static const double REPROJ_TOLERANCE = 1.5;  // in pixel footprints
 
-	const double ux = cs->units_per_px_x();
-	const double uy = cs->units_per_px_y();
-	const float  cx = cs->principal_x_px();
-	const float  cy = cs->principal_y_px();
+	const CamBasis &cb = job.cb;
+	const double footprint = std::max(job.ux, job.uy) / cb.focal * REPROJ_TOLERANCE;  // per unit of distance
+	const size_t n_lights = cur->n_lights;
 
-	const Vector3 img_center = cb.pos + cb.fwd * cb.focal;
+	// phase ticks of the sampled pixels, summed over the band
+	const Uint64 cost = stats ? stamp_cost() : 0;
+	Uint64 sampled = 0, intersect = 0, shadow = 0, lighting = 0;
+	Uint64 traced = 0, reused = 0;
 
-	for (int sy = 0; sy < lock.h; ++sy) {
-		const double py = lock.y + sy + 0.5;
-		const double dy_units = -(py - cy) * uy;
+	for (int sy = y0; sy < y1; ++sy) {
+		const double py = job.lock.y + sy + 0.5;
+		const double dy_units = -(py - job.cy) * job.uy;
 
-		for (int sx = 0; sx < lock.w; ++sx) {
-			const double px = lock.x + sx + 0.5;
-			const double dx_units = (px - cx) * ux;
+		for (int sx = 0; sx < job.lock.w; ++sx) {
+			const bool timed = stats && (sx + 5 * sy) % STATS_SAMPLE == 0;
+			sampled += timed;
+			const Uint64 t_start = stamp(timed);
+
+			const double px = job.lock.x + sx + 0.5;
+			const double dx_units = (px - job.cx) * job.ux;
+			const size_t idx = (size_t)sy * job.lock.w + sx;
 
 			// point on image plane in world
-			Vector3 P = img_center + cb.right * dx_units + cb.up * dy_units;
+			Vector3 P = job.img_center + cb.right * dx_units + cb.up * dy_units;
 
 			Vector3 ray_dir = !(P - cb.pos);
+			size_t n_cand;
+			const unsigned *cand = screen_bins.lookup(sx, sy, &n_cand);
 			double hitT;
-			const Sphere *hit_sph = sphere_intersect(&hitT, cb, ray_dir);
+			const Sphere *hit_sph = sphere_intersect(&hitT, cb, ray_dir, cand, n_cand);
 
 			bool hit_plane = false;
 			if (std::abs(ray_dir.y) > 1e-3) {
@@ -400,37 +481,480 @@ void Scene::render_with_ambient_diffusion_and_specular_light(const Camera * cons
 				}
 			}
 
-			Uint8 lumin8 = RGB_VOID;
-
 			if (hitT == std::numeric_limits<double>::infinity()) {
-				pb->set_pixel_gray(pixels, pitch, sx, sy, lumin8);
+				cur->surface[idx] = SURFACE_VOID;
+				pb->set_pixel_gray(job.pixels, job.pitch, sx, sy, RGB_VOID);
+				if (timed) intersect += interval(t_start, stamp(timed), cost);
 				continue;
 			}
 
-			Vector3 hit_point  = cb.pos + ray_dir * hitT;
+			const Vector3 hit_point  = cb.pos + ray_dir * hitT;
+			const Vector3 hit_normal = hit_plane ? Vector3(0.0, 1.0, 0.0) : !(hit_point - hit_sph->pos);
+			const RenderContext ctx = { hit_point, hit_normal, hit_sph, &job.camera->pos };
 
-			if (hit_plane) {
-				const Vector3 hit_normal(0.0, 1.0, 0.0);
+			const int surface = hit_plane ? SURFACE_FLOOR : (int)(hit_sph - &spheres[0]);
+			cur->surface[idx] = surface;
+
+			const Uint64 t_hit = stamp(timed);
+
+			// the lighting is recomputed either way, only the shadows are reused
+			size_t from = NO_PIXEL;  // previous frame's pixel to take them from
+			if (prev) reproject_pixel(*prev, hit_point, surface, footprint * hitT, &from);
+
+			float *shadows = n_lights ? &cur->shadow[idx * n_lights] : NULL;
+			float *src = &cur->src[idx * 3];
+			if (from != NO_PIXEL) {
+				std::copy(&prev->shadow[from * n_lights], &prev->shadow[from * n_lights] + n_lights, shadows);
+				cur->age[idx] = prev->age[from] + 1;
+				std::copy(&prev->src[from * 3], &prev->src[from * 3] + 3, src);
+				++reused;
+			} else {
+				trace_shadows(ctx, shadows);
+				// a first frame staggers the ages, so retraces spread over frames
+				cur->age[idx] = prev ? 0 : (Uint8)((sx + 3 * sy) % REPROJ_MAX_AGE);
+				src[0] = (float)hit_point.x;
+				src[1] = (float)hit_point.y;
+				src[2] = (float)hit_point.z;
+				++traced;
+			}
+
+			const Uint64 t_shadow = stamp(timed);
 
-				RenderContext ctx = { hit_point, hit_normal, NULL, &camera->pos };
-				double lumin  = accum_lights(ctx);
+			Uint8 lumin8;
+			const double lumin = accum_lights(ctx, shadows);
+			if (hit_plane) {
 				double albedo = checker_albedo(hit_point.x, hit_point.z);
 				double atten  = darken_by_distance(hitT);
 
 				double finalL = std::min(255.0, lumin * albedo * atten);
 				lumin8 = quantize((Uint8)lround(finalL), 255);
 			} else {
-				const Vector3 hit_normal = !(hit_point - hit_sph->pos);
-
-				RenderContext ctx = { hit_point, hit_normal, hit_sph, &camera->pos };
-				double lumin = accum_lights(ctx);
 				lumin8 = quantize((Uint8)round(lumin), 255);
 			}
 
-			pb->set_pixel_gray(pixels, pitch, sx, sy, lumin8);
+			pb->set_pixel_gray(job.pixels, job.pitch, sx, sy, lumin8);
+
+			if (timed) {
+				intersect += interval(t_start, t_hit, cost);
+				shadow    += interval(t_hit, t_shadow, cost);
+				lighting  += interval(t_shadow, stamp(timed), cost);
+			}
+		}
+	}
+
+	if (stats) {
+		stats->pixels       += (Uint64)(y1 - y0) * job.lock.w;
+		stats->sampled      += sampled;
+		stats->intersect_ns += ticks_to_ns(intersect);
+		stats->shadow_ns    += ticks_to_ns(shadow);
+		stats->lighting_ns  += ticks_to_ns(lighting);
+		stats->shadows_traced += traced;
+		stats->shadows_reused += reused;
+	}
+}
+
+/*
+ * Pixel of `prev` whose shadows hold for the surface point `p`: p is
+ * projected into the previous view, and that pixel has to have seen the
+ * same surface, with shadows traced within `max_dist` of p that aren't
+ * due for a retrace. Pixels on a shadow edge are always retraced, a
+ * sample even a pixel off would move the edge
+ */
+bool Scene::reproject_pixel(const ShadeHistory &prev, const Vector3 &p, int surface, double max_dist, size_t *prev_idx) const {
+	const FrameJob &pj = prev.frame;
+
+	const Vector3 v = p - pj.cb.pos;
+	const double zc = v ^ pj.cb.fwd;
+	if (zc <= 1e-6) return false;
+
+	const double fx = std::floor(pj.cx + pj.cb.focal * (v ^ pj.cb.right) / zc / pj.ux - pj.lock.x);
+	const double fy = std::floor(pj.cy - pj.cb.focal * (v ^ pj.cb.up)    / zc / pj.uy - pj.lock.y);
+	if (fx < 0.0 || fy < 0.0 || fx >= pj.lock.w || fy >= pj.lock.h) return false;
+
+	const size_t idx = (size_t)fy * pj.lock.w + (size_t)fx;
+	if (prev.surface[idx] != surface || prev.age[idx] + 1 >= REPROJ_MAX_AGE) return false;
+
+	const float *src = &prev.src[idx * 3];
+	const Vector3 traced(src[0], src[1], src[2]);
+	if ((traced - p).length() > max_dist) return false;
+
+	const int sx = (int)fx, sy = (int)fy;
+	const float *sh = &prev.shadow[idx * prev.n_lights];
+	const int nx[4] = { sx - 1, sx + 1, sx, sx };
+	const int ny[4] = { sy, sy, sy - 1, sy + 1 };
+	for (int k = 0; k < 4; ++k) {
+		if (nx[k] < 0 || ny[k] < 0 || nx[k] >= pj.lock.w || ny[k] >= pj.lock.h) continue;
+
+		const size_t n_idx = (size_t)ny[k] * pj.lock.w + nx[k];
+		if (prev.surface[n_idx] != surface) return false;  // silhouette
+
+		const float *n_sh = &prev.shadow[n_idx * prev.n_lights];
+		for (size_t l = 0; l < prev.n_lights; ++l) {
+			if (std::abs(n_sh[l] - sh[l]) > REPROJ_SHADOW_EDGE) return false;
 		}
 	}
 
+	*prev_idx = idx;
+	return true;
+}
+
+// per-frame sphere data: SIMD pack, penumbra norms, shadow grids
+void Scene::prepare_spheres() {
+	packed.pack(spheres);
+
+	penumbra_norms.resize(spheres.size());
+	for (size_t i = 0; i < spheres.size(); ++i) penumbra_norms[i] = penumbra_norm(spheres[i].radius);
+
+	// below that a SIMD scan of everything beats the grid lookup
+	if (spheres.size() < SHADOW_GRID_MIN_SPHERES) {
+		shadow_grids.clear();
+		return;
+	}
+
+	shadow_grids.resize(light_sources.size());
+	for (size_t i = 0; i < light_sources.size(); ++i) {
+		shadow_grids[i].build(light_sources[i], spheres, 1.0 + SHADOW_REL_W);
+	}
+}
+
+static inline bool same_vec(const Vector3 &a, const Vector3 &b) {
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// spheres and lights as of the last render, invalidate() counts as a change
+bool Scene::world_unchanged() const {
+	if (dirty) return false;
+
+	if (spheres.size() != shaded_spheres.size() || light_sources.size() != shaded_lights.size()) return false;
+	for (size_t i = 0; i < spheres.size(); ++i) {
+		if (!same_vec(spheres[i].pos, shaded_spheres[i].pos) || spheres[i].radius != shaded_spheres[i].radius) return false;
+	}
+	for (size_t i = 0; i < light_sources.size(); ++i) {
+		if (!same_vec(light_sources[i], shaded_lights[i])) return false;
+	}
+	return true;
+}
+
+// redraws the last shaded pixels if `mode` would produce the same ones
+bool Scene::reuse_shaded(ShadeMode mode, const Camera *camera) {
+	if (shaded_mode != mode) return false;
+	if (!same_vec(camera->pos, shaded_camera.pos) || !same_vec(camera->dir, shaded_camera.dir)) return false;
+	if (!world_unchanged()) return false;
+
+	pb->draw();
+	return true;
+}
+
+void Scene::remember_shaded(ShadeMode mode, const Camera *camera) {
+	shaded_mode    = mode;
+	shaded_camera  = *camera;
+	shaded_spheres = spheres;
+	shaded_lights  = light_sources;
+	dirty = false;
+}
+
+void Scene::invalidate() {
+	dirty = true;
+	if (static_layer) static_layer->invalidate();
+}
+
+bool Scene::begin_static_layer() {
+	if (!static_layer) static_layer = new Layer(renderer, pb->width, pb->height);
+	if (static_layer->is_valid()) return false;
+	return static_layer->begin();
+}
+
+void Scene::end_static_layer() {
+	static_layer->end();
+}
+
+void Scene::blit_static_layer() {
+	if (static_layer) static_layer->draw(&cs->dim);
+}
+
+// locks the scene's region and fills in the camera part of a job
+bool Scene::begin_frame(const Camera *camera, FrameJob *job) {
+	SDL_Rect lock = { (int)(cs->dim.x), (int)(cs->dim.y), (int)(cs->dim.w), (int)(cs->dim.h) };
+
+	void *pixels = NULL;
+	int pitch = 0;
+	if (!pb->lock(&lock, &pixels, &pitch)) {
+		SDL_Log("LockTexture failed: %s", SDL_GetError());
+		return false;
+	}
+
+	job->camera = camera;
+	job->cb = make_cam_basis(camera);
+	if (job->cb.focal <= 0.0) {
+		pb->unlock();
+		pb->draw();
+		return false;
+	}
+
+	job->ux = cs->units_per_px_x();
+	job->uy = cs->units_per_px_y();
+	job->cx = cs->principal_x_px();
+	job->cy = cs->principal_y_px();
+	job->img_center = job->cb.pos + job->cb.fwd * job->cb.focal;
+	job->lock   = lock;
+	job->pixels = pixels;
+	job->pitch  = pitch;
+	return true;
+}
+
+void Scene::render_with_ambient_diffusion_and_specular_light(const Camera * const camera) {
+	static const int BAND_ROWS = 8;
+	static const size_t REPROJ_MIN_SPHERES = 16;
+
+	drew_sdf = false;
+	if (reuse_shaded(SHADED_ANALYTIC, camera)) return;
+	const bool same_world = shaded_mode == SHADED_ANALYTIC && world_unchanged();
+
+	FrameJob job;
+	if (!begin_frame(camera, &job)) return;
+
+	const Uint64 t_setup = stamp(stats != NULL);
+	if (!same_world) prepare_spheres();  // still valid otherwise
+
+	const ScreenView view = {
+		job.cb.pos, job.cb.fwd, job.cb.right, job.cb.up,
+		job.cb.focal / job.ux, job.cb.focal / job.uy,
+		job.cx - job.lock.x, job.cy - job.lock.y,
+		job.lock.w, job.lock.h
+	};
+	screen_bins.build(view, spheres);
+
+	if (stats) {
+		stats->setup_ns += ticks_to_ns(stamp(true) - t_setup);
+		++stats->frames;
+	}
+
+	const ShadeHistory &prev = history[history_prev];
+	ShadeHistory &cur = history[history_prev ^ 1];
+
+	// shadows only carry over while nothing but the camera moved, and a
+	// few spheres are cheaper to trace again than to look up
+	const bool reusable = reproject && same_world && prev.valid
+		&& spheres.size() >= REPROJ_MIN_SPHERES
+		&& prev.n_lights == light_sources.size() && !light_sources.empty()
+		&& prev.frame.lock.x == job.lock.x && prev.frame.lock.y == job.lock.y
+		&& prev.frame.lock.w == job.lock.w && prev.frame.lock.h == job.lock.h;
+
+	const size_t n_pixels = (size_t)job.lock.w * job.lock.h;
+	cur.frame = job;
+	cur.n_lights = light_sources.size();
+	cur.surface.resize(n_pixels);
+	cur.age.resize(n_pixels);
+	cur.shadow.resize(n_pixels * cur.n_lights);
+	cur.src.resize(n_pixels * 3);
+
+	// timed bands would race on `stats`, they stay on this thread
+	BandCtx ctx = { this, &job, reusable ? &prev : NULL, &cur };
+	if (pool && !stats) {
+		pool->run(job.lock.h, BAND_ROWS, Scene::shade_band, &ctx);
+	} else {
+		shade_band(&ctx, 0, job.lock.h);
+	}
+
+	cur.valid = true;
+	history_prev ^= 1;
+
+	pb->unlock();
+	pb->draw();
+	remember_shaded(SHADED_ANALYTIC, camera);
+}
+
+// ---------------------------------------------------------------- SDF ----
+
+static const double SDF_MAX_DIST = 250.0;
+static const int    SDF_CONE_TILE = 8;  // pixels per side of a cone pre-pass tile
+
+Vector3 Scene::pixel_dir(const FrameJob &job, double px, double py) {
+	const double dx_units =  (px - job.cx) * job.ux;
+	const double dy_units = -(py - job.cy) * job.uy;
+
+	// point on image plane in world
+	Vector3 P = job.img_center + job.cb.right * dx_units + job.cb.up * dy_units;
+	return !(P - job.cb.pos);
+}
+
+/*
+ * Over-relaxed sphere tracing (Keinert et al.): steps are stretched by
+ * OMEGA while consecutive unbounding spheres still overlap, and fall back
+ * to plain steps once they don't. The hit is the step with the smallest
+ * distance relative to t, so grazing rays don't get lost
+ */
+bool Scene::sdf_trace(const Vector3 &ro, const Vector3 &rd, double t_min, double t_max, double pix_angle, double *t_hit) const {
+	static const int    MAX_STEPS = 160;
+	static const double OMEGA     = 1.6;
+
+	double omega = OMEGA;
+	double t = t_min;
+	double prev_r = 0.0;
+	double step = 0.0;
+	double cand_t = t_min;
+	double cand_err = SDF_UNBOUNDED;
+
+	for (int i = 0; i < MAX_STEPS; ++i) {
+		const double signed_r = sdf->eval(ro + rd * t);
+		const double r = std::fabs(signed_r);
+
+		const bool sor_fail = omega > 1.0 && r + prev_r < step;
+		if (sor_fail) {
+			step -= omega * step;
+			omega = 1.0;
+		} else {
+			step = signed_r * omega;
+		}
+		prev_r = r;
+
+		const double err = r / std::max(t, 1e-3);
+		if (!sor_fail && err < cand_err) {
+			cand_t = t;
+			cand_err = err;
+		}
+		if ((!sor_fail && err < pix_angle) || t > t_max) break;
+
+		t += step;
+	}
+
+	if (t > t_max || cand_err > pix_angle) return false;
+	*t_hit = cand_t;
+	return true;
+}
+
+// penumbra from the closest miss along the shadow ray, same roughness as the analytic one
+double Scene::sdf_soft_shadow(const Vector3 &point, const Vector3 &light) const {
+	static const double SHADOW_K = 8.0;
+	static const int    MAX_STEPS = 96;
+
+	Vector3 seg = light - point;
+	const double len = seg.length();
+	const Vector3 dir = seg / len;
+
+	double shadow = 1.0;
+	double t = 1e-2;
+	for (int i = 0; i < MAX_STEPS && t < len; ++i) {
+		const double h = sdf->eval(point + dir * t);
+		if (h < 1e-4) return 0.0;
+
+		shadow = std::min(shadow, SHADOW_K * h / t);
+		t += std::max(h, 1e-2);
+	}
+	return clamp01(shadow);
+}
+
+// tetrahedral central differences, 4 evaluations
+Vector3 Scene::sdf_normal(const Vector3 &p, double h) const {
+	const Vector3 k0( 1, -1, -1), k1(-1, -1,  1), k2(-1,  1, -1), k3( 1,  1,  1);
+	return !(k0 * sdf->eval(p + k0 * h) + k1 * sdf->eval(p + k1 * h) +
+	         k2 * sdf->eval(p + k2 * h) + k3 * sdf->eval(p + k3 * h));
+}
+
+void Scene::sdf_cone_band(void *ctx_void, int ty0, int ty1) {
+	const SdfBandCtx *ctx = static_cast<const SdfBandCtx*>(ctx_void);
+	ctx->scene->sdf_cone_rows(*ctx->job, ty0, ty1);
+}
+
+void Scene::sdf_shade_band(void *ctx_void, int y0, int y1) {
+	const SdfBandCtx *ctx = static_cast<const SdfBandCtx*>(ctx_void);
+	ctx->scene->sdf_shade_rows(*ctx->job, y0, y1);
+}
+
+/*
+ * March one cone per tile, wide enough to contain every pixel ray of the
+ * tile; where it first touches geometry is a safe start for all of them
+ */
+void Scene::sdf_cone_rows(SdfFrameJob &job, int ty0, int ty1) const {
+	static const int MAX_STEPS = 64;
+
+	const FrameJob &fj = job.frame;
+	const double k = std::tan(0.75 * SDF_CONE_TILE * job.pix_angle);  // cone radius per unit t
+
+	for (int ty = ty0; ty < ty1; ++ty) {
+		for (int tx = 0; tx < job.tiles_x; ++tx) {
+			const double px = fj.lock.x + (tx + 0.5) * SDF_CONE_TILE;
+			const double py = fj.lock.y + (ty + 0.5) * SDF_CONE_TILE;
+			const Vector3 dir = pixel_dir(fj, px, py);
+
+			double t = 0.0;
+			for (int i = 0; i < MAX_STEPS && t < SDF_MAX_DIST; ++i) {
+				const double d = sdf->eval(fj.cb.pos + dir * t);
+				// farthest step that keeps the cone's cross-section inside the empty ball
+				const double step = (d - t * k) / (1.0 + k);
+				if (step <= 1e-3 * (1.0 + t)) break;
+				t += step;
+			}
+
+			job.tile_t[ty * job.tiles_x + tx] = std::min(t, SDF_MAX_DIST);
+		}
+	}
+}
+
+void Scene::sdf_shade_rows(const SdfFrameJob &job, int y0, int y1) const {
+	const FrameJob &fj = job.frame;
+
+	for (int sy = y0; sy < y1; ++sy) {
+		const double py = fj.lock.y + sy + 0.5;
+		const double *tile_row = &job.tile_t[(sy / SDF_CONE_TILE) * job.tiles_x];
+
+		for (int sx = 0; sx < fj.lock.w; ++sx) {
+			const double px = fj.lock.x + sx + 0.5;
+			const Vector3 dir = pixel_dir(fj, px, py);
+
+			double t;
+			if (!sdf_trace(fj.cb.pos, dir, tile_row[sx / SDF_CONE_TILE], SDF_MAX_DIST, 0.5 * job.pix_angle, &t)) {
+				pb->set_pixel_gray(fj.pixels, fj.pitch, sx, sy, RGB_VOID);
+				continue;
+			}
+
+			const Vector3 hit_point  = fj.cb.pos + dir * t;
+			const Vector3 hit_normal = sdf_normal(hit_point, std::max(1e-4, t * job.pix_angle));
+
+			RenderContext ctx = { hit_point, hit_normal, NULL, &fj.camera->pos };
+
+			double lumin = RGB_AMBIENT;
+			const Vector3 shadow_origin = hit_point + hit_normal * std::max(1e-3, 2.0 * t * job.pix_angle);
+			for (size_t light_i = 0; light_i < light_sources.size(); ++light_i) {
+				const Vector3 &light = light_sources[light_i];
+				const double shadow = sdf_soft_shadow(shadow_origin, light);
+				if (shadow > 0.0) lumin += shadow * light_response(light, ctx);
+			}
+
+			const double albedo = sdf->albedo(hit_point);
+			const double finalL = std::min(255.0, std::min(lumin, 255.0) * albedo * darken_by_distance(t));
+			pb->set_pixel_gray(fj.pixels, fj.pitch, sx, sy, quantize((Uint8)lround(finalL), 255));
+		}
+	}
+}
+
+void Scene::render_sdf(const Camera * const camera) {
+	static const int BAND_ROWS = 8;
+
+	if (!sdf) return;
+	drew_sdf = true;
+	if (reuse_shaded(SHADED_SDF, camera)) return;
+	sdf->refit();
+
+	SdfFrameJob job;
+	if (!begin_frame(camera, &job.frame)) return;
+
+	const FrameJob &fj = job.frame;
+	job.pix_angle = std::max(fj.ux, fj.uy) / fj.cb.focal;
+	job.tiles_x = (fj.lock.w + SDF_CONE_TILE - 1) / SDF_CONE_TILE;
+	job.tiles_y = (fj.lock.h + SDF_CONE_TILE - 1) / SDF_CONE_TILE;
+	job.tile_t.assign(job.tiles_x * job.tiles_y, 0.0);
+
+	SdfBandCtx ctx = { this, &job };
+	if (pool) {
+		pool->run(job.tiles_y, 1, Scene::sdf_cone_band, &ctx);
+		pool->run(fj.lock.h, BAND_ROWS, Scene::sdf_shade_band, &ctx);
+	} else {
+		sdf_cone_rows(job, 0, job.tiles_y);
+		sdf_shade_rows(job, 0, fj.lock.h);
+	}
+
 	pb->unlock();
 	pb->draw();
+	remember_shaded(SHADED_SDF, camera);
 }
@@ -2,8 +2,15 @@
 #include <vector>
 
 #include "axes.hpp"
+#include "layer.hpp"
 #include "linalg.hpp"
 #include "pixel_buffer.hpp"
+#include "plotter.hpp"
+#include "render_pool.hpp"
+#include "screen_bins.hpp"
+#include "sdf.hpp"
+#include "shadow_grid.hpp"
+#include "sphere_pack.hpp"
 
 #define RGB_BLACK 0
 #define RGB_WHITE 255
@@ -26,6 +33,9 @@
 #define CLR_AMBIENT CLR_MONO(RGB_AMBIENT)
 #define CLR_VOID CLR_MONO(RGB_VOID)
 
+// Floor of the analytic renderer
+static const double FLOOR_Y = -20.0;  // XZ plane
+
 struct RenderContext {
 	Vector3 point;
 	Vector3 normal;
@@ -46,42 +56,204 @@ struct Camera {
 	Vector3 dir;
 };
 
+// everything a band of rows needs, shared read-only by the render threads
+struct FrameJob {
+	const Camera *camera;
+	CamBasis cb;
+	Vector3 img_center;
+	double ux, uy;
+	float cx, cy;
+	SDL_Rect lock;
+	void *pixels;
+	int pitch;
+};
+
+// frames a pixel's traced shadows may be reused for
+static const int REPROJ_MAX_AGE = 8;
+
+static const int SURFACE_VOID  = -1;
+static const int SURFACE_FLOOR = -2;
+
+// an analytic frame's surfaces and traced shadows, per pixel of its rect
+struct ShadeHistory {
+	FrameJob frame;             // camera and image plane, pixels are stale
+	std::vector<int> surface;   // sphere index or SURFACE_*
+	std::vector<Uint8> age;     // frames since the shadows were traced
+	std::vector<float> shadow;  // n_lights per pixel
+	std::vector<float> src;     // 3 per pixel, the point those shadows were traced at
+	size_t n_lights;
+	bool valid;
+
+	ShadeHistory() : n_lights(0), valid(false) {}
+};
+
+/*
+ * Where analytic frames spent their time, summed while Scene::stats is
+ * set. The phases are timed on a fixed sample of the pixels, so per
+ * pixel they are *_ns / sampled; setup is per frame
+ */
+struct ShadeStats {
+	Uint64 frames;
+	Uint64 pixels;
+	Uint64 sampled;
+	Uint64 setup_ns;      // per-frame sphere data and screen bins
+	Uint64 intersect_ns;  // primary rays
+	Uint64 shadow_ns;     // shadows traced or reprojected
+	Uint64 lighting_ns;   // diffuse and specular, writing the pixel
+	Uint64 shadows_traced;  // pixels that hit something, all lights each
+	Uint64 shadows_reused;
+
+	ShadeStats()
+		: frames(0), pixels(0), sampled(0), setup_ns(0), intersect_ns(0), shadow_ns(0), lighting_ns(0),
+		  shadows_traced(0), shadows_reused(0) {}
+};
+
+// cone pre-pass results for render_sdf
+struct SdfFrameJob {
+	FrameJob frame;
+	double pix_angle;  // angle covered by one pixel, radians
+	int tiles_x, tiles_y;
+	std::vector<double> tile_t;  // safe start distance per tile
+};
+
 class Scene {
 	CoordinateSystem *cs;
 	SDL_Renderer *renderer;
 	PixelBuffer *pb;
+	RenderPool *pool;  // may be NULL, then everything runs on the caller
+
+	// `spheres` as of the last begin_frame, for the SIMD filters
+	SpherePack packed;
+	const SphereKernels *kernels;
+	std::vector<double> penumbra_norms;  // per sphere
+	std::vector<ShadowGrid> shadow_grids;  // per light, empty for small scenes
+	ScreenBins screen_bins;  // for the analytic frame being shaded
+
+	// what the scene's pixels in pb were last shaded from
+	enum ShadeMode { SHADED_NONE, SHADED_ANALYTIC, SHADED_SDF };
+	ShadeMode shaded_mode;
+	Camera shaded_camera;
+	std::vector<Sphere> shaded_spheres;
+	std::vector<Vector3> shaded_lights;
+	bool dirty;  // set by invalidate()
+
+	// the frame on screen came from render_sdf, so light occlusion tests
+	// the sdf graph; otherwise the analytic spheres and floor
+	bool drew_sdf;
+
+	Layer *static_layer;  // created by the first begin_static_layer
+
+	Plotter plotter;  // samples of the functions drawn so far
+
+	Scene(const Scene &);
+	Scene &operator=(const Scene &);
 
 	bool project_point_perspective(const Vector3 &p, const Camera *camera, SDL_FPoint *out) const;
 
-	double shadow_factor_to_light(const Vector3 &light, const Vector3 &point, const Sphere *exclude) const;
-	double calculate_light(const Vector3 &light, const RenderContext &ctx) const;
-	double accum_lights(const RenderContext &ctx) const;
+	double shadow_factor_to_light(const Vector3 &light, const Vector3 &point, const Sphere *exclude, const ShadowGrid *grid) const;
+	void trace_shadows(const RenderContext &ctx, float *shadows) const;
+	double light_response(const Vector3 &light, const RenderContext &ctx) const;
+	double accum_lights(const RenderContext &ctx, const float *shadows) const;
 
-	const Sphere *sphere_intersect(double *hit, const CamBasis &cb, const Vector3 &ray_dir) const;
+	const Sphere *sphere_intersect(double *hit, const CamBasis &cb, const Vector3 &ray_dir, const unsigned *list, size_t n) const;
 
 	bool is_occluded(const Vector3 &A, const Vector3 &B) const;
+
+	// previous and current analytic frame, history[history_prev] is the former
+	ShadeHistory history[2];
+	int history_prev;
+
+	struct BandCtx {
+		const Scene *scene;
+		const FrameJob *job;
+		const ShadeHistory *prev;  // NULL when nothing can be reused
+		ShadeHistory *cur;
+	};
+	static void shade_band(void *ctx_void, int y0, int y1);
+	void shade_rows(const FrameJob &job, const ShadeHistory *prev, ShadeHistory *cur, int y0, int y1) const;
+	bool reproject_pixel(const ShadeHistory &prev, const Vector3 &p, int surface, double max_dist, size_t *prev_idx) const;
+
+	struct SdfBandCtx {
+		const Scene *scene;
+		SdfFrameJob *job;
+	};
+	static void sdf_cone_band(void *ctx_void, int ty0, int ty1);
+	static void sdf_shade_band(void *ctx_void, int y0, int y1);
+	void sdf_cone_rows(SdfFrameJob &job, int ty0, int ty1) const;
+	void sdf_shade_rows(const SdfFrameJob &job, int y0, int y1) const;
+
+	bool sdf_trace(const Vector3 &ro, const Vector3 &rd, double t_min, double t_max, double pix_angle, double *t_hit) const;
+	double sdf_soft_shadow(const Vector3 &point, const Vector3 &light) const;
+	Vector3 sdf_normal(const Vector3 &p, double h) const;
+	static Vector3 pixel_dir(const FrameJob &job, double px, double py);
+
+	void prepare_spheres();
+	bool begin_frame(const Camera *camera, FrameJob *job);
+	bool world_unchanged() const;
+	bool reuse_shaded(ShadeMode mode, const Camera *camera);
+	void remember_shaded(ShadeMode mode, const Camera *camera);
 public:
 	std::vector<Sphere> spheres;
 	std::vector<Vector3> light_sources;
 
+	// signed distance scene for render_sdf, not owned
+	SdfNode *sdf;
+
+	// analytic renderer reuses last frame's shadows where the same surface
+	// is still in view, retracing each pixel at least every REPROJ_MAX_AGE frames
+	bool reproject;
+
+	// when set, analytic frames add their phase timings here, and are
+	// shaded on the calling thread only; not owned
+	ShadeStats *stats;
+
 	Scene(
 		CoordinateSystem *coords,
 		SDL_Renderer *rend,
-		PixelBuffer *buf
-	) : cs(coords), renderer(rend), pb(buf) {
+		PixelBuffer *buf,
+		RenderPool *render_pool = NULL
+	) : cs(coords), renderer(rend), pb(buf), pool(render_pool), kernels(sphere_kernels()),
+		shaded_mode(SHADED_NONE), dirty(true), drew_sdf(false), static_layer(NULL), plotter(coords), history_prev(0),
+		sdf(NULL), reproject(true), stats(NULL) {
 		spheres = std::vector<Sphere>();
 		light_sources = std::vector<Vector3>();
 	};
 
+	~Scene() {
+		delete static_layer;
+	}
+
+	/*
+	 * Camera, spheres and lights are compared against the last render, so
+	 * an unchanged frame is not shaded again. Anything else it depends on
+	 * (the sdf graph, the coordinate system) needs an explicit invalidate()
+	 */
+	void invalidate();
+
+	// true if the static layer has to be redrawn; draw it, then end_static_layer()
+	bool begin_static_layer();
+	void end_static_layer();
+	void blit_static_layer();
+
 	void blit_axes();
 	void blit_grid();
 	void blit_bg(Uint8 r, Uint8 g, Uint8 b);
 	void blit_vector(Vector2 vec);
 
+	/*
+	 * Plots fn over the scene's rect. Samples are cached per function across
+	 * frames, pans and zooms of the coordinate system; forget_func() drops
+	 * them once fn starts returning other values
+	 */
 	void draw_func(double (fn)(double));
+	void draw_funcs(const PlotCurve *curves, size_t n);
+	void forget_func(double (fn)(double));
 
 	void blit_axes_3d(const Camera *camera, double len_units);
 
 	void blit_light_sources(const Camera *camera, int radius_px, bool occlusion_test);
 	void render_with_ambient_diffusion_and_specular_light(const Camera *camera);
+
+	// sphere-traced rendering of `sdf`, same lighting model as above
+	void render_sdf(const Camera *camera);
 };
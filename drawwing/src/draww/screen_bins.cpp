@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cmath>
+
+#include "screen_bins.hpp"
+
+// relative margin on the tangent slopes, covers rounding against the exact ray test
+static const double SLOPE_MARGIN = 1e-6;
+
+// range of tangent slopes through `eye` of a sphere at lateral offset `c`
+// and depth `z` > r, along one screen axis
+static inline void tangent_slopes(double c, double z, double r, double *lo, double *hi) {
+	const double root = r * std::sqrt(c * c + z * z - r * r);
+	const double denom = z * z - r * r;
+	const double pad = SLOPE_MARGIN * (std::abs(c) + r) / z + SLOPE_MARGIN;
+	*lo = (c * z - root) / denom - pad;
+	*hi = (c * z + root) / denom + pad;
+}
+
+// pixel span [lo, hi] to the tiles holding its pixel centers, a pixel of slack each way
+static inline bool span_tiles(double lo, double hi, int n_px, int *t0, int *t1) {
+	lo = std::floor(lo - 1.0);
+	hi = std::floor(hi + 1.0);
+	if (hi < 0.0 || lo >= n_px) return false;
+
+	*t0 = (int)std::max(0.0, lo) / SCREEN_TILE;
+	*t1 = (int)std::min((double)(n_px - 1), hi) / SCREEN_TILE;
+	return true;
+}
+
+ScreenBins::TileRange ScreenBins::silhouette_tiles(const ScreenView &view, const Sphere &s) const {
+	const TileRange none = { 0, -1, 0, -1 };
+	const TileRange all  = { 0, tiles_x - 1, 0, tiles_y - 1 };
+
+	const Vector3 v = s.pos - view.eye;
+	const double z = v ^ view.fwd;
+	const double r = s.radius;
+
+	// every ray leaves the eye forward, nothing wholly behind it can be hit
+	if (z <= -r) return none;
+
+	// a sphere around or beside the eye can cover any pixel
+	if (z <= r * (1.0 + SLOPE_MARGIN) + SLOPE_MARGIN) return all;
+
+	double sx_lo, sx_hi, sy_lo, sy_hi;
+	tangent_slopes(v ^ view.right, z, r, &sx_lo, &sx_hi);
+	tangent_slopes(v ^ view.up,    z, r, &sy_lo, &sy_hi);
+
+	TileRange tr;
+	if (!span_tiles(view.cx + sx_lo * view.sx, view.cx + sx_hi * view.sx, view.w, &tr.x0, &tr.x1)) return none;
+	if (!span_tiles(view.cy - sy_hi * view.sy, view.cy - sy_lo * view.sy, view.h, &tr.y0, &tr.y1)) return none;
+	return tr;
+}
+
+void ScreenBins::build(const ScreenView &view, const std::vector<Sphere> &spheres) {
+	tiles_x = (view.w + SCREEN_TILE - 1) / SCREEN_TILE;
+	tiles_y = (view.h + SCREEN_TILE - 1) / SCREEN_TILE;
+	const int n_tiles = tiles_x * tiles_y;
+
+	ranges.resize(spheres.size());
+	for (size_t i = 0; i < spheres.size(); ++i) ranges[i] = silhouette_tiles(view, spheres[i]);
+
+	// counting sort of (sphere, tile) pairs by tile, spheres stay in order
+	tile_start.assign(n_tiles + 1, 0);
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		const TileRange &tr = ranges[i];
+		for (int ty = tr.y0; ty <= tr.y1; ++ty) {
+			for (int tx = tr.x0; tx <= tr.x1; ++tx) ++tile_start[ty * tiles_x + tx + 1];
+		}
+	}
+	for (int t = 0; t < n_tiles; ++t) tile_start[t + 1] += tile_start[t];
+
+	items.resize(tile_start[n_tiles]);
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		const TileRange &tr = ranges[i];
+		for (int ty = tr.y0; ty <= tr.y1; ++ty) {
+			for (int tx = tr.x0; tx <= tr.x1; ++tx) items[tile_start[ty * tiles_x + tx]++] = (unsigned)i;
+		}
+	}
+
+	// filling advanced every start to the next tile's, shift them back
+	for (int t = n_tiles; t > 0; --t) tile_start[t] = tile_start[t - 1];
+	tile_start[0] = 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+
+#include "linalg.hpp"
+
+// pixels per side of a screen tile
+static const int SCREEN_TILE = 16;
+
+/*
+ * Pinhole view of a w x h pixel rect: the ray through pixel center (x, y)
+ * leaves `eye` along fwd + right * (x - cx) / sx - up * (y - cy) / sy
+ */
+struct ScreenView {
+	Vector3 eye;
+	Vector3 fwd, right, up;  // orthonormal
+	double sx, sy;           // pixels per unit of slope
+	double cx, cy;           // principal point, in the rect's pixels
+	int w, h;
+};
+
+/*
+ * Spheres binned by the screen tiles their silhouettes can cover. Every
+ * tile lists, in index order, the spheres that a ray through any of its
+ * pixels may hit, so a primary ray only visits the list of its tile
+ */
+class ScreenBins {
+	struct TileRange {
+		int x0, x1;  // tile columns, inclusive, x1 < x0 when off screen
+		int y0, y1;  // tile rows, inclusive
+	};
+
+	int tiles_x, tiles_y;
+	std::vector<unsigned> tile_start;  // tiles_x * tiles_y + 1 offsets into items
+	std::vector<unsigned> items;
+	std::vector<TileRange> ranges;     // scratch, per sphere
+
+	TileRange silhouette_tiles(const ScreenView &view, const Sphere &s) const;
+public:
+	ScreenBins() : tiles_x(0), tiles_y(0) {}
+
+	void build(const ScreenView &view, const std::vector<Sphere> &spheres);
+
+	// spheres a ray through pixel (x, y) of the view's rect may hit
+	const unsigned *lookup(int x, int y, size_t *n) const {
+		const int tile = (y / SCREEN_TILE) * tiles_x + x / SCREEN_TILE;
+		*n = tile_start[tile + 1] - tile_start[tile];
+		return items.empty() ? NULL : &items[0] + tile_start[tile];
+	}
+};
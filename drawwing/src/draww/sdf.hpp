@@ -0,0 +1,380 @@
+#pragma once
+#include <cmath>
+#include <vector>
+
+#include "linalg.hpp"
+
+static const double SDF_UNBOUNDED = 1e30;
+
+// past this distance from a node's bounding sphere it's not evaluated at all
+static const double SDF_CULL_MARGIN = 1.0;
+
+static inline double checker_albedo(double x, double z) {
+	static const double CHECK_SIZE = 2.5;  // in world units
+	static const double CHECK_ALBEDO_LIGHT = 0.85;
+	static const double CHECK_ALBEDO_DARK  = 0.30;
+
+	int ix = std::floor(x / CHECK_SIZE);
+	int iz = std::floor(z / CHECK_SIZE);
+	return ((ix + iz) & 1) ? CHECK_ALBEDO_DARK : CHECK_ALBEDO_LIGHT;
+}
+
+/*
+ * Node of a signed distance scene graph. Every node keeps a bounding
+ * sphere of its surface, so far away subtrees answer with the distance
+ * to that sphere (a lower bound, safe to step by) instead of evaluating
+ */
+class SdfNode {
+	SdfNode(const SdfNode &);
+	SdfNode &operator=(const SdfNode &);
+protected:
+	Vector3 bound_c;
+	double  bound_r;  // SDF_UNBOUNDED for infinite surfaces
+public:
+	SdfNode() : bound_c(), bound_r(SDF_UNBOUNDED) {}
+	virtual ~SdfNode() {}
+
+	virtual double eval(const Vector3 &p) const = 0;
+
+	// surface albedo at (or near) p
+	virtual double albedo(const Vector3 &) const { return 1.0; }
+
+	// recompute bounds after parameters changed, children first
+	virtual void refit() {}
+
+	const Vector3 &bound_center() const { return bound_c; }
+	double bound_radius() const { return bound_r; }
+
+	double eval_bounded(const Vector3 &p) const {
+		if (bound_r < SDF_UNBOUNDED) {
+			const double outside = (p - bound_c).length() - bound_r;
+			if (outside > SDF_CULL_MARGIN) return outside;
+		}
+		return eval(p);
+	}
+};
+
+class SdfSphere : public SdfNode {
+public:
+	Vector3 center;
+	double r;
+
+	SdfSphere(const Vector3 &c, double rr) : center(c), r(rr) { refit(); }
+
+	double eval(const Vector3 &p) const {
+		return (p - center).length() - r;
+	}
+
+	void refit() {
+		bound_c = center;
+		bound_r = r;
+	}
+};
+
+class SdfBox : public SdfNode {
+public:
+	Vector3 center;
+	Vector3 half;  // half extents
+
+	SdfBox(const Vector3 &c, const Vector3 &h) : center(c), half(h) { refit(); }
+
+	double eval(const Vector3 &p) const {
+		const Vector3 q(
+			std::fabs(p.x - center.x) - half.x,
+			std::fabs(p.y - center.y) - half.y,
+			std::fabs(p.z - center.z) - half.z
+		);
+		const Vector3 outside(std::max(q.x, 0.0), std::max(q.y, 0.0), std::max(q.z, 0.0));
+		return outside.length() + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0);
+	}
+
+	void refit() {
+		bound_c = center;
+		bound_r = half.length();
+	}
+};
+
+// ring in the XZ plane
+class SdfTorus : public SdfNode {
+public:
+	Vector3 center;
+	double major, minor;
+
+	SdfTorus(const Vector3 &c, double R, double rr) : center(c), major(R), minor(rr) { refit(); }
+
+	double eval(const Vector3 &p) const {
+		const Vector3 d = p - center;
+		const double qx = std::sqrt(d.x * d.x + d.z * d.z) - major;
+		return std::sqrt(qx * qx + d.y * d.y) - minor;
+	}
+
+	void refit() {
+		bound_c = center;
+		bound_r = major + minor;
+	}
+};
+
+// plane through the point `normal * offset`, optionally checkered
+class SdfPlane : public SdfNode {
+public:
+	Vector3 normal;  // unit
+	double offset;
+	bool checkered;
+
+	SdfPlane(const Vector3 &n, double off, bool checker = false)
+		: normal(!n), offset(off), checkered(checker) {}
+
+	double eval(const Vector3 &p) const {
+		return (p ^ normal) - offset;
+	}
+
+	double albedo(const Vector3 &p) const {
+		return checkered ? checker_albedo(p.x, p.z) : 1.0;
+	}
+};
+
+/*
+ * Plain union of any number of children, owns them
+ */
+class SdfUnion : public SdfNode {
+	std::vector<SdfNode*> children;
+public:
+	SdfUnion() {}
+
+	~SdfUnion() {
+		for (size_t i = 0; i < children.size(); ++i) delete children[i];
+	}
+
+	SdfNode *add(SdfNode *child) {
+		children.push_back(child);
+		refit_self();
+		return child;
+	}
+
+	double eval(const Vector3 &p) const {
+		double d = SDF_UNBOUNDED;
+		for (size_t i = 0; i < children.size(); ++i) {
+			d = std::min(d, children[i]->eval_bounded(p));
+		}
+		return d;
+	}
+
+	double albedo(const Vector3 &p) const {
+		const SdfNode *best = NULL;
+		double best_d = SDF_UNBOUNDED;
+		for (size_t i = 0; i < children.size(); ++i) {
+			const double d = children[i]->eval_bounded(p);
+			if (!best || d < best_d) {
+				best = children[i];
+				best_d = d;
+			}
+		}
+		return best ? best->albedo(p) : 1.0;
+	}
+
+	void refit() {
+		for (size_t i = 0; i < children.size(); ++i) children[i]->refit();
+		refit_self();
+	}
+
+private:
+	void refit_self() {
+		bound_c = Vector3();
+		bound_r = children.empty() ? 0.0 : SDF_UNBOUNDED;
+		if (children.empty()) return;
+
+		for (size_t i = 0; i < children.size(); ++i) {
+			if (children[i]->bound_radius() >= SDF_UNBOUNDED) return;
+			bound_c = bound_c + children[i]->bound_center();
+		}
+		bound_c = bound_c / (double)children.size();
+
+		double r = 0.0;
+		for (size_t i = 0; i < children.size(); ++i) {
+			const SdfNode *c = children[i];
+			r = std::max(r, (c->bound_center() - bound_c).length() + c->bound_radius());
+		}
+		bound_r = r;
+	}
+};
+
+/*
+ * Base for two-child operators, owns both
+ */
+class SdfBinary : public SdfNode {
+protected:
+	SdfNode *a;
+	SdfNode *b;
+
+	virtual void refit_self() = 0;
+public:
+	SdfBinary(SdfNode *lhs, SdfNode *rhs) : a(lhs), b(rhs) {}
+
+	~SdfBinary() {
+		delete a;
+		delete b;
+	}
+
+	double albedo(const Vector3 &p) const {
+		return a->eval_bounded(p) <= b->eval_bounded(p) ? a->albedo(p) : b->albedo(p);
+	}
+
+	void refit() {
+		a->refit();
+		b->refit();
+		refit_self();
+	}
+
+protected:
+	// sphere around both children, grown by `extra`
+	void enclose(double extra) {
+		const double ra = a->bound_radius(), rb = b->bound_radius();
+		if (ra >= SDF_UNBOUNDED || rb >= SDF_UNBOUNDED) {
+			bound_r = SDF_UNBOUNDED;
+			return;
+		}
+
+		const Vector3 ab = b->bound_center() - a->bound_center();
+		const double dist = ab.length();
+		if (dist + rb <= ra) {
+			bound_c = a->bound_center();
+			bound_r = ra + extra;
+		} else if (dist + ra <= rb) {
+			bound_c = b->bound_center();
+			bound_r = rb + extra;
+		} else {
+			const double r = 0.5 * (dist + ra + rb);
+			bound_c = a->bound_center() + ab * ((r - ra) / dist);
+			bound_r = r + extra;
+		}
+	}
+};
+
+// polynomial smooth minimum, blends surfaces within `k` of each other
+class SdfSmoothUnion : public SdfBinary {
+public:
+	double k;
+
+	SdfSmoothUnion(SdfNode *lhs, SdfNode *rhs, double kk) : SdfBinary(lhs, rhs), k(kk) { refit_self(); }
+
+	double eval(const Vector3 &p) const {
+		const double da = a->eval_bounded(p);
+		const double db = b->eval_bounded(p);
+		if (k <= 0.0) return std::min(da, db);
+
+		double h = 0.5 + 0.5 * (db - da) / k;
+		h = h < 0.0 ? 0.0 : (h > 1.0 ? 1.0 : h);
+		return db + (da - db) * h - k * h * (1.0 - h);
+	}
+
+protected:
+	// the blend never reaches further than k/4 out of the plain union
+	void refit_self() { enclose(0.25 * k); }
+};
+
+// a with b carved out
+class SdfSubtract : public SdfBinary {
+public:
+	SdfSubtract(SdfNode *lhs, SdfNode *rhs) : SdfBinary(lhs, rhs) { refit_self(); }
+
+	double eval(const Vector3 &p) const {
+		const double da = a->eval_bounded(p);
+		// a lower bound of b would overestimate here, so b is only skipped
+		// when a alone already is a lower bound of the result
+		if (a->bound_radius() < SDF_UNBOUNDED && (p - a->bound_center()).length() - a->bound_radius() > SDF_CULL_MARGIN) {
+			return da;
+		}
+		return std::max(da, -b->eval(p));
+	}
+
+	double albedo(const Vector3 &p) const {
+		return a->albedo(p);
+	}
+
+protected:
+	void refit_self() {
+		bound_c = a->bound_center();
+		bound_r = a->bound_radius();
+	}
+};
+
+class SdfIntersect : public SdfBinary {
+public:
+	SdfIntersect(SdfNode *lhs, SdfNode *rhs) : SdfBinary(lhs, rhs) { refit_self(); }
+
+	double eval(const Vector3 &p) const {
+		return std::max(a->eval_bounded(p), b->eval_bounded(p));
+	}
+
+protected:
+	void refit_self() {
+		const SdfNode *small = a->bound_radius() <= b->bound_radius() ? a : b;
+		bound_c = small->bound_center();
+		bound_r = small->bound_radius();
+	}
+};
+
+/*
+ * Rotation about a unit axis, uniform scale, then translation
+ */
+class SdfTransform : public SdfNode {
+	SdfNode *child;
+	Vector3 rows[3];  // rotation matrix
+
+	SdfTransform(const SdfTransform &);
+	SdfTransform &operator=(const SdfTransform &);
+public:
+	Vector3 offset;
+	double scale;
+
+	SdfTransform(SdfNode *node, const Vector3 &off, const Vector3 &axis, double angle, double s = 1.0)
+			: child(node), offset(off), scale(s) {
+		set_rotation(axis, angle);
+	}
+
+	~SdfTransform() {
+		delete child;
+	}
+
+	void set_rotation(const Vector3 &axis, double angle) {
+		const Vector3 u = !axis;
+		const double c = std::cos(angle), s = std::sin(angle), t = 1.0 - c;
+		rows[0] = Vector3(t * u.x * u.x + c,       t * u.x * u.y - s * u.z, t * u.x * u.z + s * u.y);
+		rows[1] = Vector3(t * u.x * u.y + s * u.z, t * u.y * u.y + c,       t * u.y * u.z - s * u.x);
+		rows[2] = Vector3(t * u.x * u.z - s * u.y, t * u.y * u.z + s * u.x, t * u.z * u.z + c);
+		refit_self();
+	}
+
+	Vector3 to_local(const Vector3 &p) const {
+		const Vector3 q = p - offset;
+		// inverse rotation is the transpose
+		return (rows[0] * q.x + rows[1] * q.y + rows[2] * q.z) / scale;
+	}
+
+	Vector3 to_world(const Vector3 &p) const {
+		return Vector3(rows[0] ^ p, rows[1] ^ p, rows[2] ^ p) * scale + offset;
+	}
+
+	double eval(const Vector3 &p) const {
+		return child->eval_bounded(to_local(p)) * scale;
+	}
+
+	double albedo(const Vector3 &p) const {
+		return child->albedo(to_local(p));
+	}
+
+	void refit() {
+		child->refit();
+		refit_self();
+	}
+
+private:
+	void refit_self() {
+		if (child->bound_radius() >= SDF_UNBOUNDED) {
+			bound_r = SDF_UNBOUNDED;
+			return;
+		}
+		bound_c = to_world(child->bound_center());
+		bound_r = child->bound_radius() * scale;
+	}
+};
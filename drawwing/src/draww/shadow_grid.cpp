@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cmath>
+
+#include "shadow_grid.hpp"
+
+static const double PI = 3.14159265358979323846;
+
+// extra cone half-angle, covers rounding between binning and lookup
+static const double CONE_MARGIN = 1e-6;
+
+static inline double clamp_unit(double x) {
+	return x < -1.0 ? -1.0 : (x > 1.0 ? 1.0 : x);
+}
+
+ShadowGrid::CellRange ShadowGrid::cap_cells(const Vector3 &axis, double half_angle) const {
+	CellRange cr = { 0, n_polar - 1, 0, n_azim - 1 };
+
+	const double polar = std::acos(clamp_unit(axis.y));
+	const double lo = polar - half_angle, hi = polar + half_angle;
+	if (lo > 0.0) cr.p0 = std::min(n_polar - 1, (int)std::floor(lo / PI * n_polar));
+	if (hi < PI)  cr.p1 = std::min(n_polar - 1, (int)std::floor(hi / PI * n_polar));
+
+	// caps over a pole take every azimuth
+	if (lo <= 0.0 || hi >= PI) return cr;
+
+	const double s = std::sin(half_angle) / std::sin(polar);
+	if (s >= 1.0) return cr;
+
+	const double spread = std::asin(s);
+	const double azim = std::atan2(axis.z, axis.x);
+	const int a0 = (int)std::floor((azim - spread + PI) / (2.0 * PI) * n_azim);
+	const int a1 = (int)std::floor((azim + spread + PI) / (2.0 * PI) * n_azim);
+	if (a1 - a0 + 1 >= n_azim) return cr;
+
+	cr.a0 = a0;
+	cr.a1 = a1;
+	return cr;
+}
+
+void ShadowGrid::build(const Vector3 &light_pos, const std::vector<Sphere> &spheres, double reach) {
+	light = light_pos;
+
+	// about as many cells as spheres times eight
+	n_polar = std::max(8, std::min(128, 2 * (int)std::sqrt((double)spheres.size())));
+	n_azim  = 2 * n_polar;
+	const int n_cells = n_polar * n_azim;
+
+	ranges.resize(spheres.size());
+	for (size_t i = 0; i < spheres.size(); ++i) {
+		const Vector3 to_center = spheres[i].pos - light;
+		const double dist = to_center.length();
+		const double sin_half = reach * spheres[i].radius / dist;
+
+		if (!(sin_half < 1.0)) {
+			// the light is inside the penumbra, every direction is shaded
+			const CellRange all = { 0, n_polar - 1, 0, n_azim - 1 };
+			ranges[i] = all;
+		} else {
+			ranges[i] = cap_cells(to_center / dist, std::asin(sin_half) + CONE_MARGIN);
+		}
+	}
+
+	// counting sort of (sphere, cell) pairs by cell, spheres stay in order
+	cell_start.assign(n_cells + 1, 0);
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		const CellRange &cr = ranges[i];
+		for (int p = cr.p0; p <= cr.p1; ++p) {
+			for (int a = cr.a0; a <= cr.a1; ++a) {
+				++cell_start[p * n_azim + (a % n_azim + n_azim) % n_azim + 1];
+			}
+		}
+	}
+	for (int c = 0; c < n_cells; ++c) cell_start[c + 1] += cell_start[c];
+
+	items.resize(cell_start[n_cells]);
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		const CellRange &cr = ranges[i];
+		for (int p = cr.p0; p <= cr.p1; ++p) {
+			for (int a = cr.a0; a <= cr.a1; ++a) {
+				items[cell_start[p * n_azim + (a % n_azim + n_azim) % n_azim]++] = (unsigned)i;
+			}
+		}
+	}
+
+	// filling advanced every start to the next cell's, shift them back
+	for (int c = n_cells; c > 0; --c) cell_start[c] = cell_start[c - 1];
+	cell_start[0] = 0;
+}
+
+const unsigned *ShadowGrid::lookup(const Vector3 &dir, size_t *n) const {
+	*n = 0;
+	if (items.empty()) return NULL;
+
+	const double polar = std::acos(clamp_unit(dir.y));
+	const double azim  = std::atan2(dir.z, dir.x);
+	const int p = std::min(n_polar - 1, (int)std::floor(polar / PI * n_polar));
+	const int a = std::max(0, std::min(n_azim - 1, (int)std::floor((azim + PI) / (2.0 * PI) * n_azim)));
+
+	const int cell = p * n_azim + a;
+	*n = cell_start[cell + 1] - cell_start[cell];
+	return &items[0] + cell_start[cell];
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+
+#include "linalg.hpp"
+
+/*
+ * Spheres binned by the directions they can shade as seen from one light.
+ * The sphere of directions is cut into a polar x azimuth grid; every cell
+ * lists, in index order, the spheres whose penumbra cone overlaps it, so
+ * a shadow segment only visits the list of the cell it leaves the light by
+ */
+class ShadowGrid {
+	struct CellRange {
+		int p0, p1;  // polar rows, inclusive
+		int a0, a1;  // azimuth columns, inclusive, may wrap past n_azim
+	};
+
+	int n_polar, n_azim;
+	std::vector<unsigned> cell_start;  // n_polar * n_azim + 1 offsets into items
+	std::vector<unsigned> items;
+	std::vector<CellRange> ranges;     // scratch, per sphere
+
+	CellRange cap_cells(const Vector3 &axis, double half_angle) const;
+public:
+	Vector3 light;
+
+	ShadowGrid() : n_polar(0), n_azim(0) {}
+
+	// reach: how many radii out from its center a sphere still darkens
+	void build(const Vector3 &light_pos, const std::vector<Sphere> &spheres, double reach);
+
+	// spheres that may shade a segment leaving the light along unit `dir`
+	const unsigned *lookup(const Vector3 &dir, size_t *n) const;
+};
@@ -0,0 +1,180 @@
+#include <SDL3/SDL.h>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "sphere_pack.hpp"
+
+// relative slack on every float test, far above float rounding
+static const float SLACK = 1e-4f;
+
+static const float PAD_FAR = 1e18f;
+
+void SpherePack::pack(const std::vector<Sphere> &spheres) {
+	count = spheres.size();
+	const size_t padded = (count + SPHERE_LANES - 1) / SPHERE_LANES * SPHERE_LANES;
+
+	x.resize(padded);
+	y.resize(padded);
+	z.resize(padded);
+	r.resize(padded);
+
+	for (size_t i = 0; i < count; ++i) {
+		x[i] = (float)spheres[i].pos.x;
+		y[i] = (float)spheres[i].pos.y;
+		z[i] = (float)spheres[i].pos.z;
+		r[i] = (float)spheres[i].radius;
+	}
+	for (size_t i = count; i < padded; ++i) {
+		x[i] = y[i] = z[i] = PAD_FAR;
+		r[i] = 0.0f;
+	}
+}
+
+static size_t ray_filter_scalar(const SpherePack &pack, const SphereQuery &q, size_t *cursor, unsigned *out) {
+	const float mag2 = q.mag * q.mag;
+	size_t n = 0, i = *cursor;
+
+	for (; i < pack.size() && n < SPHERE_CANDIDATES; ++i) {
+		const float ocx = q.ox - pack.x[i], ocy = q.oy - pack.y[i], ocz = q.oz - pack.z[i];
+		const float b = ocx * q.dx + ocy * q.dy + ocz * q.dz;
+		const float oc2 = ocx * ocx + ocy * ocy + ocz * ocz;
+		const float disc = b * b - (oc2 - pack.r[i] * pack.r[i]);
+		const float tol = SLACK * (b * b + oc2 + mag2) + SLACK;
+		if (disc >= -tol) out[n++] = (unsigned)i;
+	}
+
+	*cursor = i;
+	return n;
+}
+
+static size_t segment_filter_scalar(const SpherePack &pack, const SphereQuery &q, size_t *cursor, unsigned *out) {
+	const float mag2 = q.mag * q.mag;
+	size_t n = 0, i = *cursor;
+
+	for (; i < pack.size() && n < SPHERE_CANDIDATES; ++i) {
+		const float ocx = pack.x[i] - q.ox, ocy = pack.y[i] - q.oy, ocz = pack.z[i] - q.oz;
+		const float t = ocx * q.dx + ocy * q.dy + ocz * q.dz;
+		const float oc2 = ocx * ocx + ocy * ocy + ocz * ocz;
+		const float reach = SPHERE_PENUMBRA_REACH * pack.r[i];
+
+		const float tol_t = SLACK * (std::fabs(ocx) + std::fabs(ocy) + std::fabs(ocz) + q.mag);
+		if (t <= -tol_t || t >= q.len + tol_t) continue;
+
+		const float tol_d = SLACK * (oc2 + mag2) + SLACK;
+		if (oc2 - t * t <= reach * reach + tol_d) out[n++] = (unsigned)i;
+	}
+
+	*cursor = i;
+	return n;
+}
+
+static const SphereKernels KERNELS_SCALAR = { "scalar", ray_filter_scalar, segment_filter_scalar };
+
+#if defined(__SSE2__)
+
+static size_t ray_filter_sse2(const SpherePack &pack, const SphereQuery &q, size_t *cursor, unsigned *out) {
+	const __m128 ox = _mm_set1_ps(q.ox), oy = _mm_set1_ps(q.oy), oz = _mm_set1_ps(q.oz);
+	const __m128 dx = _mm_set1_ps(q.dx), dy = _mm_set1_ps(q.dy), dz = _mm_set1_ps(q.dz);
+	const __m128 mag2 = _mm_set1_ps(q.mag * q.mag);
+	const __m128 slack = _mm_set1_ps(SLACK);
+
+	const size_t size = pack.size();
+	if (!size) return 0;
+	const float *px = &pack.x[0], *py = &pack.y[0], *pz = &pack.z[0], *pr = &pack.r[0];
+
+	size_t n = 0, i = *cursor;
+	for (; i < size && n + 4 <= SPHERE_CANDIDATES; i += 4) {
+		const __m128 ocx = _mm_sub_ps(ox, _mm_loadu_ps(px + i));
+		const __m128 ocy = _mm_sub_ps(oy, _mm_loadu_ps(py + i));
+		const __m128 ocz = _mm_sub_ps(oz, _mm_loadu_ps(pz + i));
+		const __m128 r   = _mm_loadu_ps(pr + i);
+
+		const __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+		const __m128 oc2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz));
+		const __m128 bb = _mm_mul_ps(b, b);
+		const __m128 disc = _mm_sub_ps(bb, _mm_sub_ps(oc2, _mm_mul_ps(r, r)));
+		const __m128 tol = _mm_add_ps(_mm_mul_ps(slack, _mm_add_ps(_mm_add_ps(bb, oc2), mag2)), slack);
+
+		int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(disc, tol), _mm_setzero_ps()));
+		while (mask) {
+			out[n++] = (unsigned)(i + __builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+
+	*cursor = i;
+	return n;
+}
+
+static size_t segment_filter_sse2(const SpherePack &pack, const SphereQuery &q, size_t *cursor, unsigned *out) {
+	const __m128 ox = _mm_set1_ps(q.ox), oy = _mm_set1_ps(q.oy), oz = _mm_set1_ps(q.oz);
+	const __m128 dx = _mm_set1_ps(q.dx), dy = _mm_set1_ps(q.dy), dz = _mm_set1_ps(q.dz);
+	const __m128 len = _mm_set1_ps(q.len), mag = _mm_set1_ps(q.mag);
+	const __m128 mag2 = _mm_set1_ps(q.mag * q.mag);
+	const __m128 slack = _mm_set1_ps(SLACK);
+	const __m128 reach_k = _mm_set1_ps(SPHERE_PENUMBRA_REACH);
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	const size_t size = pack.size();
+	if (!size) return 0;
+	const float *px = &pack.x[0], *py = &pack.y[0], *pz = &pack.z[0], *pr = &pack.r[0];
+
+	size_t n = 0, i = *cursor;
+	for (; i < size && n + 4 <= SPHERE_CANDIDATES; i += 4) {
+		const __m128 ocx = _mm_sub_ps(_mm_loadu_ps(px + i), ox);
+		const __m128 ocy = _mm_sub_ps(_mm_loadu_ps(py + i), oy);
+		const __m128 ocz = _mm_sub_ps(_mm_loadu_ps(pz + i), oz);
+		const __m128 reach = _mm_mul_ps(reach_k, _mm_loadu_ps(pr + i));
+
+		const __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+		const __m128 oc2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz));
+
+		const __m128 oc_l1 = _mm_add_ps(_mm_add_ps(_mm_and_ps(ocx, abs_mask), _mm_and_ps(ocy, abs_mask)), _mm_and_ps(ocz, abs_mask));
+		const __m128 tol_t = _mm_mul_ps(slack, _mm_add_ps(oc_l1, mag));
+		const __m128 in_seg = _mm_and_ps(
+			_mm_cmpgt_ps(_mm_add_ps(t, tol_t), _mm_setzero_ps()),
+			_mm_cmplt_ps(t, _mm_add_ps(len, tol_t))
+		);
+
+		const __m128 tol_d = _mm_add_ps(_mm_mul_ps(slack, _mm_add_ps(oc2, mag2)), slack);
+		const __m128 near = _mm_cmple_ps(
+			_mm_sub_ps(oc2, _mm_mul_ps(t, t)),
+			_mm_add_ps(_mm_mul_ps(reach, reach), tol_d)
+		);
+
+		int mask = _mm_movemask_ps(_mm_and_ps(in_seg, near));
+		while (mask) {
+			out[n++] = (unsigned)(i + __builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+
+	*cursor = i;
+	return n;
+}
+
+static const SphereKernels KERNELS_SSE2 = { "sse2", ray_filter_sse2, segment_filter_sse2 };
+
+#endif
+
+static const SphereKernels *pick_kernels() {
+	const char *cap = SDL_getenv("DRAWW_SIMD");
+	if (cap && std::strcmp(cap, "scalar") == 0) return &KERNELS_SCALAR;
+
+	const SphereKernels *avx2 = sphere_kernels_avx2();
+	if (avx2 && SDL_HasAVX2() && !(cap && std::strcmp(cap, "sse2") == 0)) return avx2;
+
+#if defined(__SSE2__)
+	if (SDL_HasSSE2()) return &KERNELS_SSE2;
+#endif
+
+	return &KERNELS_SCALAR;
+}
+
+const SphereKernels *sphere_kernels() {
+	static const SphereKernels *picked = pick_kernels();
+	return picked;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cmath>
+#include <vector>
+
+#include "linalg.hpp"
+
+// padding unit of SpherePack, the widest kernel's lane count
+static const size_t SPHERE_LANES = 8;
+
+// candidate indices a filter call may hand back at once
+static const size_t SPHERE_CANDIDATES = 64;
+
+/*
+ * Scene spheres repacked as float columns for the SIMD filters.
+ * Padded with far away zero radius spheres up to a multiple of
+ * SPHERE_LANES; indices at or past `count` are padding
+ */
+class SpherePack {
+public:
+	std::vector<float> x, y, z, r;
+	size_t count;
+
+	SpherePack() : count(0) {}
+
+	void pack(const std::vector<Sphere> &spheres);
+
+	size_t size() const { return x.size(); }
+};
+
+// a ray or segment in the filters' precision
+struct SphereQuery {
+	float ox, oy, oz;  // origin
+	float dx, dy, dz;  // unit direction
+	float len;         // segment length, 0 for plain rays
+	float mag;         // coordinate magnitude around the query, scales the slack
+};
+
+static inline SphereQuery sphere_query(const Vector3 &origin, const Vector3 &dir, double len) {
+	SphereQuery q;
+	q.ox = (float)origin.x;
+	q.oy = (float)origin.y;
+	q.oz = (float)origin.z;
+	q.dx = (float)dir.x;
+	q.dy = (float)dir.y;
+	q.dz = (float)dir.z;
+	q.len = (float)len;
+	q.mag = (float)(std::fabs(origin.x) + std::fabs(origin.y) + std::fabs(origin.z) + len + 1.0);
+	return q;
+}
+
+/*
+ * A filter scans the pack from *cursor on and writes the indices of
+ * spheres that may pass the exact test into `out` (ascending, at most
+ * SPHERE_CANDIDATES). It returns early when `out` fills up, so callers
+ * loop until *cursor reaches pack.size(). Rejection is conservative:
+ * float rounding only ever lets extra spheres through
+ */
+typedef size_t (*SphereFilterFn)(const SpherePack &pack, const SphereQuery &q, size_t *cursor, unsigned *out);
+
+struct SphereKernels {
+	const char *name;
+
+	// spheres the ray's line may cross
+	SphereFilterFn ray;
+
+	// spheres whose center projects inside the segment and that lie
+	// within SPHERE_PENUMBRA_REACH radii of it
+	SphereFilterFn segment;
+};
+
+// penumbra width is 0.3 radius, so nothing past 1.3 radius darkens
+static const float SPHERE_PENUMBRA_REACH = 1.3f;
+
+// the best the CPU runs; DRAWW_SIMD=scalar|sse2|avx2 caps the choice
+const SphereKernels *sphere_kernels();
+
+// NULL when the build has no AVX2 code
+const SphereKernels *sphere_kernels_avx2();
@@ -0,0 +1,110 @@
+// only these functions are built for AVX2, and only called after SDL_HasAVX2()
+#include "sphere_pack.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+static const float SLACK = 1e-4f;  // same as the SSE2 and scalar filters
+
+TARGET_AVX2
+static size_t ray_filter_avx2(const SpherePack &pack, const SphereQuery &q, size_t *cursor, unsigned *out) {
+	const __m256 ox = _mm256_set1_ps(q.ox), oy = _mm256_set1_ps(q.oy), oz = _mm256_set1_ps(q.oz);
+	const __m256 dx = _mm256_set1_ps(q.dx), dy = _mm256_set1_ps(q.dy), dz = _mm256_set1_ps(q.dz);
+	const __m256 mag2 = _mm256_set1_ps(q.mag * q.mag);
+	const __m256 slack = _mm256_set1_ps(SLACK);
+
+	const size_t size = pack.size();
+	if (!size) return 0;
+	const float *px = &pack.x[0], *py = &pack.y[0], *pz = &pack.z[0], *pr = &pack.r[0];
+
+	size_t n = 0, i = *cursor;
+	for (; i < size && n + 8 <= SPHERE_CANDIDATES; i += 8) {
+		const __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(px + i));
+		const __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(py + i));
+		const __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(pz + i));
+		const __m256 r   = _mm256_loadu_ps(pr + i);
+
+		const __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+		const __m256 oc2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz));
+		const __m256 bb = _mm256_mul_ps(b, b);
+		const __m256 disc = _mm256_sub_ps(bb, _mm256_sub_ps(oc2, _mm256_mul_ps(r, r)));
+		const __m256 tol = _mm256_add_ps(_mm256_mul_ps(slack, _mm256_add_ps(_mm256_add_ps(bb, oc2), mag2)), slack);
+
+		int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(disc, tol), _mm256_setzero_ps(), _CMP_GE_OQ));
+		while (mask) {
+			out[n++] = (unsigned)(i + __builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+
+	*cursor = i;
+	return n;
+}
+
+TARGET_AVX2
+static size_t segment_filter_avx2(const SpherePack &pack, const SphereQuery &q, size_t *cursor, unsigned *out) {
+	const __m256 ox = _mm256_set1_ps(q.ox), oy = _mm256_set1_ps(q.oy), oz = _mm256_set1_ps(q.oz);
+	const __m256 dx = _mm256_set1_ps(q.dx), dy = _mm256_set1_ps(q.dy), dz = _mm256_set1_ps(q.dz);
+	const __m256 len = _mm256_set1_ps(q.len), mag = _mm256_set1_ps(q.mag);
+	const __m256 mag2 = _mm256_set1_ps(q.mag * q.mag);
+	const __m256 slack = _mm256_set1_ps(SLACK);
+	const __m256 reach_k = _mm256_set1_ps(SPHERE_PENUMBRA_REACH);
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+	const size_t size = pack.size();
+	if (!size) return 0;
+	const float *px = &pack.x[0], *py = &pack.y[0], *pz = &pack.z[0], *pr = &pack.r[0];
+
+	size_t n = 0, i = *cursor;
+	for (; i < size && n + 8 <= SPHERE_CANDIDATES; i += 8) {
+		const __m256 ocx = _mm256_sub_ps(_mm256_loadu_ps(px + i), ox);
+		const __m256 ocy = _mm256_sub_ps(_mm256_loadu_ps(py + i), oy);
+		const __m256 ocz = _mm256_sub_ps(_mm256_loadu_ps(pz + i), oz);
+		const __m256 reach = _mm256_mul_ps(reach_k, _mm256_loadu_ps(pr + i));
+
+		const __m256 t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+		const __m256 oc2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz));
+
+		const __m256 oc_l1 = _mm256_add_ps(
+			_mm256_add_ps(_mm256_and_ps(ocx, abs_mask), _mm256_and_ps(ocy, abs_mask)),
+			_mm256_and_ps(ocz, abs_mask)
+		);
+		const __m256 tol_t = _mm256_mul_ps(slack, _mm256_add_ps(oc_l1, mag));
+		const __m256 in_seg = _mm256_and_ps(
+			_mm256_cmp_ps(_mm256_add_ps(t, tol_t), _mm256_setzero_ps(), _CMP_GT_OQ),
+			_mm256_cmp_ps(t, _mm256_add_ps(len, tol_t), _CMP_LT_OQ)
+		);
+
+		const __m256 tol_d = _mm256_add_ps(_mm256_mul_ps(slack, _mm256_add_ps(oc2, mag2)), slack);
+		const __m256 near = _mm256_cmp_ps(
+			_mm256_sub_ps(oc2, _mm256_mul_ps(t, t)),
+			_mm256_add_ps(_mm256_mul_ps(reach, reach), tol_d),
+			_CMP_LE_OQ
+		);
+
+		int mask = _mm256_movemask_ps(_mm256_and_ps(in_seg, near));
+		while (mask) {
+			out[n++] = (unsigned)(i + __builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+
+	*cursor = i;
+	return n;
+}
+
+static const SphereKernels KERNELS_AVX2 = { "avx2", ray_filter_avx2, segment_filter_avx2 };
+
+const SphereKernels *sphere_kernels_avx2() {
+	return &KERNELS_AVX2;
+}
+
+#else
+
+const SphereKernels *sphere_kernels_avx2() {
+	return NULL;
+}
+
+#endif
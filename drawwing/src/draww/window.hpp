@@ -6,12 +6,14 @@
 #include "axes.hpp"
 #include "linalg.hpp"
 #include "pixel_buffer.hpp"
+#include "render_pool.hpp"
 #include "scene.hpp"
 
 class DrawWindow {
 	SDL_Window *window;
 	SDL_Renderer *renderer;
 	PixelBuffer *pb;
+	RenderPool *pool;  // shared by all scenes, they render one at a time
 public:
 	std::vector<Scene*> scenes;
 
@@ -32,6 +34,7 @@ public:
 		}
 
 		pb = new PixelBuffer(renderer, width, height);
+		pool = new RenderPool();
 		scenes = std::vector<Scene*>();
 
 		SDL_SetRenderDrawColor(renderer, CLR_BG, SDL_ALPHA_OPAQUE);
@@ -40,6 +43,9 @@ public:
 	}
 
 	~DrawWindow() {
+		// scenes hold textures, they go before the renderer
+		for (size_t i = 0; i < scenes.size(); ++i) delete scenes[i];
+		delete pool;
 		delete pb;
 		SDL_DestroyRenderer(renderer);
 		SDL_DestroyWindow(window);
@@ -47,11 +53,16 @@ public:
 	}
 
 	Scene *add_scene(CoordinateSystem *cs) {
-		Scene *scene = new Scene(cs, renderer, pb);
+		Scene *scene = new Scene(cs, renderer, pb, pool);
 		scenes.push_back(scene);
 		return scene;
 	}
 
+	// textures were lost or the window changed, everything is drawn anew
+	void invalidate() {
+		for (size_t i = 0; i < scenes.size(); ++i) scenes[i]->invalidate();
+	}
+
 	void clear() {
 		SDL_SetRenderDrawColor(renderer, CLR_BG, SDL_ALPHA_OPAQUE);
 		SDL_RenderClear(renderer);
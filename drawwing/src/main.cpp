@@ -10,9 +10,55 @@ static bool is_ev_close(const SDL_Event *event) {
 		event->type == SDL_EVENT_WINDOW_CLOSE_REQUESTED;
 }
 
+// M switches between the analytic and the raymarched renderer
+static bool is_ev_toggle_sdf(const SDL_Event *event) {
+	return event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_M;
+}
+
+// Space stops the animation, a stopped window only redraws on events
+static bool is_ev_toggle_pause(const SDL_Event *event) {
+	return event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_SPACE;
+}
+
+static bool is_ev_exposed(const SDL_Event *event) {
+	return event->type == SDL_EVENT_WINDOW_EXPOSED ||
+		event->type == SDL_EVENT_WINDOW_RESIZED ||
+		event->type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED;
+}
+
+// texture contents are gone, cached layers and pixels with them
+static bool is_ev_textures_lost(const SDL_Event *event) {
+	return event->type == SDL_EVENT_RENDER_TARGETS_RESET ||
+		event->type == SDL_EVENT_RENDER_DEVICE_RESET;
+}
+
+struct LoopState {
+	bool running;
+	bool use_sdf;
+	bool paused;
+	bool redraw;  // a frame is due even when paused
+};
+
+static void handle_event(const SDL_Event *ev, LoopState *st, DrawWindow *window) {
+	if (is_ev_close(ev)) st->running = false;
+	if (is_ev_toggle_sdf(ev)) {
+		st->use_sdf = !st->use_sdf;
+		st->redraw = true;
+	}
+	if (is_ev_toggle_pause(ev)) {
+		st->paused = !st->paused;
+		st->redraw = true;
+	}
+	if (is_ev_exposed(ev)) st->redraw = true;
+	if (is_ev_textures_lost(ev)) {
+		window->invalidate();
+		st->redraw = true;
+	}
+}
+
 int main() {
 	SDL_Event ev;
-	bool running = true;
+	LoopState st = { true, false, false, true };
 
 	Axis x_axis_sphere = { 360, 30 };
 	Axis y_axis_sphere = { 320, 30 };
@@ -59,9 +105,43 @@ int main() {
 	scene_sph->spheres.push_back(sph3);
 	scene_sph->light_sources.push_back(light);
 
+	// same spheres as signed distances, plus a CSG piece only the marcher can draw
+	SdfUnion *sdf_world = new SdfUnion();
+	sdf_world->add(new SdfPlane(Vector3(0, 1, 0), FLOOR_Y, true));
+	sdf_world->add(new SdfSphere(origin1, 7));
+	sdf_world->add(new SdfSphere(origin2, 2));
+	sdf_world->add(new SdfSphere(origin3, 4));
+
+	SdfTransform *csg = new SdfTransform(
+		new SdfSubtract(
+			new SdfSmoothUnion(
+				new SdfBox(Vector3(0, 0, 0), Vector3(2, 2, 2)),
+				new SdfTorus(Vector3(0, 2, 0), 2.5, 0.6),
+				1.0
+			),
+			new SdfSphere(Vector3(0, 0, 0), 2.6)
+		),
+		Vector3(9, -4, -6), Vector3(1, 1, 0), 0.0
+	);
+	sdf_world->add(csg);
+	scene_sph->sdf = sdf_world;
+
+	double csg_angle = 0.0;
+
 	Uint64 next_frame = SDL_GetTicksNS();
 
-	while (running) {
+	while (st.running) {
+		if (st.paused && !st.redraw) {
+			// nothing moves, sleep until an event asks for a frame
+			if (SDL_WaitEvent(&ev)) {
+				do {
+					handle_event(&ev, &st, window);
+				} while (st.running && SDL_PollEvent(&ev));
+			}
+			next_frame = SDL_GetTicksNS();
+			continue;
+		}
+
 		// FPS cap
 		for (;;) {
 			Uint64 now = SDL_GetTicksNS();
@@ -73,40 +153,52 @@ int main() {
 
 			if (SDL_WaitEventTimeout(&ev, timeout_ms)) {
 				do {
-					if (is_ev_close(&ev)) {
-						running = false;
-						break;
-					}
-				} while (running && SDL_PollEvent(&ev));
+					handle_event(&ev, &st, window);
+				} while (st.running && SDL_PollEvent(&ev));
 			}
-			if (!running) break;
+			if (!st.running) break;
 		}
-		if (!running) break;
+		if (!st.running) break;
 
-		while (SDL_PollEvent(&ev))
-			if (is_ev_close(&ev))
-				running = false;
+		while (SDL_PollEvent(&ev)) handle_event(&ev, &st, window);
 
-		if (!running) break;
+		if (!st.running) break;
 
 		// Rendering
 
 		scene_sph->blit_bg(CLR_VOID);
-		scene_sph->render_with_ambient_diffusion_and_specular_light(&camera);
+		if (st.use_sdf) {
+			if (!st.paused) {
+				csg->set_rotation(Vector3(1, 1, 0), csg_angle);
+				csg_angle += M_PI / 120;
+				scene_sph->invalidate();  // the sdf graph isn't tracked
+			}
+			scene_sph->render_sdf(&camera);
+		} else {
+			scene_sph->render_with_ambient_diffusion_and_specular_light(&camera);
+		}
 		scene_sph->blit_light_sources(&camera, 6, true);
 		scene_sph->blit_axes_3d(&camera, 6.0);
 
-		//scene_sph->light_sources[0].rotate_xz(M_PI / 96);
-		camera.dir.rotate_xz(M_PI / 96);
-		camera.pos.rotate_xz(M_PI / 96);
-
-		scene_plane->blit_bg(CLR_WHITE);
-		scene_plane->blit_grid();
-		scene_plane->blit_axes();
+		// grid and axes never move, they are drawn once into a layer
+		if (scene_plane->begin_static_layer()) {
+			scene_plane->blit_bg(CLR_WHITE);
+			scene_plane->blit_grid();
+			scene_plane->blit_axes();
+			scene_plane->end_static_layer();
+		}
+		scene_plane->blit_static_layer();
 		scene_plane->blit_vector(sample);
-		sample.rotate(-M_PI / 96);
+
+		if (!st.paused) {
+			//scene_sph->light_sources[0].rotate_xz(M_PI / 96);
+			camera.dir.rotate_xz(M_PI / 96);
+			camera.pos.rotate_xz(M_PI / 96);
+			sample.rotate(-M_PI / 96);
+		}
 
 		window->present();
+		st.redraw = false;
 
 		// Tick management
 		next_frame += FRAME_NS;
@@ -115,6 +207,7 @@ int main() {
 	}
 
 	delete window;
+	delete sdf_world;
 	delete cs_sphere;
 	delete cs_plane;
 	return 0;
@@ -45,7 +45,7 @@ public:
         if (objview_ || findChild<ObjectView>()) return false;
         objview_ = new ObjectView({5, 225, 250, 225}, NULL, state);
         if (auto *list = findDescendant<ObjectsList>()) {
-            if (auto *sel = list->selectedPreview()) {
+            if (auto *sel = list->selectedObject()) {
                 objview_->populate(sel);
             } else {
                 objview_->unpopulate();
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "./coordinator.hpp"
+#include "./wire.hpp"
+
+namespace farm {
+
+static const unsigned MAX_CREDITS = 256;
+static const size_t   READ_BUDGET = 1u << 20;  // bytes taken from one peer per wakeup
+static const Uint64   PEER_TIMEOUT_MS = 10000; // owing tiles with nothing moving
+static const int      PEER_CHECK_MS = 1000;
+
+Coordinator *Coordinator::listen(const std::string &addr, TileSource *source) {
+    int fd = listenOn(addr);
+    if (fd < 0) return NULL;
+
+    int wake_fds[2];
+    if (pipe(wake_fds) != 0) {
+        std::fprintf(stderr, "[farm] pipe: %s\n", std::strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    for (int i = 0; i < 2; ++i) fcntl(wake_fds[i], F_SETFL, fcntl(wake_fds[i], F_GETFL) | O_NONBLOCK);
+
+    printf("[debug] tile farm listening on %s\n", addr.c_str());
+    return new Coordinator(fd, wake_fds[0], wake_fds[1], source);
+}
+
+Coordinator::Coordinator(int listen_fd, int wake_r, int wake_w, TileSource *source)
+    : source_(source)
+    , mtx_(SDL_CreateMutex())
+    , frame_(0), scene_version_(0)
+    , width_(0), height_(0), max_depth_(0), eps_(0)
+    , stop_(false)
+    , thread_(NULL)
+    , listen_fd_(listen_fd), wake_r_(wake_r), wake_w_(wake_w)
+{
+    thread_ = SDL_CreateThread(Coordinator::threadEntry, "farm", this);
+}
+
+Coordinator::~Coordinator() {
+    SDL_LockMutex(mtx_);
+    stop_ = true;
+    SDL_UnlockMutex(mtx_);
+    wake();
+
+    if (thread_) SDL_WaitThread(thread_, NULL);
+
+    // the source may be going away too, so in-flight tiles are not given back
+    for (size_t i = 0; i < peers_.size(); ++i) close(peers_[i].fd);
+    peers_.clear();
+
+    close(listen_fd_);
+    close(wake_r_);
+    close(wake_w_);
+    SDL_DestroyMutex(mtx_);
+}
+
+void Coordinator::beginFrame(unsigned frame, const std::string &scene, int width, int height, int max_depth, double eps) {
+    SDL_LockMutex(mtx_);
+    frame_ = frame;
+    if (scene != scene_ || width != width_ || height != height_ || max_depth != max_depth_ || eps != eps_) {
+        scene_     = scene;
+        width_     = width;
+        height_    = height;
+        max_depth_ = max_depth;
+        eps_       = eps;
+        ++scene_version_;
+    }
+    SDL_UnlockMutex(mtx_);
+    wake();
+}
+
+void Coordinator::wake() {
+    const char c = 1;
+    if (write(wake_w_, &c, 1) < 0 && errno != EAGAIN) {
+        std::fprintf(stderr, "[farm] wake: %s\n", std::strerror(errno));
+    }
+}
+
+int Coordinator::threadEntry(void *self_void) {
+    static_cast<Coordinator*>(self_void)->run();
+    return 0;
+}
+
+void Coordinator::run() {
+    std::vector<pollfd> fds;
+
+    for (;;) {
+        fds.resize(2 + peers_.size());
+        fds[0].fd = listen_fd_;
+        fds[1].fd = wake_r_;
+        bool any_busy = false;
+        for (size_t i = 0; i < fds.size(); ++i) {
+            fds[i].events  = POLLIN;
+            fds[i].revents = 0;
+        }
+        for (size_t i = 0; i < peers_.size(); ++i) {
+            const Peer &peer = peers_[i];
+            fds[2 + i].fd = peer.fd;
+            if (peer.out_sent < peer.out.size()) fds[2 + i].events |= POLLOUT;
+            any_busy = any_busy || peer.busy();
+        }
+
+        if (poll(fds.data(), fds.size(), any_busy ? PEER_CHECK_MS : -1) < 0) {
+            if (errno == EINTR) continue;
+            std::fprintf(stderr, "[farm] poll: %s\n", std::strerror(errno));
+            return;
+        }
+
+        SDL_LockMutex(mtx_);
+        const bool stop = stop_;
+        SDL_UnlockMutex(mtx_);
+        if (stop) return;
+
+        // peers first: accept() below may append to peers_
+        const Uint64 now = SDL_GetTicks();
+        bool dropped = false;
+        for (size_t i = peers_.size(); i-- > 0;) {
+            Peer &peer = peers_[i];
+            const short ev = fds[2 + i].revents;
+
+            bool ok = true;
+            if (ev & (POLLIN | POLLHUP | POLLERR)) ok = receive(peer);
+            if (ok && (ev & POLLOUT)) ok = flush(peer) && dispatch(peer);
+            if (ok && peer.busy() && peer.last_progress + PEER_TIMEOUT_MS < now) {
+                std::fprintf(stderr, "[farm] render worker stalled, dropping it\n");
+                ok = false;
+            }
+            if (!ok) {
+                drop(i);
+                dropped = true;
+            }
+        }
+
+        // tiles given back by a dropped peer go to whoever has credits left
+        for (size_t i = peers_.size(); dropped && i-- > 0;) {
+            if (!dispatch(peers_[i])) drop(i);
+        }
+
+        if (fds[1].revents) {
+            char buf[64];
+            while (read(wake_r_, buf, sizeof(buf)) > 0) {}
+
+            // new frame, hand it out
+            for (size_t i = peers_.size(); i-- > 0;) {
+                if (!dispatch(peers_[i])) drop(i);
+            }
+        }
+
+        if (fds[0].revents) accept();
+    }
+}
+
+void Coordinator::accept() {
+    int fd = ::accept(listen_fd_, NULL, NULL);
+    if (fd < 0) {
+        std::fprintf(stderr, "[farm] accept: %s\n", std::strerror(errno));
+        return;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    Peer peer;
+    peer.fd            = fd;
+    peer.scene_sent    = 0;
+    peer.credits       = 0;  // nothing until it pulls
+    peer.out_sent      = 0;
+    peer.last_progress = SDL_GetTicks();
+    peers_.push_back(peer);
+    n_peers_.store(peers_.size(), std::memory_order_relaxed);
+
+    printf("[debug] render worker connected (%zu total)\n", peers_.size());
+}
+
+/**
+ * Whatever the peer has sent so far, then its next tiles if that freed
+ * credits. false if it hung up or broke the protocol
+ */
+bool Coordinator::receive(Peer &peer) {
+    uint8_t buf[16384];
+    for (size_t got = 0; got < READ_BUDGET;) {
+        const ssize_t k = recv(peer.fd, buf, sizeof(buf), 0);
+        if (k < 0 && errno == EINTR) continue;
+        if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (k <= 0) return false;
+
+        peer.in.insert(peer.in.end(), buf, buf + k);
+        peer.last_progress = SDL_GetTicks();
+        got += (size_t)k;
+    }
+
+    size_t pos = 0;
+    bool bad = false;
+    Message msg;
+    while (takeMessage(peer.in, &pos, &msg, &bad)) {
+        if (!onMessage(peer, msg)) return false;
+    }
+    if (bad) return false;
+    peer.in.erase(peer.in.begin(), peer.in.begin() + pos);
+
+    return dispatch(peer);
+}
+
+/**
+ * As much of the queued output as the socket takes now, the rest waits
+ * for POLLOUT
+ */
+bool Coordinator::flush(Peer &peer) {
+    while (peer.out_sent < peer.out.size()) {
+        const ssize_t k = send(peer.fd, peer.out.data() + peer.out_sent,
+                               peer.out.size() - peer.out_sent, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR) continue;
+        if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        if (k <= 0) return false;
+
+        peer.out_sent += (size_t)k;
+        peer.last_progress = SDL_GetTicks();
+    }
+
+    peer.out.clear();
+    peer.out_sent = 0;
+    return true;
+}
+
+bool Coordinator::onMessage(Peer &peer, const Message &msg) {
+    Reader r(msg.body);
+    switch (msg.type) {
+        case MSG_PULL: {
+            const uint32_t n = r.u32();
+            if (!r.ok()) return false;
+            peer.credits = std::min<unsigned>(peer.credits + n, MAX_CREDITS);
+            return true;
+        }
+
+        case MSG_RESULT: {
+            const unsigned frame = r.u32();
+            const int tile = (int)r.u32();
+            const int x0 = (int)r.u32(), y0 = (int)r.u32();
+            const int x1 = (int)r.u32(), y1 = (int)r.u32();
+            if (!r.ok() || x1 < x0 || y1 < y0) return false;
+
+            const size_t n_bytes = (size_t)(x1 - x0) * (size_t)(y1 - y0) * 4;
+            const uint8_t *rgba = r.bytes(n_bytes);
+            if (!rgba || r.remaining() != 0) return false;
+
+            size_t k = 0;
+            while (k < peer.in_flight.size()
+                    && (peer.in_flight[k].frame != frame || peer.in_flight[k].tile != tile)) ++k;
+            if (k == peer.in_flight.size()) return false;  // never asked it for that one
+
+            peer.in_flight.erase(peer.in_flight.begin() + k);
+            if (peer.credits < MAX_CREDITS) ++peer.credits;
+
+            source_->storeTile(frame, tile, x0, y0, x1, y1, rgba);
+            return true;
+        }
+
+        default:
+            std::fprintf(stderr, "[farm] unexpected message type %u\n", msg.type);
+            return false;
+    }
+}
+
+bool Coordinator::dispatch(Peer &peer) {
+    // queue more only once the last batch is out, which bounds the buffer
+    if (!peer.credits || peer.out_sent < peer.out.size()) return true;
+
+    SDL_LockMutex(mtx_);
+    const unsigned frame   = frame_;
+    const unsigned version = scene_version_;
+    std::vector<uint8_t> scene_msg;
+    if (version != 0 && peer.scene_sent != version) {
+        Writer w(scene_msg);
+        w.u32(version);
+        w.u32((uint32_t)width_);
+        w.u32((uint32_t)height_);
+        w.u32((uint32_t)max_depth_);
+        w.f64(eps_);
+        w.str(scene_);
+    }
+    SDL_UnlockMutex(mtx_);
+
+    if (version == 0) return true;  // no frame yet
+
+    if (!scene_msg.empty()) {
+        appendMessage(peer.out, MSG_SCENE, scene_msg);
+        peer.scene_sent = version;
+    }
+
+    int tile, x0, y0, x1, y1;
+    while (peer.credits && source_->takeTile(frame, &tile, &x0, &y0, &x1, &y1)) {
+        std::vector<uint8_t> body;
+        Writer w(body);
+        w.u32(frame);
+        w.u32((uint32_t)tile);
+        w.u32((uint32_t)x0);
+        w.u32((uint32_t)y0);
+        w.u32((uint32_t)x1);
+        w.u32((uint32_t)y1);
+
+        // owned by the peer from here on, so drop() gives it back on failure
+        InFlight f;
+        f.frame = frame;
+        f.tile  = tile;
+        if (peer.in_flight.empty()) peer.last_progress = SDL_GetTicks();
+        peer.in_flight.push_back(f);
+        --peer.credits;
+
+        appendMessage(peer.out, MSG_TILE, body);
+    }
+
+    return flush(peer);
+}
+
+void Coordinator::drop(size_t i) {
+    Peer &peer = peers_[i];
+    for (size_t k = 0; k < peer.in_flight.size(); ++k) {
+        source_->giveBackTile(peer.in_flight[k].frame, peer.in_flight[k].tile);
+    }
+
+    close(peer.fd);
+    peers_.erase(peers_.begin() + i);
+    n_peers_.store(peers_.size(), std::memory_order_relaxed);
+
+    printf("[debug] render worker disconnected (%zu left)\n", peers_.size());
+}
+
+}
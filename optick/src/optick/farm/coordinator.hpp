@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
+
+namespace farm {
+
+struct Message;
+
+/**
+ * Whoever owns the frame: hands out tiles, takes the pixels back.
+ * All three are called from the coordinator thread
+ */
+class TileSource {
+public:
+    virtual ~TileSource() {}
+
+    /**
+     * false if `frame` is over or every tile of it is already taken
+     */
+    virtual bool takeTile(unsigned frame, int *tile, int *x0, int *y0, int *x1, int *y1) = 0;
+
+    /**
+     * The worker rendering `tile` went away, someone else has to do it
+     */
+    virtual void giveBackTile(unsigned frame, int tile) = 0;
+
+    /**
+     * `rgba` holds (x1 - x0) * (y1 - y0) tightly packed pixels
+     */
+    virtual void storeTile(unsigned frame, int tile, int x0, int y0, int x1, int y1, const uint8_t *rgba) = 0;
+};
+
+/**
+ * Accepts render-worker connections and feeds them tiles as they ask for
+ * them (credit based, so fast workers take more). The scene is sent only
+ * when its encoding changes. Peer sockets are non-blocking with a buffer
+ * each way, so one slow worker never holds up the others; one that owes
+ * tiles and makes no progress for a while is dropped
+ */
+class Coordinator {
+public:
+    /**
+     * NULL if the address can't be listened on (reason on stderr)
+     */
+    static Coordinator *listen(const std::string &addr, TileSource *source);
+
+    ~Coordinator();
+
+    Coordinator(const Coordinator &) = delete;
+    Coordinator &operator=(const Coordinator &) = delete;
+
+    void beginFrame(unsigned frame, const std::string &scene, int width, int height, int max_depth, double eps);
+
+    size_t workers() const { return n_peers_.load(std::memory_order_relaxed); }
+
+private:
+    struct InFlight {
+        unsigned frame;
+        int      tile;
+    };
+
+    struct Peer {
+        int                   fd;
+        unsigned              scene_sent;  // version, 0 = none yet
+        unsigned              credits;
+        std::vector<InFlight> in_flight;
+        std::vector<uint8_t>  in;          // received, not yet a whole message
+        std::vector<uint8_t>  out;         // queued, out_sent bytes of it gone
+        size_t                out_sent;
+        Uint64                last_progress;  // ms, last byte moved or tile handed out
+
+        bool busy() const { return !in_flight.empty() || out_sent < out.size(); }
+    };
+
+    Coordinator(int listen_fd, int wake_r, int wake_w, TileSource *source);
+
+    TileSource *source_;
+
+    // ---- shared, guarded by mtx_ ----
+    SDL_Mutex  *mtx_;
+    unsigned    frame_;
+    unsigned    scene_version_;
+    std::string scene_;
+    int         width_, height_, max_depth_;
+    double      eps_;
+    bool        stop_;
+
+    // ---- coordinator thread only ----
+    SDL_Thread       *thread_;
+    int               listen_fd_;
+    int               wake_r_, wake_w_;  // self-pipe, nudges poll()
+    std::vector<Peer> peers_;
+
+    std::atomic<size_t> n_peers_{0};
+
+    void wake();
+
+    static int threadEntry(void *self_void);
+    void run();
+
+    void accept();
+    bool receive(Peer &peer);
+    bool flush(Peer &peer);
+    bool onMessage(Peer &peer, const Message &msg);
+    bool dispatch(Peer &peer);
+    void drop(size_t i);
+};
+
+}
@@ -0,0 +1,351 @@
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <sstream>
+
+#include "./scene_codec.hpp"
+
+void SceneSnapshot::clear() {
+    for (size_t i = 0; i < scene.objects.size(); ++i) delete scene.objects[i];
+    scene.objects.clear();
+}
+
+static void putVec(std::ostream &os, const Vector3 &v) {
+    os << ' ' << v.x << ' ' << v.y << ' ' << v.z;
+}
+
+static void putColor(std::ostream &os, const opt::Color &c) {
+    os << ' ' << c.r << ' ' << c.g << ' ' << c.b;
+}
+
+static void putName(std::ostream &os, const std::string &name) {
+    os << ' ';
+    for (size_t i = 0; i < name.size(); ++i) os << (name[i] == '\n' ? ' ' : name[i]);
+    os << '\n';
+}
+
+static bool getVec(std::istream &is, Vector3 *v) {
+    return static_cast<bool>(is >> v->x >> v->y >> v->z);
+}
+
+static bool getColor(std::istream &is, opt::Color *c) {
+    return static_cast<bool>(is >> c->r >> c->g >> c->b);
+}
+
+static std::string getName(std::istream &is) {
+    std::string name;
+    std::getline(is, name);
+    if (!name.empty() && name[0] == ' ') name.erase(0, 1);
+    return name;
+}
+
+static bool putMaterial(std::ostream &os, const Material *m) {
+    if (auto *o = dynamic_cast<const MaterialOpaque*>(m)) {
+        os << "opaque " << o->kd << ' ' << o->ks << ' ' << o->shininess << '\n';
+    } else if (dynamic_cast<const MaterialReflective*>(m)) {
+        os << "reflective\n";
+    } else if (auto *r = dynamic_cast<const MaterialRefractive*>(m)) {
+        os << "refractive " << r->ior << '\n';
+    } else if (auto *e = dynamic_cast<const MaterialEmissive*>(m)) {
+        os << "emissive";
+        putColor(os, e->Le);
+        os << '\n';
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static MaterialRef getMaterial(std::istream &is) {
+    std::string kind;
+    if (!(is >> kind)) return nullptr;
+
+    if (kind == "opaque") {
+        double kd, ks, shininess;
+        if (!(is >> kd >> ks >> shininess)) return nullptr;
+        return std::make_shared<MaterialOpaque>(kd, ks, shininess);
+    }
+    if (kind == "reflective") {
+        return std::make_shared<MaterialReflective>();
+    }
+    if (kind == "refractive") {
+        double ior;
+        if (!(is >> ior)) return nullptr;
+        return std::make_shared<MaterialRefractive>(ior);
+    }
+    if (kind == "emissive") {
+        opt::Color Le;
+        if (!getColor(is, &Le)) return nullptr;
+        return std::make_shared<MaterialEmissive>(Le);
+    }
+    return nullptr;
+}
+
+/**
+ * Index tables for everything that is shared by pointer
+ */
+struct SharedIndex {
+    std::map<const Material*, size_t> mat_index;
+    std::vector<const Material*>      mats;
+    std::map<const Object*, size_t>   proto_index;
+    std::vector<const Object*>        protos;  // dependencies come first
+
+    void addMaterial(const Material *m) {
+        if (m && mat_index.insert(std::make_pair(m, mats.size())).second) mats.push_back(m);
+    }
+
+    void addObject(const Object *obj) {
+        addMaterial(obj->mat.get());
+        if (auto *inst = dynamic_cast<const Instance*>(obj)) {
+            const Object *proto = inst->proto.get();
+            if (proto_index.count(proto)) return;
+            addObject(proto);
+            proto_index[proto] = protos.size();
+            protos.push_back(proto);
+        }
+    }
+};
+
+static void putMaterialRef(std::ostream &os, const SharedIndex &idx, const Material *m) {
+    if (m) os << idx.mat_index.find(m)->second;
+    else   os << "none";
+}
+
+static bool putObject(std::ostream &os, const Object *obj, const SharedIndex &idx) {
+    if (auto *inst = dynamic_cast<const Instance*>(obj)) {
+        os << "instance ";
+        putMaterialRef(os, idx, obj->mat.get());
+        putColor(os, inst->color);
+        os << ' ' << idx.proto_index.find(inst->proto.get())->second;
+        putVec(os, inst->center);
+        for (unsigned int row = 0; row < 3; ++row) {
+            for (unsigned int col = 0; col < 3; ++col) os << ' ' << inst->getLinear().at(row, col);
+        }
+        putName(os, obj->name);
+        return true;
+    }
+
+    if (auto *s = dynamic_cast<const Sphere*>(obj)) {
+        os << "sphere ";
+        putMaterialRef(os, idx, obj->mat.get());
+        putColor(os, s->color);
+        putVec(os, s->center);
+        os << ' ' << s->radius;
+    } else if (auto *p = dynamic_cast<const Plane*>(obj)) {
+        os << "plane ";
+        putMaterialRef(os, idx, obj->mat.get());
+        putColor(os, p->color);
+        putVec(os, p->center);
+        putVec(os, p->normal);
+    } else if (auto *poly = dynamic_cast<const Polygon*>(obj)) {
+        os << "polygon ";
+        putMaterialRef(os, idx, obj->mat.get());
+        putColor(os, poly->color);
+        os << ' ' << poly->verts3.size();
+        for (size_t i = 0; i < poly->verts3.size(); ++i) putVec(os, poly->verts3[i]);
+    } else if (auto *t = dynamic_cast<const Tetrahedron*>(obj)) {
+        os << "tetra ";
+        putMaterialRef(os, idx, obj->mat.get());
+        putColor(os, t->color);
+        for (int i = 0; i < 4; ++i) putVec(os, t->v[i]);
+    } else {
+        return false;
+    }
+
+    putName(os, obj->name);
+    return true;
+}
+
+static Object *getObject(
+        std::istream &is,
+        const std::vector<MaterialRef> &materials,
+        const std::vector<std::shared_ptr<const Object> > &protos)
+{
+    std::string kind, mat_tok;
+    opt::Color  color;
+    if (!(is >> kind >> mat_tok) || !getColor(is, &color)) return NULL;
+
+    MaterialRef m;
+    if (mat_tok != "none") {
+        char *end = NULL;
+        const unsigned long mat_i = std::strtoul(mat_tok.c_str(), &end, 10);
+        if (*end || mat_i >= materials.size()) return NULL;
+        m = materials[mat_i];
+    }
+
+    if (kind == "instance") {
+        size_t  proto_i;
+        Vector3 pos;
+        double  lin[3][3];
+        if (!(is >> proto_i) || proto_i >= protos.size() || !getVec(is, &pos)) return NULL;
+        for (unsigned int row = 0; row < 3; ++row) {
+            for (unsigned int col = 0; col < 3; ++col) {
+                if (!(is >> lin[row][col])) return NULL;
+            }
+        }
+        return new Instance(getName(is), protos[proto_i], pos, Mat3(lin), color, m);
+    }
+
+    if (kind == "sphere") {
+        Vector3 c;
+        double  r;
+        if (!getVec(is, &c) || !(is >> r)) return NULL;
+        return new Sphere(getName(is), c, r, color, m);
+    }
+    if (kind == "plane") {
+        Vector3 p, n;
+        if (!getVec(is, &p) || !getVec(is, &n)) return NULL;
+        return new Plane(getName(is), p, n, color, m);
+    }
+    if (kind == "polygon") {
+        size_t n;
+        if (!(is >> n) || n > (1u << 20)) return NULL;
+        std::vector<Vector3> verts(n);
+        for (size_t i = 0; i < n; ++i) {
+            if (!getVec(is, &verts[i])) return NULL;
+        }
+        return new Polygon(getName(is), verts, color, m);
+    }
+    if (kind == "tetra") {
+        Vector3 v[4];
+        for (int i = 0; i < 4; ++i) {
+            if (!getVec(is, &v[i])) return NULL;
+        }
+        return new Tetrahedron(getName(is), v[0], v[1], v[2], v[3], color, m);
+    }
+    return NULL;
+}
+
+std::string encodeScene(const Scene &scene, const Camera &cam) {
+    std::ostringstream os;
+    os.imbue(std::locale::classic());
+    os.precision(std::numeric_limits<double>::max_digits10);
+
+    os << "optick-scene 2\n";
+
+    os << "background";
+    putColor(os, scene.backgroundTop);
+    putColor(os, scene.backgroundBottom);
+    os << '\n';
+
+    os << "camera";
+    putVec(os, cam.pos);
+    putVec(os, cam.target);
+    os << ' ' << cam.vfov << ' ' << cam.width << ' ' << cam.height << '\n';
+
+    // materials and instanced geometry are shared by pointer, keep them shared
+    SharedIndex idx;
+    for (size_t i = 0; i < scene.objects.size(); ++i) idx.addObject(scene.objects[i]);
+
+    os << "materials " << idx.mats.size() << '\n';
+    for (size_t i = 0; i < idx.mats.size(); ++i) {
+        if (!putMaterial(os, idx.mats[i])) {
+            std::fprintf(stderr, "[farm] material #%zu has no wire format, sent as opaque\n", i);
+            os << "opaque 1 0 32\n";
+        }
+    }
+
+    os << "prototypes " << idx.protos.size() << '\n';
+    for (size_t i = 0; i < idx.protos.size(); ++i) {
+        if (!putObject(os, idx.protos[i], idx)) {
+            // instances refer to it by index, so a placeholder has to stay
+            std::fprintf(stderr, "[farm] prototype #%zu has no wire format, sent empty\n", i);
+            os << "polygon none 0 0 0 0\n";
+        }
+    }
+
+    std::ostringstream objs;
+    objs.imbue(std::locale::classic());
+    objs.precision(std::numeric_limits<double>::max_digits10);
+
+    size_t n_objs = 0;
+    for (size_t i = 0; i < scene.objects.size(); ++i) {
+        const Object *obj = scene.objects[i];
+        if (putObject(objs, obj, idx)) {
+            ++n_objs;
+        } else {
+            std::fprintf(stderr, "[farm] object '%s' has no wire format, skipped\n", obj->name.c_str());
+        }
+    }
+
+    os << "objects " << n_objs << '\n' << objs.str();
+    return os.str();
+}
+
+bool decodeScene(const std::string &blob, SceneSnapshot *out) {
+    out->clear();
+
+    std::istringstream is(blob);
+    is.imbue(std::locale::classic());
+
+    std::string tag;
+    int version = 0;
+    if (!(is >> tag >> version) || tag != "optick-scene" || version != 2) {
+        std::fprintf(stderr, "[farm] not an optick scene\n");
+        return false;
+    }
+
+    if (!(is >> tag) || tag != "background"
+            || !getColor(is, &out->scene.backgroundTop)
+            || !getColor(is, &out->scene.backgroundBottom)) {
+        std::fprintf(stderr, "[farm] bad scene background\n");
+        return false;
+    }
+
+    Vector3 pos, target;
+    double vfov, w, h;
+    if (!(is >> tag) || tag != "camera"
+            || !getVec(is, &pos) || !getVec(is, &target) || !(is >> vfov >> w >> h)) {
+        std::fprintf(stderr, "[farm] bad scene camera\n");
+        return false;
+    }
+    out->cam = Camera(pos, vfov, w, h);
+    out->cam.target = target;
+    out->cam.makeBasis();
+
+    size_t n = 0;
+    if (!(is >> tag >> n) || tag != "materials") {
+        std::fprintf(stderr, "[farm] bad scene materials\n");
+        return false;
+    }
+    std::vector<MaterialRef> materials;
+    for (size_t i = 0; i < n; ++i) {
+        MaterialRef m = getMaterial(is);
+        if (!m) {
+            std::fprintf(stderr, "[farm] bad material #%zu\n", i);
+            return false;
+        }
+        materials.push_back(m);
+    }
+
+    if (!(is >> tag >> n) || tag != "prototypes") {
+        std::fprintf(stderr, "[farm] bad scene prototypes\n");
+        return false;
+    }
+    std::vector<std::shared_ptr<const Object> > protos;
+    for (size_t i = 0; i < n; ++i) {
+        Object *proto = getObject(is, materials, protos);
+        if (!proto) {
+            std::fprintf(stderr, "[farm] bad prototype #%zu\n", i);
+            return false;
+        }
+        protos.push_back(std::shared_ptr<const Object>(proto));
+    }
+
+    if (!(is >> tag >> n) || tag != "objects") {
+        std::fprintf(stderr, "[farm] bad scene objects\n");
+        return false;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        Object *obj = getObject(is, materials, protos);
+        if (!obj) {
+            std::fprintf(stderr, "[farm] bad object #%zu\n", i);
+            out->clear();
+            return false;
+        }
+        out->scene.objects.push_back(obj);
+    }
+
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "../trace/camera.hpp"
+#include "../trace/scene.hpp"
+
+/**
+ * A decoded scene, owning its objects (materials and instanced geometry
+ * are kept alive by the objects themselves)
+ */
+struct SceneSnapshot {
+    Scene  scene;
+    Camera cam;
+
+    SceneSnapshot() : cam(Vector3(0, 0, 0), 45.0, 1, 1) {}
+    ~SceneSnapshot() { clear(); }
+
+    SceneSnapshot(const SceneSnapshot &) = delete;
+    SceneSnapshot &operator=(const SceneSnapshot &) = delete;
+
+    void clear();
+};
+
+/**
+ * Plain-text scene + camera dump; materials and instanced geometry shared
+ * between objects stay shared. Doubles are written with full precision, so a decoded scene
+ * renders bit-identical pixels
+ */
+std::string encodeScene(const Scene &scene, const Camera &cam);
+
+/**
+ * false on malformed input (reason on stderr), `out` is left cleared
+ */
+bool decodeScene(const std::string &blob, SceneSnapshot *out);
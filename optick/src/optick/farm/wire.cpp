@@ -0,0 +1,234 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "./wire.hpp"
+
+namespace farm {
+
+void Writer::f64(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    u64(bits);
+}
+
+double Reader::f64() {
+    uint64_t bits = u64();
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+enum AddrKind { ADDR_BAD, ADDR_UNIX, ADDR_TCP };
+
+static AddrKind splitAddr(const std::string &addr, std::string *host, std::string *port) {
+    if (addr.compare(0, 5, "unix:") == 0) {
+        *host = addr.substr(5);
+        return host->empty() ? ADDR_BAD : ADDR_UNIX;
+    }
+    if (addr.compare(0, 4, "tcp:") == 0) {
+        const size_t colon = addr.rfind(':');
+        if (colon <= 3) return ADDR_BAD;
+        *host = addr.substr(4, colon - 4);
+        *port = addr.substr(colon + 1);
+        return port->empty() ? ADDR_BAD : ADDR_TCP;
+    }
+    return ADDR_BAD;
+}
+
+static bool fillUnix(const std::string &path, sockaddr_un *sa) {
+    std::memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    if (path.size() >= sizeof(sa->sun_path)) {
+        std::fprintf(stderr, "[farm] socket path too long: %s\n", path.c_str());
+        return false;
+    }
+    std::memcpy(sa->sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+static int tcpSocket(const std::string &host, const std::string &port, bool listening) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = listening ? AI_PASSIVE : 0;
+
+    addrinfo *res = NULL;
+    const char *node = host.empty() ? NULL : host.c_str();
+    int rc = getaddrinfo(node, port.c_str(), &hints, &res);
+    if (rc != 0) {
+        std::fprintf(stderr, "[farm] %s:%s: %s\n", host.c_str(), port.c_str(), gai_strerror(rc));
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo *ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+
+        int one = 1;
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0) break;
+        } else {
+            if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                break;
+            }
+        }
+
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        std::fprintf(stderr, "[farm] tcp:%s:%s: %s\n", host.c_str(), port.c_str(), std::strerror(errno));
+    }
+    return fd;
+}
+
+int connectTo(const std::string &addr) {
+    std::string host, port;
+    switch (splitAddr(addr, &host, &port)) {
+        case ADDR_UNIX: {
+            sockaddr_un sa;
+            if (!fillUnix(host, &sa)) return -1;
+
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0) return -1;
+            if (connect(fd, (sockaddr*)&sa, sizeof(sa)) != 0) {
+                std::fprintf(stderr, "[farm] %s: %s\n", addr.c_str(), std::strerror(errno));
+                close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        case ADDR_TCP:
+            return tcpSocket(host, port, false);
+
+        case ADDR_BAD:
+            break;
+    }
+
+    std::fprintf(stderr, "[farm] bad address '%s' (want unix:/path or tcp:host:port)\n", addr.c_str());
+    return -1;
+}
+
+int listenOn(const std::string &addr) {
+    std::string host, port;
+    switch (splitAddr(addr, &host, &port)) {
+        case ADDR_UNIX: {
+            sockaddr_un sa;
+            if (!fillUnix(host, &sa)) return -1;
+
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0) return -1;
+
+            unlink(host.c_str());  // stale socket from a previous session
+            if (bind(fd, (sockaddr*)&sa, sizeof(sa)) != 0 || listen(fd, 16) != 0) {
+                std::fprintf(stderr, "[farm] %s: %s\n", addr.c_str(), std::strerror(errno));
+                close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        case ADDR_TCP:
+            return tcpSocket(host, port, true);
+
+        case ADDR_BAD:
+            break;
+    }
+
+    std::fprintf(stderr, "[farm] bad address '%s' (want unix:/path or tcp:host:port)\n", addr.c_str());
+    return -1;
+}
+
+static bool writeAll(int fd, const void *data, size_t n) {
+    const uint8_t *p = static_cast<const uint8_t*>(data);
+    while (n) {
+        ssize_t k = send(fd, p, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return false;
+        p += k;
+        n -= (size_t)k;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *data, size_t n) {
+    uint8_t *p = static_cast<uint8_t*>(data);
+    while (n) {
+        ssize_t k = recv(fd, p, n, 0);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return false;
+        p += k;
+        n -= (size_t)k;
+    }
+    return true;
+}
+
+bool sendMessage(int fd, uint32_t type, const std::vector<uint8_t> &body) {
+    std::vector<uint8_t> header;
+    header.reserve(8);
+    Writer w(header);
+    w.u32(type);
+    w.u32((uint32_t)body.size());
+
+    return writeAll(fd, header.data(), header.size())
+        && (body.empty() || writeAll(fd, body.data(), body.size()));
+}
+
+bool recvMessage(int fd, Message *out) {
+    std::vector<uint8_t> header(8);
+    if (!readAll(fd, header.data(), header.size())) return false;
+
+    Reader r(header);
+    out->type = r.u32();
+    uint32_t len = r.u32();
+    if (len > MAX_BODY) return false;
+
+    out->body.resize(len);
+    return len == 0 || readAll(fd, out->body.data(), len);
+}
+
+void appendMessage(std::vector<uint8_t> &out, uint32_t type, const std::vector<uint8_t> &body) {
+    Writer w(out);
+    w.u32(type);
+    w.u32((uint32_t)body.size());
+    w.bytes(body.data(), body.size());
+}
+
+bool takeMessage(const std::vector<uint8_t> &in, size_t *pos, Message *out, bool *bad) {
+    *bad = false;
+    if (in.size() - *pos < 8) return false;
+
+    const uint8_t *h = in.data() + *pos;
+    uint32_t type = 0, len = 0;
+    for (int i = 0; i < 4; ++i) {
+        type |= (uint32_t)h[i] << (8 * i);
+        len  |= (uint32_t)h[4 + i] << (8 * i);
+    }
+    if (len > MAX_BODY) {
+        *bad = true;
+        return false;
+    }
+    if (in.size() - *pos - 8 < len) return false;
+
+    out->type = type;
+    out->body.assign(h + 8, h + 8 + len);
+    *pos += 8 + len;
+    return true;
+}
+
+}
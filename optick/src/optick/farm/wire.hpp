@@ -0,0 +1,123 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Tile farm wire format: every message is a 8-byte header
+ * (u32 type, u32 body length, little-endian) followed by the body
+ */
+namespace farm {
+
+enum MsgType {
+    MSG_SCENE  = 1,  // C -> W: u32 version, u32 w, u32 h, u32 max_depth, f64 eps, str scene
+    MSG_TILE   = 2,  // C -> W: u32 frame, u32 tile, u32 x0, y0, x1, y1
+    MSG_PULL   = 3,  // W -> C: u32 credits (tiles the worker is ready to take)
+                     //         every MSG_RESULT hands one credit back implicitly
+    MSG_RESULT = 4,  // W -> C: u32 frame, u32 tile, u32 x0, y0, x1, y1, RGBA rows
+};
+
+static const uint32_t MAX_BODY = 64u << 20;
+
+struct Message {
+    uint32_t             type;
+    std::vector<uint8_t> body;
+
+    Message() : type(0) {}
+};
+
+class Writer {
+    std::vector<uint8_t> &buf;
+
+public:
+    explicit Writer(std::vector<uint8_t> &out) : buf(out) {}
+
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; ++i) buf.push_back((uint8_t)(v >> (8 * i)));
+    }
+
+    void u64(uint64_t v) {
+        for (int i = 0; i < 8; ++i) buf.push_back((uint8_t)(v >> (8 * i)));
+    }
+
+    void f64(double v);
+
+    void bytes(const void *data, size_t n) {
+        const uint8_t *p = static_cast<const uint8_t*>(data);
+        buf.insert(buf.end(), p, p + n);
+    }
+
+    void str(const std::string &s) {
+        u32((uint32_t)s.size());
+        bytes(s.data(), s.size());
+    }
+};
+
+class Reader {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool           ok_;
+
+    bool need(size_t n) {
+        if (!ok_ || (size_t)(end - p) < n) ok_ = false;
+        return ok_;
+    }
+
+public:
+    explicit Reader(const std::vector<uint8_t> &in)
+        : p(in.data()), end(in.data() + in.size()), ok_(true) {}
+
+    bool ok() const { return ok_; }
+    size_t remaining() const { return ok_ ? (size_t)(end - p) : 0; }
+
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) v |= (uint32_t)(*p++) << (8 * i);
+        return v;
+    }
+
+    uint64_t u64() {
+        if (!need(8)) return 0;
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) v |= (uint64_t)(*p++) << (8 * i);
+        return v;
+    }
+
+    double f64();
+
+    const uint8_t *bytes(size_t n) {
+        if (!need(n)) return NULL;
+        const uint8_t *at = p;
+        p += n;
+        return at;
+    }
+
+    std::string str() {
+        uint32_t n = u32();
+        const uint8_t *at = bytes(n);
+        return at ? std::string((const char*)at, n) : std::string();
+    }
+};
+
+/**
+ * Addresses are "unix:/path/to/socket" or "tcp:host:port".
+ * Both return a connected/listening fd, or -1 (reason on stderr)
+ */
+int connectTo(const std::string &addr);
+int listenOn(const std::string &addr);
+
+bool sendMessage(int fd, uint32_t type, const std::vector<uint8_t> &body);
+bool recvMessage(int fd, Message *out);
+
+/**
+ * The same framing for non-blocking sockets: appendMessage queues a
+ * message on an output buffer, takeMessage cuts the next complete one out
+ * of an input buffer starting at *pos and moves *pos past it. takeMessage
+ * returns false once no complete message is left, with *bad set if the
+ * header can't be valid
+ */
+void appendMessage(std::vector<uint8_t> &out, uint32_t type, const std::vector<uint8_t> &body);
+bool takeMessage(const std::vector<uint8_t> &in, size_t *pos, Message *out, bool *bad);
+
+}
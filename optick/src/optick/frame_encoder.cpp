@@ -0,0 +1,310 @@
+#include <cstdio>
+#include <utility>
+
+#include "./frame_encoder.hpp"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_STATIC
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#pragma GCC diagnostic ignored "-Wmissing-declarations"
+#pragma GCC diagnostic ignored "-Wunused-function"
+#include "./widgets/stb_image_write.h"
+#pragma GCC diagnostic pop
+
+RawFrame RawFrame::fromImage(const dr4::Image *img) {
+    RawFrame f;
+    if (!img) return f;
+
+    const size_t w = static_cast<size_t>(img->GetWidth());
+    const size_t h = static_cast<size_t>(img->GetHeight());
+    if (!w || !h) return f;
+
+    f.width  = static_cast<int>(w);
+    f.height = static_cast<int>(h);
+    f.rgba.resize(w * h * 4);
+
+    uint8_t *px = f.rgba.data();
+    for (size_t y = 0; y < h; ++y) {
+        for (size_t x = 0; x < w; ++x) {
+            dr4::Color c = img->GetPixel(x, y);
+            *px++ = c.r;
+            *px++ = c.g;
+            *px++ = c.b;
+            *px++ = c.a;
+        }
+    }
+
+    return f;
+}
+
+static bool WritePNG(const RawFrame &f, const std::string &path) {
+    if (f.empty()) return false;
+    return stbi_write_png(path.c_str(), f.width, f.height, 4, f.rgba.data(), f.width * 4) != 0;
+}
+
+FrameEncoder::FrameEncoder(size_t capacity)
+        : capacity_(capacity ? capacity : 1)
+        , queued_frames_(0)
+        , stop_(false)
+        , seq_active_(false)
+        , seq_bp_(DROP)
+        , seq_fmt_(PNG_SEQUENCE)
+        , seq_file_(nullptr)
+        , seq_index_(0)
+        , seq_sized_(false)
+        , seq_w_(0), seq_h_(0)
+{
+    mtx_       = SDL_CreateMutex();
+    has_job_   = SDL_CreateCondition();
+    has_space_ = SDL_CreateCondition();
+    worker_    = SDL_CreateThread(FrameEncoder::workerEntry, "frame_encoder", this);
+}
+
+FrameEncoder::~FrameEncoder() {
+    if (seq_active_) stopSequence();
+
+    // the worker drains everything queued before it exits
+    SDL_LockMutex(mtx_);
+    stop_ = true;
+    SDL_BroadcastCondition(has_job_);
+    SDL_UnlockMutex(mtx_);
+
+    if (worker_) SDL_WaitThread(worker_, 0);
+
+    if (has_space_) SDL_DestroyCondition(has_space_);
+    if (has_job_)   SDL_DestroyCondition(has_job_);
+    if (mtx_)       SDL_DestroyMutex(mtx_);
+}
+
+void FrameEncoder::push(Job &&job) {
+    SDL_LockMutex(mtx_);
+    if (job.kind == JOB_SEQ_FRAME) ++queued_frames_;
+    queue_.push_back(std::move(job));
+    SDL_SignalCondition(has_job_);
+    SDL_UnlockMutex(mtx_);
+}
+
+void FrameEncoder::submitPNG(RawFrame &&frame, const std::string &path) {
+    if (frame.empty()) return;
+
+    Job job;
+    job.kind  = JOB_PNG;
+    job.frame = std::move(frame);
+    job.path  = path;
+    push(std::move(job));
+}
+
+void FrameEncoder::startSequence(SequenceFormat fmt, const std::string &base, Backpressure bp, int fps) {
+    if (seq_active_) stopSequence();
+
+    Job job;
+    job.kind = JOB_SEQ_BEGIN;
+    job.path = base;
+    job.fmt  = fmt;
+    job.fps  = fps > 0 ? fps : 30;
+    push(std::move(job));
+
+    seq_bp_     = bp;
+    seq_active_ = true;
+}
+
+void FrameEncoder::stopSequence() {
+    if (!seq_active_) return;
+
+    Job job;
+    job.kind = JOB_SEQ_END;
+    push(std::move(job));
+
+    seq_active_ = false;
+}
+
+/**
+ * Only frames count against the capacity, control jobs always fit.
+ * Frames are only ever queued from the UI thread and the worker only
+ * takes them out, so the room found here is still there at pushFrame
+ */
+bool FrameEncoder::waitForRoom() {
+    SDL_LockMutex(mtx_);
+    if (queued_frames_ >= capacity_) {
+        if (seq_bp_ == DROP) {
+            SDL_UnlockMutex(mtx_);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        while (queued_frames_ >= capacity_) {
+            SDL_WaitCondition(has_space_, mtx_);
+        }
+    }
+    SDL_UnlockMutex(mtx_);
+    return true;
+}
+
+void FrameEncoder::pushFrame(RawFrame &&frame) {
+    Job job;
+    job.kind  = JOB_SEQ_FRAME;
+    job.frame = std::move(frame);
+    push(std::move(job));
+}
+
+bool FrameEncoder::submitSequenceFrame(RawFrame &&frame) {
+    if (!seq_active_ || frame.empty()) return false;
+    if (!waitForRoom()) return false;
+
+    pushFrame(std::move(frame));
+    return true;
+}
+
+bool FrameEncoder::submitSequenceFrame(const dr4::Image *img) {
+    if (!seq_active_ || !img) return false;
+    if (!waitForRoom()) return false;
+
+    RawFrame frame = RawFrame::fromImage(img);
+    if (frame.empty()) return false;
+
+    pushFrame(std::move(frame));
+    return true;
+}
+
+int FrameEncoder::workerEntry(void *self_void) {
+    FrameEncoder *self = static_cast<FrameEncoder*>(self_void);
+
+    for (;;) {
+        SDL_LockMutex(self->mtx_);
+        while (!self->stop_ && self->queue_.empty()) {
+            SDL_WaitCondition(self->has_job_, self->mtx_);
+        }
+
+        if (self->queue_.empty()) {  // stop requested and drained
+            SDL_UnlockMutex(self->mtx_);
+            break;
+        }
+
+        Job job = std::move(self->queue_.front());
+        self->queue_.pop_front();
+        if (job.kind == JOB_SEQ_FRAME) {
+            --self->queued_frames_;
+            SDL_SignalCondition(self->has_space_);
+        }
+        SDL_UnlockMutex(self->mtx_);
+
+        self->process(job);
+    }
+
+    self->endSequence();
+    return 0;
+}
+
+void FrameEncoder::process(Job &job) {
+    switch (job.kind) {
+        case JOB_PNG:
+            if (!WritePNG(job.frame, job.path)) {
+                std::fprintf(stderr, "[encoder] failed to write %s\n", job.path.c_str());
+            }
+            break;
+
+        case JOB_SEQ_BEGIN:
+            beginSequence(job);
+            break;
+
+        case JOB_SEQ_FRAME:
+            writeSequenceFrame(job.frame);
+            break;
+
+        case JOB_SEQ_END:
+            endSequence();
+            break;
+    }
+}
+
+void FrameEncoder::beginSequence(const Job &job) {
+    endSequence();
+
+    seq_fmt_   = job.fmt;
+    seq_base_  = job.path;
+    seq_index_ = 0;
+    seq_sized_ = false;
+    seq_w_     = seq_h_ = 0;
+
+    if (seq_fmt_ == Y4M_STREAM) {
+        const std::string path = seq_base_ + ".y4m";
+        seq_file_ = std::fopen(path.c_str(), "wb");
+        if (!seq_file_) {
+            std::fprintf(stderr, "[encoder] failed to open %s\n", path.c_str());
+            return;
+        }
+        // the header needs the frame size, it is written with the first frame
+        std::fprintf(seq_file_, "YUV4MPEG2 F%d:1 Ip A1:1 C444", job.fps);
+    }
+}
+
+void FrameEncoder::endSequence() {
+    if (seq_file_) {
+        std::fclose(seq_file_);
+        seq_file_ = nullptr;
+    }
+    seq_base_.clear();
+}
+
+void FrameEncoder::writeSequenceFrame(const RawFrame &frame) {
+    if (seq_base_.empty()) return;
+
+    // a stream has a fixed size; frames from a resized view are skipped
+    if (!seq_sized_) {
+        seq_w_ = frame.width;
+        seq_h_ = frame.height;
+    } else if (frame.width != seq_w_ || frame.height != seq_h_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    bool ok = false;
+    if (seq_fmt_ == PNG_SEQUENCE) {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), "_%06zu.png", seq_index_);
+        ok = WritePNG(frame, seq_base_ + suffix);
+    } else {
+        ok = writeY4MFrame(frame);
+    }
+
+    if (ok) {
+        seq_sized_ = true;
+        ++seq_index_;
+        written_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * RGBA -> BT.601 limited range Y'CbCr, full resolution chroma
+ */
+bool FrameEncoder::writeY4MFrame(const RawFrame &frame) {
+    if (!seq_file_) return false;
+
+    // once the header is out the stream size is fixed, even if the frame
+    // data below fails, so a retry must not write it again
+    if (!seq_sized_) {
+        if (std::fprintf(seq_file_, " W%d H%d\n", frame.width, frame.height) < 0) return false;
+        seq_sized_ = true;
+    }
+
+    const size_t n = static_cast<size_t>(frame.width) * static_cast<size_t>(frame.height);
+    yuv_.resize(n * 3);
+
+    uint8_t *Y = yuv_.data();
+    uint8_t *U = Y + n;
+    uint8_t *V = U + n;
+
+    const uint8_t *px = frame.rgba.data();
+    for (size_t i = 0; i < n; ++i, px += 4) {
+        const int r = px[0], g = px[1], b = px[2];
+        // biased by 128 << 8 so the shifts only ever see non-negative values
+        Y[i] = static_cast<uint8_t>((( 66 * r + 129 * g +  25 * b + 128) >> 8) + 16);
+        U[i] = static_cast<uint8_t>(((-38 * r -  74 * g + 112 * b + 128 + (128 << 8)) >> 8));
+        V[i] = static_cast<uint8_t>(((112 * r -  94 * g -  18 * b + 128 + (128 << 8)) >> 8));
+    }
+
+    if (std::fputs("FRAME\n", seq_file_) < 0) return false;
+    return std::fwrite(yuv_.data(), 1, yuv_.size(), seq_file_) == yuv_.size();
+}
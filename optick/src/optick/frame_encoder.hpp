@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+
+#include <dr4/texture.hpp>
+
+/**
+ * Tightly packed 8-bit RGBA frame, handed over to the encoder by move
+ */
+struct RawFrame {
+    int                  width  = 0;
+    int                  height = 0;
+    std::vector<uint8_t> rgba;
+
+    bool empty() const { return rgba.empty(); }
+
+    /**
+     * Read back an image on the calling thread (the only part that has
+     * to stay on the UI thread, since the image belongs to the backend)
+     */
+    static RawFrame fromImage(const dr4::Image *img);
+};
+
+/**
+ * Background PNG/Y4M writer fed through a bounded queue, so that
+ * compression and file IO never run on the UI thread
+ */
+class FrameEncoder {
+public:
+    enum Backpressure {
+        DROP,   // discard the frame if the queue is full
+        BLOCK,  // wait until the encoder catches up
+    };
+
+    enum SequenceFormat {
+        PNG_SEQUENCE,  // <base>_000000.png, <base>_000001.png, ...
+        Y4M_STREAM,    // single <base>.y4m, C444 planes
+    };
+
+    explicit FrameEncoder(size_t capacity = 8);
+    ~FrameEncoder();
+
+    FrameEncoder(const FrameEncoder &) = delete;
+    FrameEncoder &operator=(const FrameEncoder &) = delete;
+
+    /**
+     * One-off still; never dropped regardless of the queue size
+     */
+    void submitPNG(RawFrame &&frame, const std::string &path);
+
+    void startSequence(SequenceFormat fmt, const std::string &base, Backpressure bp, int fps = 30);
+    void stopSequence();
+
+    /**
+     * Queue the next frame of the running sequence.
+     * Returns false if not recording or the frame got dropped
+     */
+    bool submitSequenceFrame(RawFrame &&frame);
+
+    /**
+     * Same, reading the image back only once the frame is known to fit,
+     * so a dropped frame costs no readback
+     */
+    bool submitSequenceFrame(const dr4::Image *img);
+
+    bool   recording()     const { return seq_active_; }
+    size_t framesWritten() const { return written_.load(std::memory_order_relaxed); }
+    size_t framesDropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    enum JobKind {
+        JOB_PNG,
+        JOB_SEQ_BEGIN,
+        JOB_SEQ_FRAME,
+        JOB_SEQ_END,
+    };
+
+    struct Job {
+        JobKind        kind = JOB_PNG;
+        RawFrame       frame;
+        std::string    path;
+        SequenceFormat fmt = PNG_SEQUENCE;
+        int            fps = 30;
+    };
+
+    // ---- shared, guarded by mtx_ ----
+    SDL_Thread      *worker_;
+    SDL_Mutex       *mtx_;
+    SDL_Condition   *has_job_;
+    SDL_Condition   *has_space_;
+    std::deque<Job>  queue_;
+    size_t           capacity_;
+    size_t           queued_frames_;  // JOB_SEQ_FRAME entries in queue_
+    bool             stop_;
+
+    // ---- UI thread only ----
+    bool         seq_active_;
+    Backpressure seq_bp_;
+
+    // ---- worker thread only ----
+    SequenceFormat seq_fmt_;
+    std::string    seq_base_;
+    FILE          *seq_file_;
+    size_t         seq_index_;
+    bool           seq_sized_;  // size fixed, and the Y4M header is out
+    int            seq_w_, seq_h_;
+    std::vector<uint8_t> yuv_;
+
+    std::atomic<size_t> written_{0};
+    std::atomic<size_t> dropped_{0};
+
+    void push(Job &&job);
+    bool waitForRoom();
+    void pushFrame(RawFrame &&frame);
+
+    static int workerEntry(void *self_void);
+    void process(Job &job);
+
+    void beginSequence(const Job &job);
+    void writeSequenceFrame(const RawFrame &frame);
+    void endSequence();
+
+    bool writeY4MFrame(const RawFrame &frame);
+};
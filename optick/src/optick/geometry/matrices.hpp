@@ -23,16 +23,16 @@ public:
     }
 
     static Matrix zero() {
-        double data[H][W] = {0};
-        return Matrix(data);
+        double new_data[H][W] = {{0}};
+        return Matrix(new_data);
     }
 
     static Matrix<H, H> id() {
-        double data[H][H] = {0};
-        for (int i = 0; i < H; ++i) {
-            data[i][i] = 1.0;
+        double new_data[H][H] = {{0}};
+        for (unsigned int i = 0; i < H; ++i) {
+            new_data[i][i] = 1.0;
         }
-        return Matrix<H, H>(data);
+        return Matrix<H, H>(new_data);
     }
 
     double *mut_at(unsigned int row, unsigned int col) {
@@ -87,9 +87,19 @@ public:
                     }
                 }
             }
-            return Matrix<H, W>(new_data);
+            return Matrix<H, D>(new_data);
         }
 
+    Matrix<W, H> transposed() const {
+        double new_data[W][H];
+        for (unsigned int row = 0; row < H; ++row) {
+            for (unsigned int col = 0; col < W; ++col) {
+                new_data[col][row] = this->data[row][col];
+            }
+        }
+        return Matrix<W, H>(new_data);
+    }
+
     friend Matrix<H, W> operator*(double scalar, Matrix<H, W> matrix) {
         return matrix * scalar;
     }
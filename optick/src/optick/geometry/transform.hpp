@@ -0,0 +1,61 @@
+#pragma once
+#include <cmath>
+
+#include "./matrices.hpp"
+#include "./vectors.hpp"
+
+/**
+ * 3x3 helpers for the linear part of object transforms
+ */
+
+inline Vector3 operator*(const Mat3 &m, const Vector3 &v) {
+    return Vector3(
+        m.at(0, 0) * v.x + m.at(0, 1) * v.y + m.at(0, 2) * v.z,
+        m.at(1, 0) * v.x + m.at(1, 1) * v.y + m.at(1, 2) * v.z,
+        m.at(2, 0) * v.x + m.at(2, 1) * v.y + m.at(2, 2) * v.z
+    );
+}
+
+inline Mat3 mat3Scale(double sx, double sy, double sz) {
+    double data[3][3] = { { sx, 0, 0 }, { 0, sy, 0 }, { 0, 0, sz } };
+    return Mat3(data);
+}
+
+/**
+ * Rotation by `rad` around the unit axis `a` (Rodrigues)
+ */
+inline Mat3 mat3Rotation(const Vector3 &a, double rad) {
+    const double c = std::cos(rad), s = std::sin(rad), t = 1.0 - c;
+    double data[3][3] = {
+        { t * a.x * a.x + c,       t * a.x * a.y - s * a.z, t * a.x * a.z + s * a.y },
+        { t * a.x * a.y + s * a.z, t * a.y * a.y + c,       t * a.y * a.z - s * a.x },
+        { t * a.x * a.z - s * a.y, t * a.y * a.z + s * a.x, t * a.z * a.z + c       },
+    };
+    return Mat3(data);
+}
+
+inline double mat3Det(const Mat3 &m) {
+    return m.at(0, 0) * (m.at(1, 1) * m.at(2, 2) - m.at(1, 2) * m.at(2, 1))
+         - m.at(0, 1) * (m.at(1, 0) * m.at(2, 2) - m.at(1, 2) * m.at(2, 0))
+         + m.at(0, 2) * (m.at(1, 0) * m.at(2, 1) - m.at(1, 1) * m.at(2, 0));
+}
+
+/**
+ * false (and `out` untouched) if `m` is singular
+ */
+inline bool mat3Inverse(const Mat3 &m, Mat3 *out) {
+    const double det = mat3Det(m);
+    if (std::fabs(det) < 1e-18) return false;
+
+    // adjugate / det, cofactors via cyclic indices
+    double data[3][3];
+    for (unsigned int row = 0; row < 3; ++row) {
+        for (unsigned int col = 0; col < 3; ++col) {
+            const unsigned int r0 = (col + 1) % 3, r1 = (col + 2) % 3;
+            const unsigned int c0 = (row + 1) % 3, c1 = (row + 2) % 3;
+            data[row][col] = (m.at(r0, c0) * m.at(r1, c1) - m.at(r0, c1) * m.at(r1, c0)) / det;
+        }
+    }
+    *out = Mat3(data);
+    return true;
+}
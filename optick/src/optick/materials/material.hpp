@@ -1,4 +1,5 @@
 #pragma once
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -26,6 +27,12 @@ public:
     virtual opt::Color emission()   const { return opt::Color(0, 0, 0); }
 };
 
+/**
+ * Materials are shared between objects (and between instances of one
+ * asset), the last object holding one frees it
+ */
+typedef std::shared_ptr<Material> MaterialRef;
+
 class MaterialReflective : public Material {
 public:
     MaterialReflective() : Material() {}
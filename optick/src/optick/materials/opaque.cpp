@@ -16,7 +16,7 @@ opt::Color MaterialOpaque::sample(TraceContext ctx) const {
         double  dist  = std::sqrt(dist2);
         Vector3 Ldir  = Lvec / dist;
 
-        if (ctx.scene->occludedTowards(ctx.hit.pos, Ldir, dist, ctx.eps, obj)) continue;
+        if (ctx.scene->occludedTowards(ctx.hit.pos, Ldir, dist, ctx.eps, oi, ctx.shadow)) continue;
 
         // incoming radiance estimate with 1/(4πr^2) falloff
         opt::Color Lradiance = Le * (power / (4.0 * M_PI * dist2));
@@ -17,13 +17,13 @@ opt::Color MaterialRefractive::sample(TraceContext ctx) const {
 
     Vector3 T;  // refracted direction
     if (T.refract(ctx.ray.d, N, etai, etat)) {
-        opt::Color inc_clr = ctx.scene->trace(Ray(ctx.hit.pos + T * ctx.eps, T), ctx.depth + 1, ctx.max_depth, ctx.eps);
+        opt::Color inc_clr = ctx.scene->trace(Ray(ctx.hit.pos + T * ctx.eps, T), ctx.depth + 1, ctx.max_depth, ctx.eps, ctx.shadow);
         return ctx.target->color * inc_clr;
     }
     else // TIR
     {
         Vector3 R = Vector3::reflect(ctx.ray.d, ctx.hit.norm);
-        opt::Color inc_clr = ctx.scene->trace(Ray(ctx.hit.pos + R * ctx.eps, R), ctx.depth + 1, ctx.max_depth, ctx.eps);
+        opt::Color inc_clr = ctx.scene->trace(Ray(ctx.hit.pos + R * ctx.eps, R), ctx.depth + 1, ctx.max_depth, ctx.eps, ctx.shadow);
         return ctx.target->color * inc_clr;
     }
 }
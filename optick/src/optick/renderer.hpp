@@ -1,5 +1,6 @@
 #pragma once
 #include <atomic>
+#include <cstdlib>
 #include <memory>
 #include <chrono>
 #include <sstream>
@@ -16,51 +17,15 @@
 #include <dr4/math/color.hpp>
 #include <dr4/texture.hpp>
 
+#include "./farm/coordinator.hpp"
+#include "./farm/scene_codec.hpp"
+#include "./frame_encoder.hpp"
 #include "./trace/camera.hpp"
 #include "./trace/scene.hpp"
 #include "./widgets/canvas.hpp"
 #include "./widgets/canvas_toolbar.hpp"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_STATIC
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
-#pragma GCC diagnostic ignored "-Wmissing-declarations"
-#pragma GCC diagnostic ignored "-Wunused-function"
-#include "./widgets/stb_image_write.h"
-#pragma GCC diagnostic pop
-
-static bool SaveImageAsPNG(const dr4::Image *img, const std::string &path) {
-    if (!img) return false;
-
-    const size_t w = static_cast<size_t>(img->GetWidth());
-    const size_t h = static_cast<size_t>(img->GetHeight());
-    if (!w || !h) return false;
-
-    std::vector<unsigned char> px(w * h * 4);
-
-    for (size_t y = 0; y < h; ++y) {
-        for (size_t x = 0; x < w; ++x) {
-            dr4::Color c = img->GetPixel(x, y);
-            const size_t i = (y * w + x) * 4;
-            px[i + 0] = c.r;
-            px[i + 1] = c.g;
-            px[i + 2] = c.b;
-            px[i + 3] = c.a;
-        }
-    }
-
-    return stbi_write_png(
-        path.c_str(),
-        static_cast<int>(w),
-        static_cast<int>(h),
-        4,
-        px.data(),
-        static_cast<int>(w * 4)
-    ) != 0;
-}
-
-static std::string MakeTimestampedName() {
+static std::string MakeTimestampedName(const char *prefix = "canvas_", const char *ext = ".png") {
     using namespace std::chrono;
     auto now = system_clock::now();
     std::time_t t = system_clock::to_time_t(now);
@@ -69,9 +34,9 @@ static std::string MakeTimestampedName() {
     localtime_r(&t, &tm);
 
     std::ostringstream ss;
-    ss << "canvas_"
+    ss << prefix
        << std::put_time(&tm, "%Y%m%d_%H%M%S")
-       << ".png";
+       << ext;
     return ss.str();
 }
 
@@ -93,18 +58,18 @@ static inline void shuffle(std::vector<int> &a, unsigned &state) {
 static inline Scene makeDemoScene() {
     Scene scn;
 
-    MaterialOpaque *ground_plane = new MaterialOpaque(/*kd*/0.9);
+    auto ground_plane = std::make_shared<MaterialOpaque>(/*kd*/0.9);
     scn.objects.push_back(new Plane("ground",
         Vector3(0, -4, 0), Vector3(0, 1, 0),
         opt::Color(0.9, 0.9, 0.9),
         ground_plane
     ));
 
-    MaterialOpaque *normal = new MaterialOpaque(/*kd*/1.0, /*ks*/1.0, /*shininess*/32);
+    auto normal = std::make_shared<MaterialOpaque>(/*kd*/1.0, /*ks*/1.0, /*shininess*/32);
     const Vector3 verts[] = { Vector3(-10, -5, -10), Vector3(-8, -2, -10), Vector3(-11, -1, -10) };
     scn.objects.push_back(new Polygon("triangle", std::vector<Vector3>(verts, verts + 3), opt::Color(1.0, 1.0, 1.0), normal));
 
-    MaterialRefractive *poly_glass = new MaterialRefractive(/*ior*/1.5);
+    auto poly_glass = std::make_shared<MaterialRefractive>(/*ior*/1.5);
     scn.objects.push_back(new Tetrahedron("glass tetra",
         Vector3(-6.0, -1.0, -9.5),
         Vector3(-4.8, -1.0, -9.6),
@@ -114,43 +79,55 @@ static inline Scene makeDemoScene() {
         poly_glass
     ));
 
-    MaterialOpaque *solid = new MaterialOpaque(/*kd*/1.0, /*ks*/1.0, /*shininess*/32);
+    auto solid = std::make_shared<MaterialOpaque>(/*kd*/1.0, /*ks*/1.0, /*shininess*/32);
     scn.objects.push_back(new Sphere("red ball",
         Vector3(-1.5, -0.2, -5), 0.7,
         opt::Color(1, 0, 0),
         solid
     ));
 
-    MaterialReflective *mirror = new MaterialReflective();
+    auto mirror = std::make_shared<MaterialReflective>();
     scn.objects.push_back(new Sphere("mirror",
         Vector3(-1.5, -0.2, -3.5), 0.8,
         opt::Color(0.9, 0.8, 0.7),
         mirror
     ));
 
-    MaterialReflective *mirror2 = new MaterialReflective();
+    auto mirror2 = std::make_shared<MaterialReflective>();
     scn.objects.push_back(new Sphere("big mirror",
         Vector3(6, 0, -25), 10,
         opt::Color(0, 1, 1),
         mirror2
     ));
 
-    MaterialRefractive *glass = new MaterialRefractive(/*ior*/1.5);
+    auto glass = std::make_shared<MaterialRefractive>(/*ior*/1.5);
     scn.objects.push_back(new Sphere("clear glass",
         Vector3(0.2, 0.0, -2.5), 0.6,
         opt::Color(0.95, 1.0, 1.0),
         glass
     ));
 
-    MaterialRefractive *water_glass = new MaterialRefractive(/*ior*/1.33);
+    auto water_glass = std::make_shared<MaterialRefractive>(/*ior*/1.33);
     scn.objects.push_back(new Sphere("tinted water glass",
         Vector3(1.2, -0.1, -3.0), 0.7,
         opt::Color(0.7, 0.9, 1.0),
         water_glass
     ));
 
+    // a handful of pebbles sharing one unit sphere and one material
+    std::shared_ptr<const Object> pebble(new Sphere("pebble", Vector3(0, 0, 0), 1.0, opt::Color(1, 1, 1), nullptr));
+    auto stone = std::make_shared<MaterialOpaque>(/*kd*/0.8, /*ks*/0.2, /*shininess*/16);
+    for (int i = 0; i < 5; ++i) {
+        const Mat3 lin = mat3Rotation(Vector3(0, 1, 0), 0.7 * i) * mat3Scale(0.35, 0.18, 0.25);
+        scn.objects.push_back(new Instance("pebble " + std::to_string(i + 1), pebble,
+            Vector3(-3.0 + 0.9 * i, -1.2, -4.5 - 0.3 * (i % 2)), lin,
+            opt::Color(0.55 + 0.08 * i, 0.5, 0.45),
+            stone
+        ));
+    }
+
     // Lights
-    MaterialEmissive *glowing = new MaterialEmissive(opt::Color(1.0, 1.0, 1.0));
+    auto glowing = std::make_shared<MaterialEmissive>(opt::Color(1.0, 1.0, 1.0));
     scn.objects.push_back(new Sphere("glowing 1",
         Vector3(-2, 2.5, -1.5), 0.25,
         opt::Color(1, 1, 1),  // tint
@@ -167,7 +144,7 @@ static inline Scene makeDemoScene() {
 
 #define N_WORKERS 4
 
-class Renderer final : public Widget {
+class Renderer final : public Widget, private farm::TileSource {
     Scene  scene;
     Camera cam;
 
@@ -187,6 +164,9 @@ class Renderer final : public Widget {
     bool job_has_work;    // a frame is active
     int  job_width, job_height;
     int  job_next_tile;   // next index into tile_order
+    unsigned job_frame;   // bumped per frame, stale farm results are dropped
+
+    std::vector<int> job_retry;  // tiles given back by a lost farm worker
 
     enum { TILE = 16 };
 
@@ -195,6 +175,12 @@ class Renderer final : public Widget {
 
     std::atomic<bool> tiles_need_present{false};
 
+    // shadow cache counters, workers flush theirs after every tile
+    std::atomic<uint64_t> shadow_queries{0};
+    std::atomic<uint64_t> shadow_hits{0};
+    uint64_t last_shadow_queries = 0;  // of the last completed frame
+    uint64_t last_shadow_hits    = 0;
+
     std::unique_ptr<std::atomic<uint8_t>[]> tile_done;
     std::vector<uint8_t>                    tile_uploaded;
     std::vector<int>                        tile_order;
@@ -203,6 +189,10 @@ class Renderer final : public Widget {
 
     static int workerEntry(void *self_void);
 
+    FrameEncoder encoder;  // PNG/Y4M writes off the UI thread
+
+    farm::Coordinator *farm_ = nullptr;  // remote render workers, if OPTICK_FARM is set
+
     cum::Manager *mgr;
     bool alive = true;
     Canvas *canvas = nullptr;
@@ -241,9 +231,83 @@ class Renderer final : public Widget {
         job_width     = back_img->GetWidth();
         job_height    = back_img->GetHeight();
         job_has_work  = true;
+        job_retry.clear();
+        const unsigned frame = ++job_frame;
 
         SDL_BroadcastCondition(job_cv);
         SDL_UnlockMutex(job_mtx);
+
+        if (farm_) {
+            farm_->beginFrame(frame, encodeScene(scene, cam), job_width, job_height, max_depth, eps);
+        }
+    }
+
+    /**
+     * Pop the next tile of the running frame, given back ones first.
+     * Caller holds job_mtx
+     */
+    bool nextTileLocked(int *tile_id) {
+        if (!job_has_work) return false;
+        if (!job_retry.empty()) {
+            *tile_id = job_retry.back();
+            job_retry.pop_back();
+            return true;
+        }
+        if (job_next_tile >= num_tiles) return false;
+        *tile_id = tile_order[job_next_tile++];
+        return true;
+    }
+
+    bool hasTileLocked() const {
+        return job_has_work && (!job_retry.empty() || job_next_tile < num_tiles);
+    }
+
+    void tileRect(int tile_id, int *x0, int *y0, int *x1, int *y1) const {
+        const int tx = tile_id % tile_w;
+        const int ty = tile_id / tile_w;
+        *x0 = tx * TILE;
+        *y0 = ty * TILE;
+        *x1 = std::min(*x0 + TILE, job_width);
+        *y1 = std::min(*y0 + TILE, job_height);
+    }
+
+    // ---- farm::TileSource, called from the farm thread ----
+
+    bool takeTile(unsigned frame, int *tile, int *x0, int *y0, int *x1, int *y1) override {
+        SDL_LockMutex(job_mtx);
+        const bool ok = frame == job_frame && nextTileLocked(tile);
+        if (ok) tileRect(*tile, x0, y0, x1, y1);
+        SDL_UnlockMutex(job_mtx);
+        return ok;
+    }
+
+    void giveBackTile(unsigned frame, int tile) override {
+        SDL_LockMutex(job_mtx);
+        if (frame == job_frame && !tile_done[tile].load(std::memory_order_acquire)) {
+            job_retry.push_back(tile);
+            SDL_BroadcastCondition(job_cv);
+        }
+        SDL_UnlockMutex(job_mtx);
+    }
+
+    void storeTile(unsigned frame, int tile, int x0, int y0, int x1, int y1, const uint8_t *rgba) override {
+        SDL_LockMutex(job_mtx);
+        int ex0, ey0, ex1, ey1;
+        if (frame == job_frame && tile >= 0 && tile < num_tiles) {
+            tileRect(tile, &ex0, &ey0, &ex1, &ey1);
+            // held across the copy, so a resize can't swap back_img underneath
+            if (ex0 == x0 && ey0 == y0 && ex1 == x1 && ey1 == y1
+                    && !tile_done[tile].load(std::memory_order_acquire)) {
+                for (int y = y0; y < y1; ++y) {
+                    for (int x = x0; x < x1; ++x, rgba += 4) {
+                        back_img->SetPixel(x, y, dr4::Color(rgba[0], rgba[1], rgba[2], rgba[3]));
+                    }
+                }
+                tile_done[tile].store(1, std::memory_order_release);
+                tiles_need_present.store(true, std::memory_order_release);
+            }
+        }
+        SDL_UnlockMutex(job_mtx);
     }
 
     void stopWorkers() {
@@ -284,21 +348,28 @@ class Renderer final : public Widget {
         if (initialized && vw == front_img->GetWidth() && vh == front_img->GetHeight()) return;
 
         if (front_img) { delete front_img; front_img = nullptr; }
-        if (back_img)  { delete back_img;  back_img  = nullptr; }
 
         front_img = state->window->CreateImage();
         front_img->SetSize({static_cast<float>(vw), static_cast<float>(vh)});
         front_img->SetPos({0, 0});
 
+        // storeTile writes back_img from the farm thread under job_mtx; the
+        // new frame number turns away results still coming for the old size
+        SDL_LockMutex(job_mtx);
+        if (back_img) { delete back_img; back_img = nullptr; }
+
         back_img = state->window->CreateImage();
         back_img->SetSize({static_cast<float>(vw), static_cast<float>(vh)});
         back_img->SetPos({0, 0});
 
+        buildTiles();
+        job_has_work = false;
+        ++job_frame;
+        SDL_UnlockMutex(job_mtx);
+
         if (!texture) texture = state->window->CreateTexture();
         texture->SetSize({static_cast<float>(vw), static_cast<float>(vh)});
 
-        buildTiles();
-
         cam = Camera(Vector3(0, 2, 2.5), 45.0, vw, vh);
         max_depth = 5;
         eps = 1e-4;
@@ -325,12 +396,21 @@ public:
         job_stop     = false;
         job_has_work = false;
         job_width    = job_height = 0;
+        job_frame    = 0;
 
         for (int i = 0; i < N_WORKERS; ++i)
             workers[i] = SDL_CreateThread(Renderer::workerEntry, "rt_worker", this);
+
+        // e.g. OPTICK_FARM=unix:/tmp/optick-farm.sock, then run bin/render-worker on it
+        if (const char *addr = std::getenv("OPTICK_FARM")) {
+            farm_ = farm::Coordinator::listen(addr, this);
+        }
     }
 
     ~Renderer() {
+        delete farm_;  // before the workers, it calls back into us
+        farm_ = nullptr;
+
         stopWorkers();
         for (int i = 0; i < N_WORKERS; ++i)
             SDL_DetachThread(workers[i]);
@@ -351,6 +431,17 @@ public:
         return &cam;
     }
 
+    /**
+     * Shadow occluder cache hit rate over the last completed frame, 0..1
+     */
+    double shadowCacheHitRate() const {
+        if (!last_shadow_queries) return 0.0;
+        return (double)last_shadow_hits / (double)last_shadow_queries;
+    }
+
+    uint64_t shadowCacheQueries() const { return last_shadow_queries; }
+    uint64_t shadowCacheHits()    const { return last_shadow_hits; }
+
     void drawWireframe(
             const AABB &bbox,
             int view_w, int view_h,
@@ -481,15 +572,41 @@ public:
         }
 
         if (auto *img = texture->GetImage()) {
-            SaveImageAsPNG(img, MakeTimestampedName());
+            encoder.submitPNG(RawFrame::fromImage(img), MakeTimestampedName());
+            delete img;
         }
     }
 
+    bool isRecording() const {
+        return encoder.recording();
+    }
+
+    /**
+     * Record every completed frame; DROP keeps interaction smooth if
+     * the encoder falls behind
+     */
+    void toggleRecording(
+            FrameEncoder::SequenceFormat fmt = FrameEncoder::PNG_SEQUENCE,
+            FrameEncoder::Backpressure bp = FrameEncoder::DROP
+    ) {
+        if (encoder.recording()) {
+            encoder.stopSequence();
+            printf("[debug] recording stopped: %zu written, %zu dropped\n",
+                   encoder.framesWritten(), encoder.framesDropped());
+            return;
+        }
+        encoder.startSequence(fmt, MakeTimestampedName("turntable_", ""), bp);
+    }
+
     DispatchResult onKeyDown(DispatcherCtx, const KeyDownEvent *e) override {
         if ((e->mods & dr4::KEYMOD_CTRL) && e->keycode == dr4::KEYCODE_P) {
             captureScreenshot();
             return CONSUME;
         }
+        if ((e->mods & dr4::KEYMOD_CTRL) && e->keycode == dr4::KEYCODE_R) {
+            toggleRecording((e->mods & dr4::KEYMOD_SHIFT) ? FrameEncoder::Y4M_STREAM : FrameEncoder::PNG_SEQUENCE);
+            return CONSUME;
+        }
         return PROPAGATE;
     }
 
@@ -533,9 +650,15 @@ public:
         bool all_uploaded = true;
         for (uint8_t u : tile_uploaded) { if (!u) { all_uploaded = false; break; } }
         if (all_uploaded) {
+            if (encoder.recording()) {
+                encoder.submitSequenceFrame(front_img);
+            }
+
+            last_shadow_queries = shadow_queries.exchange(0, std::memory_order_relaxed);
+            last_shadow_hits    = shadow_hits.exchange(0, std::memory_order_relaxed);
+
             scene.objects[3]->center.x += 0.05f;
 
-            buildTiles();
             startFrameJobs();
             requestRedraw();
         }
@@ -548,13 +671,12 @@ public:
 inline int Renderer::workerEntry(void *self_void) {
     Renderer *self = static_cast<Renderer*>(self_void);
 
+    ShadowCache shadow;  // tiles are compact, so it stays warm across pixels
+
     for (;;) {
         // take a tile
         SDL_LockMutex(self->job_mtx);
-        while (
-                !self->job_stop &&
-               (!self->job_has_work || self->job_next_tile >= self->num_tiles)
-        ) {
+        while (!self->job_stop && !self->hasTileLocked()) {
             SDL_WaitCondition(self->job_cv, self->job_mtx);
         }
 
@@ -563,30 +685,23 @@ inline int Renderer::workerEntry(void *self_void) {
             break;
         }
 
-        // if all tiles already taken, loop to wait for next frame
-        if (self->job_next_tile >= self->num_tiles) {
+        int tile_id = -1;
+        if (!self->nextTileLocked(&tile_id)) {
             SDL_UnlockMutex(self->job_mtx);
             continue;
         }
 
-        const int ord_idx = self->job_next_tile++;
-        const int tile_id = self->tile_order[ord_idx];
+        // tile coords
+        int x0, y0, x1, y1;
+        self->tileRect(tile_id, &x0, &y0, &x1, &y1);
 
         SDL_UnlockMutex(self->job_mtx);
 
-        // tile coords
-        const int tx = tile_id % self->tile_w;
-        const int ty = tile_id / self->tile_w;
-        const int x0 = tx * TILE;
-        const int y0 = ty * TILE;
-        const int x1 = std::min(x0 + TILE, self->job_width);
-        const int y1 = std::min(y0 + TILE, self->job_height);
-
         // render the tile into buf
         for (int y = y0; y < y1; ++y) {
             for (int x = x0; x < x1; ++x) {
                 Ray pr = Ray::primary(self->cam, x, y, self->job_width, self->job_height);
-                opt::Color c = self->scene.trace(pr, 0, self->max_depth, self->eps);
+                opt::Color c = self->scene.trace(pr, 0, self->max_depth, self->eps, &shadow);
                 self->back_img->SetPixel(x, y, dr4::Color(
                     opt::Color::encode(c.r),
                     opt::Color::encode(c.g),
@@ -596,6 +711,10 @@ inline int Renderer::workerEntry(void *self_void) {
             }
         }
 
+        self->shadow_queries.fetch_add(shadow.queries, std::memory_order_relaxed);
+        self->shadow_hits.fetch_add(shadow.hits, std::memory_order_relaxed);
+        shadow.queries = shadow.hits = 0;
+
         self->tile_done[tile_id].store(1, std::memory_order_release);
         self->tiles_need_present.store(true, std::memory_order_release);
     }
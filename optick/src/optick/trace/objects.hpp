@@ -1,9 +1,11 @@
 #pragma once
 #include <array>
 #include <cmath>
+#include <memory>
 #include <vector>
 #include <string>
 
+#include "../geometry/transform.hpp"
 #include "../materials/material.hpp"
 #include "./common.hpp"
 
@@ -46,14 +48,14 @@ public:
     opt::Color   color;
     string  name;
 
-    Material *mat;
+    MaterialRef mat;
 
-    Object(string name_, const Vector3 &pos, const opt::Color &col, Material *m)
+    Object(string name_, const Vector3 &pos, const opt::Color &col, MaterialRef m)
         : is_selected(false)
         , center(pos)
         , color(col)
         , name(name_)
-        , mat(m) {}
+        , mat(std::move(m)) {}
 
     virtual ~Object() {};
 
@@ -89,8 +91,8 @@ public:
 struct Sphere : public Object {
     double radius;
 
-    Sphere(string name_, const Vector3 &c, double r, const opt::Color &col, Material *m)
-        : Object(name_, c, col, m), radius(r) {}
+    Sphere(string name_, const Vector3 &c, double r, const opt::Color &col, MaterialRef m)
+        : Object(name_, c, col, std::move(m)), radius(r) {}
 
     /**
      * Ray-sphere intersection using stable quadratic form
@@ -146,8 +148,8 @@ struct Plane : public Object {
           const Vector3 &point_on_plane,
           const Vector3 &n,
           const opt::Color &col,
-          Material *m)
-        : Object(name_, point_on_plane, col, m), normal(!n) {}
+          MaterialRef m)
+        : Object(name_, point_on_plane, col, std::move(m)), normal(!n) {}
 
     bool intersect(const Ray &ray, double eps, Hit *hit) const {
         const double denom = ray.d ^ normal;
@@ -185,8 +187,8 @@ struct Polygon : public Object {
     Vector3 u, v;  // orthonormal (u,v,normal)
     std::vector<Vec2> verts2;  // projected onto (u,v)
 
-    Polygon(string name_, const std::vector<Vector3> &verts, const opt::Color &col, Material *m)
-            : Object(name_, Vector3(0, 0, 0), col, m)
+    Polygon(string name_, const std::vector<Vector3> &verts, const opt::Color &col, MaterialRef m)
+            : Object(name_, Vector3(0, 0, 0), col, std::move(m))
             , verts3(verts)
             , normal(0, 1, 0)
             , u(1, 0, 0)
@@ -304,8 +306,8 @@ struct Tetrahedron : public Object {
                 const Vector3 &v2,
                 const Vector3 &v3,
                 const opt::Color &col,
-                Material *m)
-        : Object(std::move(name_), Vector3(0,0,0), col, m)
+                MaterialRef m)
+        : Object(std::move(name_), Vector3(0,0,0), col, std::move(m))
         , v{v0, v1, v2, v3}
         , f{{
             {{0,1,2}},
@@ -390,3 +392,85 @@ struct Tetrahedron : public Object {
         return out->isValid();
     }
 };
+
+/**
+ * Shared geometry placed in the world by a transform: rays are taken into
+ * the prototype's local space instead of copying the geometry out of it.
+ * `center` is the translation, so moving an instance works as for any
+ * other object. The prototype's own material and color are not used
+ */
+struct Instance : public Object {
+    std::shared_ptr<const Object> proto;
+
+    Instance(string name_,
+             std::shared_ptr<const Object> geom,
+             const Vector3 &pos,
+             const Mat3 &lin,
+             const opt::Color &col,
+             MaterialRef m)
+        : Object(std::move(name_), pos, col, std::move(m))
+        , proto(std::move(geom))
+        , linear(Mat3::id())
+        , inv_linear(Mat3::id())
+        , normal_mat(Mat3::id())
+        , singular(false)
+    {
+        setLinear(lin);
+    }
+
+    const Mat3 &getLinear() const {
+        return linear;
+    }
+
+    /**
+     * Rotation/scale part, local -> world. A singular one hides the instance
+     */
+    void setLinear(const Mat3 &lin) {
+        linear   = lin;
+        singular = !mat3Inverse(lin, &inv_linear);
+        if (!singular) normal_mat = inv_linear.transposed();
+    }
+
+    bool intersect(const Ray &ray, double eps, Hit *hit) const override {
+        if (singular) return false;
+
+        const Vector3 lo = inv_linear * (ray.o - center);
+        const Vector3 ld = inv_linear * ray.d;
+
+        // local distances are `scale` times the world ones along this ray
+        const double scale = ld.length();
+        if (scale < 1e-12) return false;
+
+        Hit lh;
+        if (!proto->intersect(Ray(lo, ld), eps * scale, &lh)) return false;
+
+        const double t = lh.dist / scale;
+        hit->pos  = ray.o + ray.d * t;
+        hit->norm = !(normal_mat * lh.norm);
+        hit->dist = t;
+        return true;
+    }
+
+    bool worldAABB(AABB *out) const override {
+        AABB local;
+        if (singular || !proto->worldAABB(&local)) return false;
+
+        AABB box;
+        for (int i = 0; i < 8; ++i) {
+            const Vector3 corner(
+                (i & 1) ? local.mx.x : local.mn.x,
+                (i & 2) ? local.mx.y : local.mn.y,
+                (i & 4) ? local.mx.z : local.mn.z
+            );
+            box.include(linear * corner + center);
+        }
+        *out = box;
+        return out->isValid();
+    }
+
+private:
+    Mat3 linear;
+    Mat3 inv_linear;  // world -> local
+    Mat3 normal_mat;  // inverse transpose of `linear`
+    bool singular;
+};
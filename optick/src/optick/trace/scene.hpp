@@ -1,10 +1,28 @@
 #pragma once
+#include <stdint.h>
 #include <vector>
 
 #include "./objects.hpp"
 
 struct Scene;
 
+/**
+ * Per-worker memo of the object that last blocked each light: neighbouring
+ * shadow rays of a tile are almost always blocked by the same one
+ */
+struct ShadowCache {
+    std::vector<const Object*> last_occluder;  // indexed by light object index
+
+    uint64_t queries;  // shadow rays answered through the cache
+    uint64_t hits;     // ... of which the cached occluder settled
+
+    ShadowCache() : queries(0), hits(0) {}
+
+    void fit(size_t n_objects) {
+        if (last_occluder.size() != n_objects) last_occluder.assign(n_objects, NULL);
+    }
+};
+
 struct TraceContext {
     double  eps;
     int     depth;
@@ -14,8 +32,10 @@ struct TraceContext {
     Object *target;
     Scene  *scene;
 
-    TraceContext(double eps_, int depth_, int max_depth_, Ray ray_, Hit hit_, Object *target_, Scene *scene_)
-        : eps(eps_), depth(depth_), max_depth(max_depth_), ray(ray_), hit(hit_), target(target_), scene(scene_) {}
+    ShadowCache *shadow;  // owned by the worker, may be NULL
+
+    TraceContext(double eps_, int depth_, int max_depth_, Ray ray_, Hit hit_, Object *target_, Scene *scene_, ShadowCache *shadow_ = NULL)
+        : eps(eps_), depth(depth_), max_depth(max_depth_), ray(ray_), hit(hit_), target(target_), scene(scene_), shadow(shadow_) {}
 };
 
 struct Scene {
@@ -58,29 +78,77 @@ struct Scene {
                 const Object *target_light_geom) const
     {
         Ray sray(p + to_light * eps, to_light);
-        const Object* first_obj = NULL;
-        Hit h_first;
+        const Object *first_obj = firstHit(sray, max_dist, eps);
+
+        if (!first_obj) return false;  // nothing in the way
+        if (first_obj == target_light_geom) return false;  // hit the light
+        return true;  // some other geometry blocks
+    }
+
+    /**
+     * Same answer as above, but tries the light's last occluder first
+     */
+    bool occludedTowards(
+                const Vector3 &p,
+                const Vector3 &to_light,
+                double max_dist,
+                double eps,
+                size_t light_i,
+                ShadowCache *cache) const
+    {
+        const Object *light = objects[light_i];
+        if (!cache) return occludedTowards(p, to_light, max_dist, eps, light);
+
+        cache->fit(objects.size());
+        ++cache->queries;
+
+        Ray sray(p + to_light * eps, to_light);
+
+        const Object *cached = cache->last_occluder[light_i];
+        if (cached) {
+            Hit h;
+            if (cached->intersect(sray, eps, &h) && h.dist < max_dist) {
+                // the full search would see the light first if its surface is closer
+                Hit hl;
+                if (!light->intersect(sray, eps, &hl) || h.dist < hl.dist) {
+                    ++cache->hits;
+                    return true;
+                }
+            }
+        }
+
+        const Object *first_obj = firstHit(sray, max_dist, eps);
+
+        if (!first_obj) return false;
+        if (first_obj == light) return false;
+
+        cache->last_occluder[light_i] = first_obj;
+        return true;
+    }
+
+    /**
+     * Closest object along the ray within max_dist, NULL if none
+     */
+    const Object *firstHit(const Ray &ray, double max_dist, double eps) const {
+        const Object *first_obj = NULL;
 
         double closest = max_dist;
         for (size_t i = 0; i < objects.size(); ++i) {
             Hit h;
-            if (!objects[i]->intersect(sray, eps, &h)) continue;
+            if (!objects[i]->intersect(ray, eps, &h)) continue;
             if (h.dist < closest) {
                 closest = h.dist;
                 first_obj = objects[i];
-                h_first = h;
             }
         }
 
-        if (!first_obj) return false;  // nothing in the way
-        if (first_obj == target_light_geom) return false;  // hit the light
-        return true;  // some other geometry blocks
+        return first_obj;
     }
 
     /**
      * Recursively trace a ray and shade based on materials
      */
-    inline opt::Color trace(const Ray &ray, int depth, int max_depth, double eps) {
+    inline opt::Color trace(const Ray &ray, int depth, int max_depth, double eps, ShadowCache *shadow = NULL) {
         if (depth > max_depth) return opt::Color(0, 0, 0);
 
         // find closest hit
@@ -100,7 +168,7 @@ struct Scene {
 
         Object *sp = this->objects[hit.obj_i];
 
-        TraceContext ctx = TraceContext(eps, depth, max_depth, ray, hit, sp, this);
+        TraceContext ctx = TraceContext(eps, depth, max_depth, ray, hit, sp, this, shadow);
         return sp->mat->sample(ctx);
     }
 };
@@ -30,6 +30,13 @@ void ScreenshotAction::apply(void *, Widget *) {
     }
 }
 
+void ToggleRecordingAction::apply(void *, Widget *) {
+    if (!root_) return;
+    if (auto *r = root_->findDescendant<Renderer>()) {
+        r->toggleRecording();
+    }
+}
+
 void TogglePropertiesPanelAction::apply(void *, Widget *) {
     if (root_) root_->togglePropertiesView();
 }
@@ -49,6 +56,7 @@ void ToggleFileDropdownAction::apply(void *, Widget *target) {
 
     std::vector<MenuItemDesc> items;
     items.push_back({ "Screenshot", new ScreenshotAction(root_),        true });
+    items.push_back({ "Record",     new ToggleRecordingAction(root_),   true });
     items.push_back({ "Annotate",   new ToggleRender(root_),            true });
     items.push_back({ "Theme",      new ToggleThemePickerAction(root_), canvasActive });
 
@@ -18,6 +18,14 @@ public:
     void apply(void *, Widget *) override;
 };
 
+class ToggleRecordingAction final : public Action {
+    Desktop *root_;
+
+public:
+    ToggleRecordingAction(Desktop *r) : root_(r) {}
+    void apply(void *, Widget *) override;
+};
+
 class LaunchObjView : public Action {
     Desktop *root;
     State   *state;
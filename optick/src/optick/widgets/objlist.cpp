@@ -1,23 +1,22 @@
 #include "./objlist.hpp"
 #include "./desktop.hpp"
 
-void ObjectsList::toggleSelect(ObjectPreview *preview) {
-    bool toggled = preview->obj->toggleSelect();
+void ObjectsList::toggleSelect(Object *obj) {
+    bool toggled = obj->toggleSelect();
 
     if (toggled) {
-        if (selected) {
-            selected->obj->unselect();
-            selected->requestRedraw();
-        }
+        if (selected) selected->unselect();
         ObjectView *v = root->findChild<ObjectView>();
-        if (v) v->populate(preview);
-        selected = preview;
+        if (v) v->populate(obj);
+        selected = obj;
     } else {
-        assert(selected == preview);
+        assert(selected == obj);
         assert(selected != NULL);
-        selected->obj->unselect();
+        selected->unselect();
         ObjectView *v = root->findChild<ObjectView>();
         if (v) v->unpopulate();
         selected = NULL;
     }
+
+    redrawRows();
 }
@@ -1,13 +1,25 @@
 #pragma once
 #include <cassert>
+#include <cctype>
+#include <string>
 
 #include <swuix/traits/scrollable.hpp>
 #include <swuix/widgets/scrollbar.hpp>
 #include <swuix/widgets/button.hpp>
+#include <swuix/widgets/textinput.hpp>
 
 #include "../trace/objects.hpp"
 #include "./objview.hpp"
 
+const float OBJLIST_PAD      = 5.0f;
+const float OBJLIST_ROW_H    = 30.0f;
+const float OBJLIST_ROW_STEP = 35.0f;
+const float OBJLIST_SEARCH_H = 24.0f;
+const float OBJLIST_HEADER_H = OBJLIST_PAD + OBJLIST_SEARCH_H + OBJLIST_PAD;
+
+// rows kept alive above and below the viewport
+const size_t OBJLIST_ROW_MARGIN = 2;
+
 class ObjectPreview;
 class ObjectsList;
 
@@ -20,18 +32,20 @@ public:
     void apply(void *, Widget *);
 };
 
+/**
+ * A recycled row of the objects list; rebound to whatever object
+ * currently scrolls into its slot
+ */
 class ObjectPreview final : public Widget {
     friend class ObjectsList;
-    friend class ObjectView;
-    friend class ObjectViewName;
 
-    Object *obj;
+    Object *obj = nullptr;
 
     Button *selectBtn_ = nullptr;
 
 public:
-    ObjectPreview(Object *o, ObjectsList *l, Rect2f f, Widget *p, State *s)
-        : Widget(f, p, s), obj(o)
+    ObjectPreview(ObjectsList *l, Rect2f f, Widget *p, State *s)
+        : Widget(f, p, s)
     {
         selectBtn_ = new Button(
             {f.size.x - 75, 5, 70, f.size.y - 10},
@@ -43,9 +57,17 @@ public:
         appendChild(selectBtn_);
     }
 
-	const char *title() const override {
-		return obj->name.c_str();
-	}
+    const char *title() const override {
+        return obj ? obj->name.c_str() : "";
+    }
+
+    Object *object() const { return obj; }
+
+    void bind(Object *o) {
+        if (obj == o) return;
+        obj = o;
+        requestRedraw();
+    }
 
     void layout() override {
         if (!selectBtn_) return;
@@ -57,6 +79,8 @@ public:
     }
 
     void draw() override {
+        if (!obj) return;
+
         Rect2f f = frame();
         Rectangle *r;
         if (obj->selected()) {
@@ -71,14 +95,118 @@ public:
     }
 };
 
+class ObjectsSearch final : public TextInput {
+    ObjectsList *list;
+
+public:
+    ObjectsSearch(ObjectsList *l, Rect2f f, Widget *p, State *s)
+        : Widget(f, p, s)
+        , FocusableWidget(f, p, s)
+        , TextInput(f, p, s)
+        , list(l) {}
+
+    const char *title() const override {
+        return "Objects search";
+    }
+
+    void onValueChange() override;
+
+    void draw() override {
+        Rect2f f = frame();
+        Rectangle *r = rectBorder(state->window, f, {CLR_SURFACE_2}, 2, {CLR_BORDER});
+        texture->Draw(*r);
+
+        const float xText = 5.0f - scrollX();
+        const bool  focused = state->getFocus() == this;
+
+        Text *t;
+        if (getText().empty() && !focused) {
+            t = textAligned(state->window, "Search...", {xText, f.size.y / 2}, Color(CLR_TEXT_SUBTLE), state->appfont);
+        } else {
+            t = textAligned(state->window, getText().c_str(), {xText, f.size.y / 2}, Color(CLR_TEXT_STRONG), state->appfont);
+        }
+        texture->Draw(*t);
+
+        if (focused && caretVisible()) {
+            float cx = xText + caretXpx();
+            dr4::Line *l = thickLine(state->window, {cx, 4.0f}, {cx, f.size.y - 4.0f}, {CLR_TEXT_STRONG}, 1);
+            texture->Draw(*l);
+        }
+    }
+};
+
 class Desktop;
 
+/**
+ * Virtualized list of scene objects: `texture` only covers the viewport,
+ * and a small pool of ObjectPreview rows is rebound to the filtered
+ * entries that fall into (or next to) the visible range
+ */
 class ObjectsList final : public ScrollableWidget {
     const std::vector<Object*> &objects;
     Desktop *root;
-    ObjectPreview *selected = nullptr;
+    Object  *selected = nullptr;
+
+    VScrollbar    *scrollbar_ = nullptr;
+    ObjectsSearch *search_    = nullptr;
 
-    VScrollbar *scrollbar_ = nullptr;
+    std::string         filter_;   // lowercased
+    std::vector<size_t> visible_;  // indices into `objects` that pass the filter
+    size_t              indexed_ = 0;  // objects.size() at the last refilter
+
+    std::vector<ObjectPreview*> rows_;
+    size_t                      wanted_rows_ = 0;
+
+    static char lower(char c) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    bool matches(const std::string &name) const {
+        if (filter_.empty()) return true;
+        if (filter_.size() > name.size()) return false;
+
+        for (size_t i = 0; i + filter_.size() <= name.size(); ++i) {
+            size_t j = 0;
+            while (j < filter_.size() && lower(name[i + j]) == filter_[j]) ++j;
+            if (j == filter_.size()) return true;
+        }
+        return false;
+    }
+
+    void refilter() {
+        visible_.clear();
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (matches(objects[i]->name)) visible_.push_back(i);
+        }
+        indexed_ = objects.size();
+    }
+
+    float itemWidth() const {
+        return std::max(40.0f, viewport->GetWidth() - 2.0f * OBJLIST_PAD - SCROLLBAR_W);
+    }
+
+    static float rowY(size_t i) {
+        return OBJLIST_HEADER_H + OBJLIST_ROW_STEP * (float)i;
+    }
+
+    /**
+     * Rows are only created from blit(): layout() may run while an event
+     * is being dispatched over `children`, so it must not touch the vector
+     */
+    void growPool() {
+        if (rows_.size() >= wanted_rows_) return;
+
+        while (rows_.size() < wanted_rows_) {
+            auto *row = new ObjectPreview(this, {OBJLIST_PAD, -2.0f * OBJLIST_ROW_STEP, itemWidth(), OBJLIST_ROW_H}, nullptr, state);
+            appendChild(row);
+            rows_.push_back(row);
+        }
+        requestLayout();
+    }
+
+    void redrawRows() {
+        for (ObjectPreview *row : rows_) row->requestRedraw();
+    }
 
 public:
     ObjectsList(const std::vector<Object*> &objects_, Desktop *d, Rect2f f, Vec2f clip, Widget *p, State *s)
@@ -87,14 +215,16 @@ public:
         , objects(objects_)
         , root(d)
     {
-        for (size_t i = 0; i < objects.size(); ++i) {
-            auto *objPrev = new ObjectPreview(objects[i], this, {5, 5.0f + 35.0f * (float)i, clip.x - 20.0f, 30}, nullptr, state);
-            appendChild(objPrev);
+        for (Object *o : objects) {
+            if (o->selected()) { selected = o; break; }
         }
+        refilter();
 
-        // width should match viewport width
         texture->SetSize({clip.x, std::max(clip.y, 10.0f)});
 
+        search_ = new ObjectsSearch(this, {OBJLIST_PAD, OBJLIST_PAD, itemWidth(), OBJLIST_SEARCH_H}, nullptr, state);
+        appendChild(search_);
+
         scrollbar_ = new VScrollbar(state);
         scrollbar_->attachTo(this);
 
@@ -102,48 +232,99 @@ public:
         requestRedraw();
     }
 
-    ObjectPreview *selectedPreview() const { return selected; }
+    Object *selectedObject() const { return selected; }
+
+    void toggleSelect(Object *obj);
+
+    void setFilter(const std::string &needle) {
+        filter_.resize(needle.size());
+        for (size_t i = 0; i < needle.size(); ++i) filter_[i] = lower(needle[i]);
 
-    void toggleSelect(ObjectPreview *preview);
+        refilter();
+        position.y = viewport_pos.y;  // back to the top
+        requestLayout();
+        redrawRows();
+    }
+
+    // an object got renamed: it may enter or leave the filter
+    void nameChanged() {
+        refilter();
+        requestLayout();
+        redrawRows();
+    }
 
     const char *title() const override { return "Objects"; }
 
+    Vec2f contentSize() const override {
+        const float contentH = rowY(visible_.size()) + OBJLIST_PAD;
+        return {viewport->GetWidth(), std::max(contentH, viewport->GetHeight())};
+    }
+
     void layout() override {
-        const float pad = 5.0f;
-        const float rowH = 30.0f;
-        const float rowStep = 35.0f;
+        if (objects.size() != indexed_) refilter();
 
         const float viewportW = viewport->GetWidth();
         const float viewportH = viewport->GetHeight();
+        const float itemW     = itemWidth();
 
-        // leave space for the scrollbar on the right
-        const float itemW = std::max(40.0f, viewportW - 2.0f * pad - SCROLLBAR_W);
-
-        float y = pad;
-        for (Widget *c : children) {
-            auto *op = dynamic_cast<ObjectPreview*>(c);
-            if (!op) continue;
+        texture->SetSize({viewportW, viewportH});
 
-            op->position = {pad, y};
-            op->texture->SetSize({itemW, rowH});
-            op->layout();
+        // keep the offset valid if the content shrank (filtering, resize)
+        const float contentH = contentSize().y;
+        float progress = contentProgressY();
+        float maxProgress = std::max(0.0f, contentH - viewportH);
+        if (progress > maxProgress || progress < 0.0f) {
+            progress = std::clamp(progress, 0.0f, maxProgress);
+            position.y = viewport_pos.y - progress;
+        }
 
-            y += rowStep;
+        // [first, last) of visible_ that gets a row
+        const float top = (progress - OBJLIST_HEADER_H) / OBJLIST_ROW_STEP;
+        const float bot = (progress + viewportH - OBJLIST_HEADER_H) / OBJLIST_ROW_STEP;
+        size_t first = top > 0.0f ? (size_t)top : 0;
+        size_t last  = bot > 0.0f ? (size_t)std::ceil(bot) : 0;
+        first = first > OBJLIST_ROW_MARGIN ? first - OBJLIST_ROW_MARGIN : 0;
+        last  = std::min(last + OBJLIST_ROW_MARGIN, visible_.size());
+        if (last < first) last = first;
+
+        wanted_rows_ = last - first;
+
+        for (size_t i = 0; i < rows_.size(); ++i) {
+            ObjectPreview *row = rows_[i];
+            const size_t vi = first + i;
+
+            if (vi < last) {
+                row->position = {OBJLIST_PAD, rowY(vi)};
+                row->bind(objects[visible_[vi]]);
+            } else {
+                // parked above the content, never visible nor hit
+                row->position = {OBJLIST_PAD, -2.0f * OBJLIST_ROW_STEP};
+                row->bind(nullptr);
+            }
+
+            if (row->texture->GetWidth() != itemW) {
+                row->texture->SetSize({itemW, OBJLIST_ROW_H});
+                row->layout();
+                row->requestRedraw();
+            }
         }
 
-        float contentH = y + pad;
-        texture->SetSize({viewportW, std::max(contentH, viewportH)});
+        if (search_) {
+            search_->position = {OBJLIST_PAD, progress + OBJLIST_PAD};
+            if (search_->texture->GetWidth() != itemW) {
+                search_->texture->SetSize({itemW, OBJLIST_SEARCH_H});
+                search_->requestRedraw();
+            }
+        }
 
         if (scrollbar_) {
-            float progress_px = contentProgressY();
-
             scrollbar_->position.x = texture->GetWidth() - SCROLLBAR_W;
-            scrollbar_->position.y = progress_px;
+            scrollbar_->position.y = progress;
 
             scrollbar_->texture->SetSize({SCROLLBAR_W, viewportH});
 
             float trackH = scrollbar_->scrollHeight();
-            float ratio = (texture->GetHeight() <= 1.0f) ? 1.0f : (viewportH / texture->GetHeight());
+            float ratio = (contentH <= 1.0f) ? 1.0f : (viewportH / contentH);
             ratio = std::clamp(ratio, 0.05f, 1.0f);
 
             float sliderH = std::max(10.0f, trackH * ratio);
@@ -158,6 +339,39 @@ public:
         requestRedraw();
     }
 
+    void blit(Texture *target, Vec2f acc) override {
+        growPool();
+
+        if (texture_dirty) {
+            draw();
+
+            // children live in content coordinates, `texture` is the viewport
+            const Vec2f shift = {0.0f, -contentProgressY()};
+
+            for (ObjectPreview *row : rows_) {
+                if (row->object()) row->blit(texture, shift);
+            }
+
+            // rows scroll underneath the pinned search box
+            Rectangle *header = rectFill(state->window, {0, 0, texture->GetWidth() - 4.0f, OBJLIST_HEADER_H - 2.0f}, {CLR_SURFACE_1});
+            header->SetPos({2.0f, 2.0f});
+            texture->Draw(*header);
+
+            if (search_)    search_->blit(texture, shift);
+            if (scrollbar_) scrollbar_->blit(texture, shift);
+
+            texture_dirty = false;
+        }
+
+        dr4::Vec2f old_pos = tempPos(texture, {0, 0});
+        viewport->Draw(*texture);
+        texture->SetPos(old_pos);
+
+        old_pos = tempPos(viewport, acc + viewport_pos);
+        target->Draw(*viewport);
+        viewport->SetPos(old_pos);
+    }
+
     void draw() override {
         texture->Clear({CLR_SURFACE_1});
         Rect2f f = frame();
@@ -167,16 +381,16 @@ public:
 };
 
 class ObjectViewName final : public TextInput {
-    ObjectPreview *prev;
+    Object *obj;
 
 public:
-    ObjectViewName(ObjectPreview *preview, Rect2f f, Widget *p, State *s)
+    ObjectViewName(Object *o, Rect2f f, Widget *p, State *s)
         : Widget(f, p, s)
         , FocusableWidget(f, p, s)
         , TextInput(f, p, s)
-        , prev(preview)
+        , obj(o)
     {
-        setText(preview->obj->name);
+        setText(obj->name);
     }
 
     const char *title() const override {
@@ -184,8 +398,9 @@ public:
     }
 
     void onValueChange() override {
-        prev->obj->name = value;
-        prev->requestRedraw();
+        obj->name = value;
+        // the list may have been closed and reopened since we were populated
+        if (auto *list = root()->findDescendant<ObjectsList>()) list->nameChanged();
     }
 
     void draw() override {
@@ -198,12 +413,10 @@ public:
     }
 };
 
-inline void ObjectView::populate(ObjectPreview *prev) {
+inline void ObjectView::populate(Object *obj) {
     unpopulate();
 
-    Object *obj = prev->obj;
-
-    ObjectViewName *objname = new ObjectViewName(prev, {5, 5, 125, 24}, NULL, state);
+    ObjectViewName *objname = new ObjectViewName(obj, {5, 5, 125, 24}, NULL, state);
     this->appendChild(objname);
 
     Rect2f f = frame();
@@ -220,6 +433,10 @@ inline void ObjectView::populate(ObjectPreview *prev) {
     requestRedraw();
 }
 
+inline void ObjectsSearch::onValueChange() {
+    list->setFilter(value);
+}
+
 inline void Select::apply(void *, Widget *) {
-    list->toggleSelect(preview);
+    if (preview->object()) list->toggleSelect(preview->object());
 }
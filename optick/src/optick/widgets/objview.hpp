@@ -396,8 +396,6 @@ public:
     }
 };
 
-class ObjectPreview;
-
 class ObjectView final : public TitledWidget {
 public:
     ObjectView(Rect2f f, Widget *p, State *s)
@@ -415,7 +413,7 @@ public:
         requestRedraw();
     }
 
-    void populate(ObjectPreview *prev);
+    void populate(Object *obj);
 
 	void draw() override {
         Rect2f f = frame();
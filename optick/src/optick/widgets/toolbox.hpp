@@ -69,9 +69,12 @@ public:
  *  -      +
  */
 class ControlPanel final : public TitledWidget {
+    Renderer *renderer_;
+    Time      since_stats_ = 0;
+
 public:
 	ControlPanel(Renderer *renderer, Rect2f f, Widget *p, State *s)
-			: Widget(f, p, s), TitledWidget(f, p, s) {
+			: Widget(f, p, s), TitledWidget(f, p, s), renderer_(renderer) {
         Button *move_right = new Button({80, 55, 25, 25}, NULL, ">", state, new Strafe(renderer,  0.5));
         Button *move_left  = new Button({20, 55, 25, 25}, NULL, "<", state, new Strafe(renderer, -0.5));
 
@@ -106,5 +109,19 @@ public:
         Rect2f f = frame();
         Rectangle *r = rectBorder(state->window, f, {CLR_SURFACE_1}, 2, {CLR_BORDER});
         texture->Draw(*r);
+
+        char stats[64];
+        snprintf(stats, sizeof(stats), "shadow cache %.1f%%", renderer_->shadowCacheHitRate() * 100.0);
+        Text *t = textAligned(state->window, stats, {5, f.size.y - 10}, Color(CLR_TEXT_MUTED), state->appfont, 12);
+        texture->Draw(*t);
 	}
+
+    DispatchResult onIdle(DispatcherCtx, const IdleEvent *e) override {
+        since_stats_ += e->dt_s;
+        if (since_stats_ >= 0.5) {
+            since_stats_ = 0;
+            requestRedraw();
+        }
+        return PROPAGATE;
+    }
 };
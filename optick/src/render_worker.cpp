@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "farm/scene_codec.hpp"
+#include "farm/wire.hpp"
+
+// tiles a connection asks for up front; enough to hide one round trip
+static const uint32_t PIPELINE = 4;
+
+/**
+ * One connection, one render thread: pull tiles, send pixels back,
+ * until the coordinator hangs up
+ */
+static void serve(const std::string &addr, int id) {
+    int fd = farm::connectTo(addr);
+    if (fd < 0) return;
+
+    SceneSnapshot snap;
+    bool          has_scene = false;
+    int           width = 0, height = 0, max_depth = 0;
+    double        eps = 0;
+    ShadowCache   shadow;
+
+    std::vector<uint8_t> pull;
+    farm::Writer(pull).u32(PIPELINE);
+    if (!farm::sendMessage(fd, farm::MSG_PULL, pull)) {
+        close(fd);
+        return;
+    }
+
+    farm::Message msg;
+    std::vector<uint8_t> out;
+    size_t n_tiles = 0;
+
+    while (farm::recvMessage(fd, &msg)) {
+        farm::Reader r(msg.body);
+
+        if (msg.type == farm::MSG_SCENE) {
+            r.u32();  // version
+            width     = (int)r.u32();
+            height    = (int)r.u32();
+            max_depth = (int)r.u32();
+            eps       = r.f64();
+            const std::string blob = r.str();
+            // the old objects are freed by the decode, the cache points into them
+            shadow    = ShadowCache();
+            has_scene = r.ok() && decodeScene(blob, &snap);
+            if (!has_scene) break;
+            continue;
+        }
+
+        if (msg.type != farm::MSG_TILE || !has_scene) {
+            std::fprintf(stderr, "[worker %d] unexpected message type %u\n", id, msg.type);
+            break;
+        }
+
+        const uint32_t frame = r.u32();
+        const uint32_t tile  = r.u32();
+        const int x0 = (int)r.u32(), y0 = (int)r.u32();
+        const int x1 = (int)r.u32(), y1 = (int)r.u32();
+        if (!r.ok() || x0 < 0 || y0 < 0 || x1 > width || y1 > height || x1 < x0 || y1 < y0) {
+            std::fprintf(stderr, "[worker %d] bad tile\n", id);
+            break;
+        }
+
+        out.clear();
+        farm::Writer w(out);
+        w.u32(frame);
+        w.u32(tile);
+        w.u32((uint32_t)x0);
+        w.u32((uint32_t)y0);
+        w.u32((uint32_t)x1);
+        w.u32((uint32_t)y1);
+
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                Ray pr = Ray::primary(snap.cam, x, y, width, height);
+                opt::Color c = snap.scene.trace(pr, 0, max_depth, eps, &shadow);
+                const uint8_t px[4] = {
+                    opt::Color::encode(c.r),
+                    opt::Color::encode(c.g),
+                    opt::Color::encode(c.b),
+                    255
+                };
+                w.bytes(px, sizeof(px));
+            }
+        }
+
+        if (!farm::sendMessage(fd, farm::MSG_RESULT, out)) break;
+        ++n_tiles;
+    }
+
+    std::printf("[worker %d] done, %zu tiles rendered\n", id, n_tiles);
+    close(fd);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s unix:/path/to/socket|tcp:host:port [threads]\n", argv[0]);
+        return 2;
+    }
+
+    const std::string addr = argv[1];
+
+    int n_threads = argc > 2 ? std::atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+    if (n_threads <= 0) n_threads = 1;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < n_threads; ++i) threads.emplace_back(serve, addr, i);
+    for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+
+    return 0;
+}
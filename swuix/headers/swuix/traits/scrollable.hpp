@@ -65,12 +65,21 @@ public:
         return viewport_pos.x - position.x;
     }
 
+    /**
+     * Logical size of the scrolled content. Defaults to the texture size;
+     * virtualized widgets that only keep the visible part in `texture`
+     * override it so that scrolling and the scrollbar see the full extent.
+     */
+    virtual Vec2f contentSize() const {
+        return texture->GetSize();
+    }
+
     void scrollY(float dy) {
         Rect2f f = frame();
         Vec2f viewport_size = viewport->GetSize();
         float new_y = clamp(
             f.pos.y + dy,
-            viewport_pos.y + viewport_size.y - f.size.y,
+            viewport_pos.y + viewport_size.y - contentSize().y,
             viewport_pos.y
         );
         position.y = new_y;
@@ -83,7 +92,7 @@ public:
         Vec2f viewport_size = viewport->GetSize();
         float new_x = clamp(
             f.pos.x + dx,
-            viewport_pos.x + viewport_size.x - f.size.x,
+            viewport_pos.x + viewport_size.x - contentSize().x,
             viewport_pos.x
         );
         position.x = new_x;
@@ -302,7 +302,7 @@ public:
 
     virtual DispatchResult broadcast(DispatcherCtx ctx, Event *e) {
         for (Widget *child : children) {
-            if (child->isClipped()) ctx.clip(frame());
+            if (child->isClipped()) ctx.clip(inputClip());
             DispatcherCtx local_ctx = ctx.withOffset(position);
             if (child->broadcast(local_ctx, e) == CONSUME) return CONSUME;
         }
@@ -50,7 +50,7 @@ DispatchResult VScrollbarSlider::onMouseMove(DispatcherCtx ctx, const MouseMoveE
             parent->texture->GetHeight() - SCROLL_BUT_H - texture->GetHeight()
         ) - SCROLL_BUT_H;
         float progress_per = progress_px / scrollbar->scrollHeight();
-        float offset_parent_px = scrollbar->host->texture->GetHeight() * progress_per;
+        float offset_parent_px = scrollbar->host->contentSize().y * progress_per;
         scrollbar->host->position.y = scrollbar->host->viewport_pos.y - offset_parent_px;
         scrollbar->host->requestLayout();
         requestRedraw();
@@ -95,11 +95,12 @@ void VScrollbar::attachTo(ScrollableWidget *scrollable) {
 }
 
 float VScrollbar::scrollProgress() const {
-    return host->contentProgressY() / host->texture->GetHeight() * scrollHeight();
+    return host->contentProgressY() / host->contentSize().y * scrollHeight();
 }
 
 DispatchResult ScrollableWidget::onMouseMove(DispatcherCtx ctx, const MouseMoveEvent *) {
-    bool c = containsMouse(ctx);
+    // the content may reach far past the viewport, only the viewport is hit
+    bool c = ctx.surface.Contains(ctx.mouse_rel) && inputClip().Contains(ctx.mouse_rel);
     if (!state->mouse.target && c) state->mouse.target = this;
     if (c) state->mouse.wheel_target = this;
     return PROPAGATE;